@@ -0,0 +1,166 @@
+/*
+  Audio analysis for Hector
+
+  Level detection for the I2S microphone, fed block by block from the
+  capture task as DMA buffers arrive. DC offset, RMS and peak are kept
+  incrementally over a sliding window, so no block is ever re-read and the
+  renderer only picks up the latest published AudioLevels.
+
+  Pure C++ with no Arduino dependencies: the same code can be fed from a
+  WAV file on the host.
+*/
+
+#ifndef HECTOR_AUDIO_ANALYSIS_H
+#define HECTOR_AUDIO_ANALYSIS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include <atomic>
+
+// Window the RMS is taken over (matches the old 512-sample i2s_read)
+#define AUDIO_WINDOW_LEN   512
+// Longest block process() accepts, one DMA buffer
+#define AUDIO_MAX_BLOCK    256
+#define AUDIO_MAX_BLOCKS   (AUDIO_WINDOW_LEN / 64)
+#define AUDIO_NOISE_GATE   0.01f
+#define AUDIO_LEVEL_MAX    0.8f
+#define AUDIO_LEVEL_GAIN   3.0f
+
+struct AudioLevels {
+  float level = 0;        // gated, smoothed and scaled to 0..AUDIO_LEVEL_MAX
+  float power = 0;        // RMS over the window, in raw sample units
+  float peak = 0;         // largest |sample - dc| in the window
+  float dcOffset = 0;     // current DC estimate
+  uint32_t samples = 0;   // total samples analysed
+  uint32_t updatedUs = 0; // timestamp of the last update, for latency checks
+};
+
+// Single-producer ring of raw PCM samples for consumers that need the
+// waveform itself (spectrum analysis, recording)
+template <size_t N>
+class SampleRing {
+public:
+  static_assert((N & (N - 1)) == 0, "SampleRing size must be a power of two");
+
+  void push(const int16_t* samples, size_t n) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < n; i++) data[(h + i) & (N - 1)] = samples[i];
+    head.store(h + (uint32_t)n, std::memory_order_release);
+  }
+
+  // Copy the newest n samples (oldest first). Safe against a concurrent
+  // push as long as the reader keeps up within N - n samples.
+  void copyLatest(int16_t* out, size_t n) const {
+    uint32_t h = head.load(std::memory_order_acquire);
+    uint32_t start = h - (uint32_t)n;
+    for (size_t i = 0; i < n; i++) out[i] = data[(start + i) & (N - 1)];
+  }
+
+  // Copy n samples starting at the absolute position start (see written()),
+  // as long as they are still among the newest N
+  void copyFrom(uint32_t start, int16_t* out, size_t n) const {
+    for (size_t i = 0; i < n; i++) out[i] = data[(start + i) & (N - 1)];
+  }
+
+  uint32_t written() const { return head.load(std::memory_order_acquire); }
+
+private:
+  int16_t data[N] = {};
+  std::atomic<uint32_t> head{0};
+};
+
+class AudioAnalyzer {
+public:
+  // blockLen is the DMA buffer length the capture task hands over
+  void begin(float sampleRate, size_t blockLen) {
+    blockSamples = blockLen < AUDIO_MAX_BLOCK ? blockLen : AUDIO_MAX_BLOCK;
+    windowBlocks = AUDIO_WINDOW_LEN / blockSamples;
+    if (windowBlocks < 1) windowBlocks = 1;
+    if (windowBlocks > AUDIO_MAX_BLOCKS) windowBlocks = AUDIO_MAX_BLOCKS;
+
+    // DC tracker time constant of 8 windows (~93 ms at 44.1 kHz), slow
+    // enough not to follow low notes
+    dcAlpha = 1.0f / (8 * AUDIO_WINDOW_LEN);
+
+    // The old code smoothed 0.8/0.2 every 50 ms; keep the same time
+    // constant at the block rate
+    float blockMs = 1000.0f * blockSamples / sampleRate;
+    smoothAlpha = 1.0f - powf(0.8f, blockMs / 50.0f);
+
+    for (size_t i = 0; i < AUDIO_MAX_BLOCKS; i++) {
+      blockEnergy[i] = 0;
+      blockPeak[i] = 0;
+      blockCount[i] = 0;
+    }
+    blockIndex = 0;
+    filled = 0;
+    smoothed = 0;
+    out = AudioLevels();
+  }
+
+  // Feed one block of samples (at most the blockLen given to begin())
+  void process(const int16_t* samples, size_t n, uint32_t nowUs = 0) {
+    if (n > blockSamples) n = blockSamples;
+    if (n == 0) return;
+
+    if (out.samples == 0) dc = samples[0]; // start the tracker on the signal
+
+    float energy = 0;
+    float peak = 0;
+    for (size_t i = 0; i < n; i++) {
+      float s = samples[i];
+      dc += (s - dc) * dcAlpha;
+      float d = s - dc;
+      energy += d * d;
+      float a = fabsf(d);
+      if (a > peak) peak = a;
+    }
+
+    blockEnergy[blockIndex] = energy;
+    blockPeak[blockIndex] = peak;
+    blockCount[blockIndex] = (uint16_t)n;
+    blockIndex = (blockIndex + 1) % windowBlocks;
+    if (filled < windowBlocks) filled++;
+
+    float windowEnergy = 0;
+    float windowPeak = 0;
+    uint32_t windowCount = 0;
+    for (size_t i = 0; i < filled; i++) {
+      windowEnergy += blockEnergy[i];
+      windowCount += blockCount[i];
+      if (blockPeak[i] > windowPeak) windowPeak = blockPeak[i];
+    }
+
+    out.power = sqrtf(windowEnergy / windowCount);
+    out.peak = windowPeak;
+    out.dcOffset = dc;
+    out.samples += (uint32_t)n;
+    out.updatedUs = nowUs;
+
+    // Convert to normalized level (0.0 to 1.0) and apply the noise gate
+    float level = out.power / 32768.0f;
+    if (level < AUDIO_NOISE_GATE) level = 0;
+
+    smoothed += (level - smoothed) * smoothAlpha;
+    out.level = fminf(AUDIO_LEVEL_MAX, smoothed * AUDIO_LEVEL_GAIN);
+  }
+
+  const AudioLevels& levels() const { return out; }
+
+private:
+  size_t blockSamples = AUDIO_MAX_BLOCK;
+  size_t windowBlocks = 2;
+  size_t blockIndex = 0;
+  size_t filled = 0;
+  float blockEnergy[AUDIO_MAX_BLOCKS];
+  float blockPeak[AUDIO_MAX_BLOCKS];
+  uint16_t blockCount[AUDIO_MAX_BLOCKS];
+  float dc = 0;
+  float dcAlpha = 1.0f / (8 * AUDIO_WINDOW_LEN);
+  float smoothed = 0;
+  float smoothAlpha = 0.2f;
+  AudioLevels out;
+};
+
+#endif // HECTOR_AUDIO_ANALYSIS_H
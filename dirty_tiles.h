@@ -0,0 +1,118 @@
+/*
+  Dirty tiles for Hector
+
+  Splits the frame into TILE_SIZE x TILE_SIZE tiles and keeps a hash of
+  every tile as it was last sent to the panel. diff() hashes a new frame
+  and marks the tiles that changed; runs() turns them into rectangles to
+  push, joining neighbours along a tile row and equal runs down the
+  columns, so a frame that changed everywhere is still one rectangle.
+
+  The hashes describe the panel, not a buffer, so they stay valid when
+  front and back buffers swap. Anything drawn to the panel another way
+  (the splash screen) needs invalidate().
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_DIRTY_TILES_H
+#define HECTOR_DIRTY_TILES_H
+
+#include <stdint.h>
+#include "raster.h"
+
+#define TILE_SIZE 16
+
+struct TileRect {
+  int16_t x, y, w, h;
+};
+
+template <int MAX_TILES>
+class DirtyTiles {
+public:
+  void begin(int width, int height) {
+    frameWidth = width;
+    frameHeight = height;
+    cols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    rows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    if (cols * rows > MAX_TILES) rows = MAX_TILES / cols;  // the rest is never pushed
+    invalidate();
+  }
+
+  // The panel no longer shows what the hashes say: next diff() marks all
+  void invalidate() { known = false; }
+
+  // Hash fb line by line into its tiles and compare with the panel;
+  // returns the number of tiles that changed
+  int diff(const FrameBuffer& fb) {
+    uint32_t h[MAX_TILES];
+    for (int t = 0; t < cols * rows; t++) h[t] = 0x811C9DC5u;
+
+    const int height = rows * TILE_SIZE < fb.height ? rows * TILE_SIZE : fb.height;
+    for (int y = 0; y < height; y++) {
+      const uint16_t* line = fb.pixels + y * fb.width;
+      uint32_t* tile = h + (y / TILE_SIZE) * cols;
+      for (int tx = 0; tx < cols; tx++) {
+        int x = tx * TILE_SIZE;
+        int end = x + TILE_SIZE < fb.width ? x + TILE_SIZE : fb.width;
+        uint32_t v = tile[tx];
+        for (; x + 1 < end; x += 2) v = mix(v, line[x] | (uint32_t)line[x + 1] << 16);
+        if (x < end) v = mix(v, line[x]);
+        tile[tx] = v;
+      }
+    }
+
+    int changed = 0;
+    for (int t = 0; t < cols * rows; t++) {
+      dirty[t] = !known || h[t] != hash[t];
+      hash[t] = h[t];
+      changed += dirty[t];
+    }
+    known = true;
+    return changed;
+  }
+
+  // Rectangles covering the dirty tiles, at most MAX_TILES; returns the count
+  int runs(TileRect* out) const {
+    int n = 0;
+    for (int ty = 0; ty < rows; ty++) {
+      const int rowStart = n;
+      for (int tx = 0; tx < cols; tx++) {
+        if (!dirty[ty * cols + tx]) continue;
+        int first = tx;
+        while (tx + 1 < cols && dirty[ty * cols + tx + 1]) tx++;
+
+        TileRect r;
+        r.x = (int16_t)(first * TILE_SIZE);
+        r.y = (int16_t)(ty * TILE_SIZE);
+        r.w = (int16_t)(((tx + 1) * TILE_SIZE < frameWidth ? (tx + 1) * TILE_SIZE : frameWidth) - r.x);
+        r.h = (int16_t)(((ty + 1) * TILE_SIZE < frameHeight ? (ty + 1) * TILE_SIZE : frameHeight) - r.y);
+
+        // Same columns as a run ending just above: make that one taller
+        bool joined = false;
+        for (int i = 0; i < rowStart && !joined; i++) {
+          if (out[i].x == r.x && out[i].w == r.w && out[i].y + out[i].h == r.y) {
+            out[i].h += r.h;
+            joined = true;
+          }
+        }
+        if (!joined) out[n++] = r;
+      }
+    }
+    return n;
+  }
+
+private:
+  // Bijective per step, so a single changed word always changes the hash
+  static uint32_t mix(uint32_t v, uint32_t w) {
+    v = (v ^ w) * 0x9E3779B1u;
+    return v ^ (v >> 15);
+  }
+
+  uint32_t hash[MAX_TILES] = {};
+  bool dirty[MAX_TILES] = {};
+  bool known = false;
+  int cols = 0, rows = 0;
+  int frameWidth = 0, frameHeight = 0;
+};
+
+#endif // HECTOR_DIRTY_TILES_H
@@ -0,0 +1,702 @@
+/*
+  Formula surfaces for Hector
+
+  A small expression language for user-defined surfaces:
+
+    r = sqrt(x^2 + y^2);
+    30 * cos(r * 0.3 - k * 2) / (1 + r * 0.1)
+
+  Variables are x and y (grid position), k (time), accX and accY (tilt,
+  g) and sound (0..1). Operators + - * / with the usual precedence, unary
+  minus, and ^ with a whole constant exponent 0..8. Functions: sin cos
+  sqrt abs log floor (one argument), min max mod atan2 (two). "name =
+  expr;" names a subexpression for the rest of the formula. Parentheses,
+  function arguments, unary signs and exponents nest at most
+  FORMULA_MAX_DEPTH deep: the parser recurses for each, on the stack of
+  the task that compiles.
+
+  compile() parses into a graph in which equal subexpressions are one
+  node, folds constants as it goes and splits the nodes by what they
+  depend on, into three register programs:
+    - grid: nodes of x and y only, run when the grid changes. The values
+      the other programs read are kept as per-vertex terms (hoisted),
+      like the precomputed terms of the built-in surfaces.
+    - frame: nodes of k and the sensors only, run once per frame on
+      scalars and broadcast to whole-row registers.
+    - row: the rest, run once per scan row over all of its columns, so
+      the dispatch of an operation is paid per row, not per vertex.
+  A division of a per-frame value by a per-vertex one becomes a product
+  with a hoisted reciprocal.
+
+  eval() computes the same graph at a single point, for the scalar path.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_FORMULA_H
+#define HECTOR_FORMULA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "rom_math.h"
+
+#define FORMULA_MAX_TEXT 256    // source, with the terminating zero
+#define FORMULA_MAX_NODES 128
+#define FORMULA_MAX_OPS 96      // per program
+#define FORMULA_MAX_NAMES 8
+#define FORMULA_NAME_LEN 12
+#define FORMULA_MAX_DEPTH 16    // nested ( ), function arguments, unary signs and exponents
+#define FORMULA_MAX_HOISTED 8
+#define FORMULA_VECTORS 24      // row registers for constants, broadcasts and temporaries
+
+enum FormulaCode : uint8_t {
+  // Leaves
+  FX_CONST, FX_X, FX_Y, FX_K, FX_ACCX, FX_ACCY, FX_SOUND,
+  // One operand
+  FX_NEG, FX_SIN, FX_COS, FX_SQRT, FX_ABS, FX_LOG, FX_FLOOR,
+  // Two operands
+  FX_ADD, FX_SUB, FX_MUL, FX_DIV, FX_MIN, FX_MAX, FX_MOD, FX_ATAN2,
+  // Programs only
+  FX_COPY
+};
+
+// What a node depends on
+#define FX_DEPENDS_X 1
+#define FX_DEPENDS_Y 2
+#define FX_DEPENDS_T 4  // k or a sensor: new every frame
+
+struct FormulaInputs {
+  float k, accX, accY, sound;
+};
+
+struct FormulaNode {
+  uint8_t code, mask;
+  int16_t a, b;
+  float value;  // FX_CONST
+};
+
+// One operation of a program: registers dst = code(a, b)
+struct FormulaOp {
+  uint8_t code, dst, a, b;
+};
+
+struct FormulaFunction {
+  const char* name;
+  uint8_t code, args;
+};
+
+static const FormulaFunction formulaFunctions[] = {
+  {"sin", FX_SIN, 1}, {"cos", FX_COS, 1}, {"sqrt", FX_SQRT, 1}, {"abs", FX_ABS, 1},
+  {"log", FX_LOG, 1}, {"floor", FX_FLOOR, 1}, {"min", FX_MIN, 2}, {"max", FX_MAX, 2},
+  {"mod", FX_MOD, 2}, {"atan2", FX_ATAN2, 2},
+};
+
+inline float formulaApply(uint8_t code, float a, float b) {
+  switch (code) {
+    case FX_NEG: return -a;
+    case FX_SIN: return romSinF(a);
+    case FX_COS: return romCosF(a);
+    case FX_SQRT: return romSqrtF(a);
+    case FX_ABS: return fabsf(a);
+    case FX_LOG: return romLogF(a);
+    case FX_FLOOR: return floorf(a);
+    case FX_ADD: return a + b;
+    case FX_SUB: return a - b;
+    case FX_MUL: return a * b;
+    case FX_DIV: return a / b;
+    case FX_MIN: return a < b ? a : b;
+    case FX_MAX: return a > b ? a : b;
+    case FX_MOD: return fmodf(a, b);
+    case FX_ATAN2: return atan2f(a, b);
+    default: return a;  // FX_COPY
+  }
+}
+
+// Runs ops over registers of n floats each; a loop per operation so the
+// compiler can vectorize the arithmetic ones
+inline void formulaRun(const FormulaOp* op, int count, float* const* r, int n) {
+  for (const FormulaOp* end = op + count; op < end; op++) {
+    float* d = r[op->dst];
+    const float* a = r[op->a];
+    const float* b = r[op->b];
+    switch (op->code) {
+#define FX_LOOP(expr) for (int j = 0; j < n; j++) d[j] = (expr); break
+      case FX_NEG: FX_LOOP(-a[j]);
+      case FX_SIN: FX_LOOP(romSinF(a[j]));
+      case FX_COS: FX_LOOP(romCosF(a[j]));
+      case FX_SQRT: FX_LOOP(romSqrtF(a[j]));
+      case FX_ABS: FX_LOOP(fabsf(a[j]));
+      case FX_LOG: FX_LOOP(romLogF(a[j]));
+      case FX_FLOOR: FX_LOOP(floorf(a[j]));
+      case FX_ADD: FX_LOOP(a[j] + b[j]);
+      case FX_SUB: FX_LOOP(a[j] - b[j]);
+      case FX_MUL: FX_LOOP(a[j] * b[j]);
+      case FX_DIV: FX_LOOP(a[j] / b[j]);
+      case FX_MIN: FX_LOOP(a[j] < b[j] ? a[j] : b[j]);
+      case FX_MAX: FX_LOOP(a[j] > b[j] ? a[j] : b[j]);
+      case FX_MOD: FX_LOOP(fmodf(a[j], b[j]));
+      case FX_ATAN2: FX_LOOP(atan2f(a[j], b[j]));
+      default: FX_LOOP(a[j]);  // FX_COPY
+#undef FX_LOOP
+    }
+  }
+}
+
+// WIDTH: the most columns a row can have
+template <int WIDTH>
+class FormulaProgram {
+public:
+  // Up to maxHoisted per-vertex terms (at most FORMULA_MAX_HOISTED); false
+  // with error() and errorAt() (a column of the source) when it fails
+  bool compile(const char* source, int maxHoisted) {
+    reset();
+    size_t len = strlen(source);
+    if (len >= FORMULA_MAX_TEXT) {
+      err = "longer than 255 characters";
+      errPos = FORMULA_MAX_TEXT - 1;
+      return false;
+    }
+    memcpy(text, source, len + 1);
+
+    p = text;
+    int r = parseFormula();
+    if (r < 0) return false;
+    root = r;
+    if (!generate(maxHoisted < FORMULA_MAX_HOISTED ? maxHoisted : FORMULA_MAX_HOISTED)) {
+      root = -1;
+      return false;
+    }
+    return true;
+  }
+
+  bool ok() const { return root >= 0; }
+  const char* source() const { return text; }
+  const char* error() const { return err; }
+  int errorAt() const { return errPos; }
+  bool dependsOnTime() const { return root >= 0 && (nodes[root].mask & FX_DEPENDS_T); }
+
+  int nodeCount() const { return count; }
+  int hoisted() const { return hoistCount; }
+  int gridOps() const { return gridCount; }
+  int frameOps() const { return frameCount; }
+  int rowOps() const { return rowCount; }
+
+  // Fills the hoisted terms of one scan row: terms[t][0..n)
+  void gridRow(float x, const float* y, int n, float* const* terms) {
+    if (gridUsesX) fill(reg[FORMULA_REG_X], x, n);
+    reg[FORMULA_REG_Y] = const_cast<float*>(y);
+    for (int t = 0; t < hoistCount; t++) reg[FORMULA_REG_TERMS + t] = terms[t];
+    formulaRun(gridCode, gridCount, reg, n);
+  }
+
+  // Once per frame, before the rows
+  void frame(const FormulaInputs& in) {
+    for (int i = 0; i <= root; i++) {
+      switch (nodes[i].code) {
+        case FX_K: scalar[i] = in.k; break;
+        case FX_ACCX: scalar[i] = in.accX; break;
+        case FX_ACCY: scalar[i] = in.accY; break;
+        case FX_SOUND: scalar[i] = in.sound; break;
+        default: break;
+      }
+    }
+    formulaRun(frameCode, frameCount, scalarReg, 1);
+    for (int f = 0; f < broadcastCount; f++) fill(reg[broadcast[f].dst], scalar[broadcast[f].a], WIDTH);
+  }
+
+  // z[0..n) of one scan row, from the terms gridRow() filled for it
+  void row(float x, const float* y, const float* const* terms, int n, float* z) {
+    if (rowUsesX) fill(reg[FORMULA_REG_X], x, n);
+    reg[FORMULA_REG_OUT] = z;
+    reg[FORMULA_REG_Y] = const_cast<float*>(y);
+    for (int t = 0; t < hoistCount; t++) reg[FORMULA_REG_TERMS + t] = const_cast<float*>(terms[t]);
+    formulaRun(rowCode, rowCount, reg, n);
+  }
+
+  // The graph at one point
+  float eval(float x, float y, const FormulaInputs& in) const {
+    float v[FORMULA_MAX_NODES];
+    for (int i = 0; i <= root; i++) {
+      const FormulaNode& n = nodes[i];
+      switch (n.code) {
+        case FX_CONST: v[i] = n.value; break;
+        case FX_X: v[i] = x; break;
+        case FX_Y: v[i] = y; break;
+        case FX_K: v[i] = in.k; break;
+        case FX_ACCX: v[i] = in.accX; break;
+        case FX_ACCY: v[i] = in.accY; break;
+        case FX_SOUND: v[i] = in.sound; break;
+        default: v[i] = formulaApply(n.code, v[n.a], n.b >= 0 ? v[n.b] : 0); break;
+      }
+    }
+    return root >= 0 ? v[root] : 0;
+  }
+
+private:
+  enum {
+    FORMULA_REG_OUT,
+    FORMULA_REG_X,
+    FORMULA_REG_Y,
+    FORMULA_REG_TERMS,
+    FORMULA_REG_VECTORS = FORMULA_REG_TERMS + FORMULA_MAX_HOISTED,
+    FORMULA_REG_COUNT = FORMULA_REG_VECTORS + FORMULA_VECTORS
+  };
+
+  void reset() {
+    text[0] = 0;
+    err = 0;
+    errPos = 0;
+    depth = 0;
+    count = nameCount = 0;
+    root = -1;
+    hoistCount = gridCount = frameCount = rowCount = broadcastCount = 0;
+    gridUsesX = rowUsesX = false;
+    for (int r = 0; r < FORMULA_REG_COUNT; r++) reg[r] = 0;
+    reg[FORMULA_REG_X] = store[0];
+    for (int v = 0; v < FORMULA_VECTORS; v++) reg[FORMULA_REG_VECTORS + v] = store[v];
+    for (int i = 0; i < FORMULA_MAX_NODES; i++) {
+      hoist[i] = -1;
+      fixedReg[i] = 0;
+      scalarReg[i] = &scalar[i];
+    }
+  }
+
+  static void fill(float* d, float v, int n) {
+    for (int j = 0; j < n; j++) d[j] = v;
+  }
+
+  int fail(const char* at, const char* message) {
+    if (!err) {
+      err = message;
+      errPos = (int)(at - text);
+    }
+    return -1;
+  }
+
+  // --- Graph ---------------------------------------------------------------
+
+  bool isConst(int i, float v) const { return nodes[i].code == FX_CONST && nodes[i].value == v; }
+
+  int add(uint8_t code, int a, int b, float value) {
+    FormulaNode n;
+    n.code = code;
+    n.a = (int16_t)a;
+    n.b = (int16_t)b;
+    n.value = value;
+    switch (code) {
+      case FX_CONST: n.mask = 0; break;
+      case FX_X: n.mask = FX_DEPENDS_X; break;
+      case FX_Y: n.mask = FX_DEPENDS_Y; break;
+      case FX_K: case FX_ACCX: case FX_ACCY: case FX_SOUND: n.mask = FX_DEPENDS_T; break;
+      default: n.mask = (a >= 0 ? nodes[a].mask : 0) | (b >= 0 ? nodes[b].mask : 0); break;
+    }
+    for (int i = 0; i < count; i++) {
+      const FormulaNode& o = nodes[i];
+      if (o.code == n.code && o.a == n.a && o.b == n.b && memcmp(&o.value, &n.value, sizeof(float)) == 0) return i;
+    }
+    if (count == FORMULA_MAX_NODES) return fail(p, "too many operations");
+    nodes[count] = n;
+    return count++;
+  }
+
+  int constant(float v) { return add(FX_CONST, -1, -1, v); }
+  int leaf(uint8_t code) { return add(code, -1, -1, 0); }
+
+  int unary(uint8_t code, int a) {
+    if (a < 0) return -1;
+    if (nodes[a].code == FX_CONST) return constant(formulaApply(code, nodes[a].value, 0));
+    return add(code, a, -1, 0);
+  }
+
+  int binary(uint8_t code, int a, int b) {
+    if (a < 0 || b < 0) return -1;
+    if (nodes[a].code == FX_CONST && nodes[b].code == FX_CONST)
+      return constant(formulaApply(code, nodes[a].value, nodes[b].value));
+    switch (code) {
+      case FX_ADD:
+        if (isConst(a, 0)) return b;
+        if (isConst(b, 0)) return a;
+        break;
+      case FX_SUB:
+        if (isConst(b, 0)) return a;
+        break;
+      case FX_MUL:
+        if (isConst(a, 1)) return b;
+        if (isConst(b, 1)) return a;
+        break;
+      case FX_DIV:
+        if (isConst(b, 1)) return a;
+        // Per frame over per vertex: the reciprocal is hoisted, the row multiplies
+        if ((nodes[a].mask & FX_DEPENDS_T) && nodes[b].mask && !(nodes[b].mask & FX_DEPENDS_T))
+          return binary(FX_MUL, a, binary(FX_DIV, constant(1), b));
+        break;
+    }
+    // One order for commutative operations, so a + b and b + a are one node
+    if ((code == FX_ADD || code == FX_MUL || code == FX_MIN || code == FX_MAX) && a > b) {
+      int t = a;
+      a = b;
+      b = t;
+    }
+    return add(code, a, b, 0);
+  }
+
+  int power(int base, int e) {
+    if (e == 0) return constant(1);
+    if (e == 1) return base;
+    int half = power(base, e / 2);
+    int square = binary(FX_MUL, half, half);
+    return e & 1 ? binary(FX_MUL, square, base) : square;
+  }
+
+  // --- Parser --------------------------------------------------------------
+
+  // One more level of recursion, undone with depth-- when it returns
+  bool enter() {
+    if (depth == FORMULA_MAX_DEPTH) {
+      fail(p, "nested too deep");
+      return false;
+    }
+    depth++;
+    return true;
+  }
+
+  void skipSpace() {
+    while (isspace((unsigned char)*p)) p++;
+  }
+
+  bool readName(char* name) {
+    if (!isalpha((unsigned char)*p) && *p != '_') return false;
+    int n = 0;
+    while (isalnum((unsigned char)*p) || *p == '_') {
+      if (n < FORMULA_NAME_LEN - 1) name[n++] = *p;
+      p++;
+    }
+    name[n] = 0;
+    return true;
+  }
+
+  int builtin(const char* name) const {
+    static const char* const vars[] = {"x", "y", "k", "accX", "accY", "sound"};
+    static const uint8_t codes[] = {FX_X, FX_Y, FX_K, FX_ACCX, FX_ACCY, FX_SOUND};
+    for (int v = 0; v < 6; v++)
+      if (strcmp(name, vars[v]) == 0) return codes[v];
+    return -1;
+  }
+
+  const FormulaFunction* function(const char* name) const {
+    for (size_t f = 0; f < sizeof(formulaFunctions) / sizeof(formulaFunctions[0]); f++)
+      if (strcmp(name, formulaFunctions[f].name) == 0) return &formulaFunctions[f];
+    return 0;
+  }
+
+  // (name = expr ;)* expr [;]
+  int parseFormula() {
+    for (;;) {
+      skipSpace();
+      const char* at = p;
+      char name[FORMULA_NAME_LEN];
+      if (!readName(name)) break;
+      skipSpace();
+      if (*p != '=') {
+        p = at;
+        break;
+      }
+      p++;
+      if (builtin(name) >= 0 || function(name)) return fail(at, "name is taken");
+      int value = parseSum();
+      if (value < 0) return -1;
+      skipSpace();
+      if (*p != ';') return fail(p, "expected ';'");
+      p++;
+      if (!define(name, value)) return fail(at, "too many names");
+    }
+
+    int e = parseSum();
+    if (e < 0) return -1;
+    skipSpace();
+    if (*p == ';') p++;
+    skipSpace();
+    if (*p) return fail(p, "unexpected character");
+    return e;
+  }
+
+  bool define(const char* name, int value) {
+    for (int i = 0; i < nameCount; i++) {
+      if (strcmp(names[i], name) == 0) {
+        nameNode[i] = value;
+        return true;
+      }
+    }
+    if (nameCount == FORMULA_MAX_NAMES) return false;
+    strcpy(names[nameCount], name);
+    nameNode[nameCount++] = value;
+    return true;
+  }
+
+  int parseSum() {
+    int a = parseProduct();
+    for (;;) {
+      skipSpace();
+      if (a < 0 || (*p != '+' && *p != '-')) return a;
+      uint8_t code = *p++ == '+' ? FX_ADD : FX_SUB;
+      a = binary(code, a, parseProduct());
+    }
+  }
+
+  int parseProduct() {
+    int a = parseUnary();
+    for (;;) {
+      skipSpace();
+      if (a < 0 || (*p != '*' && *p != '/')) return a;
+      uint8_t code = *p++ == '*' ? FX_MUL : FX_DIV;
+      a = binary(code, a, parseUnary());
+    }
+  }
+
+  int parseUnary() {
+    skipSpace();
+    if (*p == '-' || *p == '+') {
+      bool minus = *p++ == '-';
+      if (!enter()) return -1;
+      int e = parseUnary();
+      depth--;
+      return minus ? unary(FX_NEG, e) : e;
+    }
+    return parsePower();
+  }
+
+  int parsePower() {
+    int base = parsePrimary();
+    skipSpace();
+    if (base < 0 || *p != '^') return base;
+    p++;
+    skipSpace();
+    const char* at = p;
+    if (!enter()) return -1;
+    int e = parseUnary();
+    depth--;
+    if (e < 0) return -1;
+    float v = nodes[e].value;
+    if (nodes[e].code != FX_CONST || v != floorf(v) || v < 0 || v > 8)
+      return fail(at, "exponent must be a whole number 0..8");
+    return power(base, (int)v);
+  }
+
+  int parsePrimary() {
+    skipSpace();
+    const char* at = p;
+    if (isdigit((unsigned char)*p) || *p == '.') {
+      char* end;
+      float v = strtof(p, &end);
+      if (end == p) return fail(at, "bad number");
+      p = end;
+      return constant(v);
+    }
+    if (*p == '(') {
+      p++;
+      if (!enter()) return -1;
+      int e = parseSum();
+      depth--;
+      if (e < 0) return -1;
+      skipSpace();
+      if (*p != ')') return fail(p, "expected ')'");
+      p++;
+      return e;
+    }
+
+    char name[FORMULA_NAME_LEN];
+    if (!readName(name)) return fail(at, *p ? "expected a number, name or '('" : "unexpected end");
+    skipSpace();
+    if (*p == '(') {
+      const FormulaFunction* f = function(name);
+      if (!f) return fail(at, "unknown function");
+      p++;
+      if (!enter()) return -1;
+      int args[2] = {-1, -1};
+      for (int i = 0; i < f->args; i++) {
+        if (i > 0) {
+          skipSpace();
+          if (*p != ',') return fail(p, "expected ','");
+          p++;
+        }
+        args[i] = parseSum();
+        if (args[i] < 0) return -1;
+      }
+      depth--;
+      skipSpace();
+      if (*p != ')') return fail(p, f->args == 1 ? "expected ')'" : "expected ')' after two arguments");
+      p++;
+      return f->args == 1 ? unary(f->code, args[0]) : binary(f->code, args[0], args[1]);
+    }
+
+    int code = builtin(name);
+    if (code >= 0) return leaf((uint8_t)code);
+    for (int i = nameCount - 1; i >= 0; i--)
+      if (strcmp(names[i], name) == 0) return nameNode[i];
+    return fail(at, "unknown name");
+  }
+
+  // --- Programs ------------------------------------------------------------
+
+  static bool isLeaf(const FormulaNode& n) { return n.code < FX_NEG; }
+  static bool perVertex(const FormulaNode& n) { return n.mask && !(n.mask & FX_DEPENDS_T); }
+  static bool perFrame(const FormulaNode& n) { return n.mask == FX_DEPENDS_T; }
+
+  bool generate(int maxHoisted) {
+    bool needed[FORMULA_MAX_NODES] = {}, inRow[FORMULA_MAX_NODES] = {}, readByRow[FORMULA_MAX_NODES] = {};
+    bool inGrid[FORMULA_MAX_NODES] = {}, inFrame[FORMULA_MAX_NODES] = {};
+    needed[root] = readByRow[root] = true;
+
+    // Parents have higher indices than their operands, so walking down
+    // visits every reader of a node before the node
+    for (int i = root; i >= 0; i--) {
+      if (!needed[i]) continue;
+      const FormulaNode& n = nodes[i];
+      inRow[i] = (n.mask & FX_DEPENDS_T) && (n.mask & (FX_DEPENDS_X | FX_DEPENDS_Y));
+      if (perVertex(n) && !isLeaf(n) && readByRow[i]) {
+        if (hoistCount < maxHoisted) {
+          hoist[i] = (int8_t)hoistCount++;
+          inGrid[i] = true;
+        } else {
+          inRow[i] = true;  // out of terms: computed per row
+        }
+      }
+      if (perFrame(n) && !isLeaf(n) && readByRow[i]) inFrame[i] = true;
+      if (isLeaf(n)) continue;
+      for (int o = 0; o < 2; o++) {
+        int c = o ? n.b : n.a;
+        if (c < 0) continue;
+        needed[c] = true;
+        if (inRow[i]) readByRow[c] = true;
+        if (inGrid[i] && perVertex(nodes[c]) && !isLeaf(nodes[c])) inGrid[c] = true;
+        if (inFrame[i] && perFrame(nodes[c]) && !isLeaf(nodes[c])) inFrame[c] = true;
+      }
+    }
+
+    // Row registers that never change within a program: constants, the
+    // per-frame values, and the hoisted terms
+    int vectors = 1;  // store[0] is x
+    for (int i = 0; i <= root; i++) {
+      const FormulaNode& n = nodes[i];
+      if (!needed[i]) continue;
+      if (n.code == FX_CONST) {
+        scalar[i] = n.value;
+        if (!readByRow[i] && !readByGrid(i, inGrid)) continue;
+        if (vectors == FORMULA_VECTORS) return fail(text, "too complex") >= 0;
+        fixedReg[i] = (uint8_t)(FORMULA_REG_VECTORS + vectors++);
+        fill(reg[fixedReg[i]], n.value, WIDTH);
+      } else if (n.code == FX_X) {
+        fixedReg[i] = FORMULA_REG_X;
+      } else if (n.code == FX_Y) {
+        fixedReg[i] = FORMULA_REG_Y;
+      } else if (hoist[i] >= 0) {
+        fixedReg[i] = (uint8_t)(FORMULA_REG_TERMS + hoist[i]);
+      } else if (perFrame(n) && readByRow[i]) {
+        if (vectors == FORMULA_VECTORS) return fail(text, "too complex") >= 0;
+        fixedReg[i] = (uint8_t)(FORMULA_REG_VECTORS + vectors++);
+        broadcast[broadcastCount].dst = fixedReg[i];
+        broadcast[broadcastCount++].a = (uint8_t)i;
+      }
+    }
+
+    for (int i = 0; i <= root; i++) {
+      if (!inFrame[i]) continue;
+      const FormulaNode& n = nodes[i];
+      FormulaOp& op = frameCode[frameCount++];
+      op.code = n.code;
+      op.dst = (uint8_t)i;
+      op.a = (uint8_t)n.a;
+      op.b = (uint8_t)(n.b >= 0 ? n.b : n.a);
+    }
+
+    if (!schedule(inGrid, vectors, gridCode, gridCount, false)) return false;
+    if (!schedule(inRow, vectors, rowCode, rowCount, true)) return false;
+    if (!inRow[root]) {
+      // The whole formula is hoisted, per frame or constant
+      FormulaOp& op = rowCode[rowCount++];
+      op.code = FX_COPY;
+      op.dst = FORMULA_REG_OUT;
+      op.a = op.b = fixedReg[root];
+    }
+    for (int o = 0; o < gridCount; o++) gridUsesX |= gridCode[o].a == FORMULA_REG_X || gridCode[o].b == FORMULA_REG_X;
+    for (int o = 0; o < rowCount; o++) rowUsesX |= rowCode[o].a == FORMULA_REG_X || rowCode[o].b == FORMULA_REG_X;
+    return true;
+  }
+
+  bool readByGrid(int c, const bool* inGrid) const {
+    for (int i = c + 1; i <= root; i++)
+      if (inGrid[i] && (nodes[i].a == c || nodes[i].b == c)) return true;
+    return false;
+  }
+
+  // Ops for the nodes in the program, in order; a temporary returns to the
+  // free list after its last reader, so a result can overwrite an operand
+  bool schedule(const bool* in, int firstTemp, FormulaOp* code, int& ops, bool isRow) {
+    int last[FORMULA_MAX_NODES];
+    uint8_t temp[FORMULA_MAX_NODES] = {};
+    for (int i = 0; i <= root; i++) {
+      last[i] = -1;
+      if (!in[i]) continue;
+      const FormulaNode& n = nodes[i];
+      last[n.a] = i;
+      if (n.b >= 0) last[n.b] = i;
+    }
+
+    uint8_t free[FORMULA_VECTORS];
+    int freeCount = 0;
+    for (int v = FORMULA_VECTORS - 1; v >= firstTemp; v--) free[freeCount++] = (uint8_t)(FORMULA_REG_VECTORS + v);
+
+    for (int i = 0; i <= root; i++) {
+      if (!in[i]) continue;
+      const FormulaNode& n = nodes[i];
+      if (ops == FORMULA_MAX_OPS) return fail(text, "too complex") >= 0;
+      FormulaOp& op = code[ops++];
+      op.code = n.code;
+      op.a = in[n.a] && hoist[n.a] < 0 ? temp[n.a] : fixedReg[n.a];
+      op.b = n.b < 0 ? op.a : (in[n.b] && hoist[n.b] < 0 ? temp[n.b] : fixedReg[n.b]);
+      if (in[n.a] && hoist[n.a] < 0 && last[n.a] == i) free[freeCount++] = temp[n.a];
+      if (n.b >= 0 && n.b != n.a && in[n.b] && hoist[n.b] < 0 && last[n.b] == i) free[freeCount++] = temp[n.b];
+
+      if (isRow && i == root) {
+        op.dst = FORMULA_REG_OUT;
+      } else if (!isRow && hoist[i] >= 0) {
+        op.dst = fixedReg[i];
+      } else {
+        if (freeCount == 0) return fail(text, "too complex") >= 0;
+        op.dst = temp[i] = free[--freeCount];
+      }
+    }
+    return true;
+  }
+
+  char text[FORMULA_MAX_TEXT];
+  const char* p = 0;
+  const char* err = 0;
+  int errPos = 0;
+  int depth = 0;
+
+  FormulaNode nodes[FORMULA_MAX_NODES];
+  int count = 0, root = -1;
+  char names[FORMULA_MAX_NAMES][FORMULA_NAME_LEN];
+  int nameNode[FORMULA_MAX_NAMES];
+  int nameCount = 0;
+
+  int8_t hoist[FORMULA_MAX_NODES];
+  uint8_t fixedReg[FORMULA_MAX_NODES];
+  int hoistCount = 0;
+
+  FormulaOp gridCode[FORMULA_MAX_OPS], frameCode[FORMULA_MAX_OPS], rowCode[FORMULA_MAX_OPS];
+  FormulaOp broadcast[FORMULA_VECTORS];  // dst: row register, a: node
+  int gridCount = 0, frameCount = 0, rowCount = 0, broadcastCount = 0;
+  bool gridUsesX = false, rowUsesX = false;
+
+  float scalar[FORMULA_MAX_NODES];
+  float* scalarReg[FORMULA_MAX_NODES];
+  float* reg[FORMULA_REG_COUNT];
+  float store[FORMULA_VECTORS][WIDTH];
+};
+
+#endif // HECTOR_FORMULA_H
@@ -0,0 +1,245 @@
+/*
+  Retained status overlay for Hector
+
+  The status text (FPS, mode, sound readouts, banners, profiler lines) is
+  a set of HudLines at fixed places on the screen. Each line is a 1-bit
+  mask, one 6x8 glyph per character, that is composited only when what it
+  shows changes. Each frame then copies the masks into the frame as
+  opaque boxes, so the text no longer depends on the surface under it.
+
+  A line is described each frame as runs of label strips and numbers:
+  begin(), label(), number(), end(color). end() compares the runs with
+  the ones the mask was made from and recomposes only if they differ.
+  Strips are masks of fixed labels (mode names, "FPS:") rendered once
+  from the glyph cache; numbers are laid out from its digit glyphs, with
+  no printf.
+
+  The glyph cache (HudFont) is filled once at boot, on the device from
+  the panel's own font, so the text looks the same as before.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_HUD_H
+#define HECTOR_HUD_H
+
+#include <stdint.h>
+#include <string.h>
+#include "raster.h"
+
+#define HUD_GLYPH_W 6
+#define HUD_GLYPH_H 8
+#define HUD_FIRST_CHAR 32  // printable ASCII: ' ' to '~'
+#define HUD_CHAR_COUNT 95
+
+#define HUD_STRIP_CHARS 12
+#define HUD_STRIP_BYTES ((HUD_STRIP_CHARS * HUD_GLYPH_W + 7) / 8)
+#define HUD_LINE_CHARS 20
+#define HUD_LINE_BYTES ((HUD_LINE_CHARS * HUD_GLYPH_W + 7) / 8)
+#define HUD_LINE_RUNS 3
+
+// One mask per character, a byte per row, leftmost pixel in the top bit
+struct HudFont {
+  uint8_t rows[HUD_CHAR_COUNT][HUD_GLYPH_H] = {};
+
+  const uint8_t* glyph(char c) const {
+    uint8_t i = (uint8_t)(c - HUD_FIRST_CHAR);
+    return rows[i < HUD_CHAR_COUNT ? i : 0];
+  }
+};
+
+// OR bits (top bit first) into a row at pixel x. Bits past the end of src
+// must be clear: they may spill, as zeros, into the next byte.
+inline void hudOrBits(uint8_t* dst, int x, const uint8_t* src, int bits) {
+  uint8_t* d = dst + (x >> 3);
+  const int shift = x & 7;
+  for (int i = 0; i < (bits + 7) >> 3; i++) {
+    d[i] |= (uint8_t)(src[i] >> shift);
+    if (shift) d[i + 1] |= (uint8_t)(src[i] << (8 - shift));
+  }
+}
+
+// A fixed label rendered once, up to HUD_STRIP_CHARS characters
+struct HudStrip {
+  uint8_t chars = 0;
+  uint8_t rows[HUD_GLYPH_H][HUD_STRIP_BYTES + 1] = {};  // a spare byte for hudOrBits()
+
+  void render(const HudFont& font, const char* text) {
+    memset(rows, 0, sizeof(rows));
+    chars = 0;
+    for (; text[chars] && chars < HUD_STRIP_CHARS; chars++) {
+      const uint8_t* g = font.glyph(text[chars]);
+      for (int y = 0; y < HUD_GLYPH_H; y++) hudOrBits(rows[y], chars * HUD_GLYPH_W, &g[y], HUD_GLYPH_W);
+    }
+  }
+};
+
+// Right-aligned in width characters (more if it needs them), with a
+// point before the last decimals digits; no heap, no printf
+inline int hudFormat(char* out, int32_t value, uint8_t width, uint8_t decimals) {
+  char digits[12];
+  int n = 0;
+  uint32_t v = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+  do {
+    if (decimals && n == decimals) digits[n++] = '.';
+    digits[n++] = (char)('0' + v % 10);
+    v /= 10;
+  } while (v || (decimals && n <= decimals));
+  if (value < 0) digits[n++] = '-';
+  int len = 0;
+  while (len + n < width) out[len++] = ' ';
+  while (n) out[len++] = digits[--n];
+  return len;
+}
+
+class HudLine {
+public:
+  void place(int16_t px, int16_t py) {
+    x = px;
+    y = py;
+  }
+
+  // This frame's content, as label and number runs
+  void begin() { pendingCount = 0; }
+
+  void label(const HudStrip& s) {
+    if (pendingCount == HUD_LINE_RUNS) return;
+    Run& r = pending[pendingCount++];
+    r.strip = &s;
+    r.value = 0;
+    r.width = r.decimals = 0;
+  }
+
+  void number(int32_t value, uint8_t width, uint8_t decimals = 0) {
+    if (pendingCount == HUD_LINE_RUNS) return;
+    Run& r = pending[pendingCount++];
+    r.strip = nullptr;
+    r.value = value;
+    r.width = width < HUD_LINE_CHARS ? width : HUD_LINE_CHARS;
+    r.decimals = decimals;
+  }
+
+  // Show the content in color: true if the mask had to be recomposed
+  bool end(const HudFont& font, uint16_t textColor) {
+    bool same = shown && textColor == color && pendingCount == runCount;
+    for (int i = 0; same && i < runCount; i++) same = pending[i] == runs[i];
+    shown = true;
+    if (same) return false;
+    color = textColor;
+    runCount = pendingCount;
+    for (int i = 0; i < runCount; i++) runs[i] = pending[i];
+    compose(font);
+    return true;
+  }
+
+  // Not shown this frame; the mask is kept for when it is
+  void hide() { shown = false; }
+
+  bool visible() const { return shown && chars; }
+  int width() const { return chars * HUD_GLYPH_W; }
+  int stride() const { return (width() + 7) >> 3; }
+  const uint8_t* mask() const { return bits; }
+
+  int16_t x = 0, y = 0;
+  uint16_t color = 0;
+
+private:
+  struct Run {
+    const HudStrip* strip;
+    int32_t value;
+    uint8_t width, decimals;
+
+    bool operator==(const Run& o) const {
+      return strip == o.strip && (strip || (value == o.value && width == o.width && decimals == o.decimals));
+    }
+  };
+
+  // Strips and number glyphs side by side, rows packed at stride()
+  void compose(const HudFont& font) {
+    uint8_t rows[HUD_GLYPH_H][HUD_LINE_BYTES + 1];
+    memset(rows, 0, sizeof(rows));
+    chars = 0;
+    for (int i = 0; i < runCount; i++) {
+      const Run& r = runs[i];
+      if (r.strip) {
+        const int n = r.strip->chars < HUD_LINE_CHARS - chars ? r.strip->chars : HUD_LINE_CHARS - chars;
+        for (int y = 0; y < HUD_GLYPH_H; y++) hudOrBits(rows[y], chars * HUD_GLYPH_W, r.strip->rows[y], n * HUD_GLYPH_W);
+        chars += n;
+        continue;
+      }
+      char text[HUD_LINE_CHARS + 12];
+      const int len = hudFormat(text, r.value, r.width, r.decimals);
+      for (int c = 0; c < len && chars < HUD_LINE_CHARS; c++, chars++) {
+        const uint8_t* g = font.glyph(text[c]);
+        for (int y = 0; y < HUD_GLYPH_H; y++) hudOrBits(rows[y], chars * HUD_GLYPH_W, &g[y], HUD_GLYPH_W);
+      }
+    }
+    // A strip cut short leaves bits past the last character
+    const int w = width();
+    for (int y = 0; y < HUD_GLYPH_H; y++) {
+      if (w & 7) rows[y][w >> 3] &= (uint8_t)(0xFF << (8 - (w & 7)));
+      memcpy(bits + y * stride(), rows[y], stride());
+    }
+  }
+
+  Run runs[HUD_LINE_RUNS], pending[HUD_LINE_RUNS];
+  uint8_t runCount = 0, pendingCount = 0;
+  uint8_t chars = 0;
+  bool shown = false;
+  uint8_t bits[HUD_GLYPH_H * HUD_LINE_BYTES] = {};
+};
+
+// A line's mask as an opaque box: textColor on bg, clipped to the frame
+inline void fbDrawHudLine(FrameBuffer& fb, const HudLine& line, uint16_t bg) {
+  const uint16_t fg = fbSwap565(line.color);
+  const uint16_t back = fbSwap565(bg);
+  const int stride = line.stride();
+  const int i0 = line.x < 0 ? -line.x : 0;
+  const int i1 = line.x + line.width() > fb.width ? fb.width - line.x : line.width();
+  for (int row = 0; row < HUD_GLYPH_H; row++) {
+    const int32_t py = line.y + row;
+    if (py < 0 || py >= fb.height) continue;
+    const uint8_t* m = line.mask() + row * stride;
+    uint16_t* p = fb.pixels + py * fb.width + line.x;
+    uint8_t bits = (uint8_t)(m[i0 >> 3] << (i0 & 7));
+    for (int i = i0; i < i1; i++) {
+      if ((i & 7) == 0) bits = m[i >> 3];
+      p[i] = (bits & 0x80) ? fg : back;
+      bits <<= 1;
+    }
+  }
+}
+
+// The lines of the overlay at their fixed places, and how often any of
+// them had to be recomposed
+template <int LINES>
+class HudLayer {
+public:
+  HudLine& line(int i) { return lines[i]; }
+  const HudLine& line(int i) const { return lines[i]; }
+
+  bool end(int i, uint16_t color) {
+    bool changed = lines[i].end(font, color);
+    composites += changed;
+    return changed;
+  }
+
+  // Recompose every line at its next end(), after the strips change
+  void invalidate() {
+    for (int i = 0; i < LINES; i++) lines[i].hide();
+  }
+
+  void draw(FrameBuffer& fb, uint16_t bg) const {
+    for (int i = 0; i < LINES; i++) {
+      if (lines[i].visible()) fbDrawHudLine(fb, lines[i], bg);
+    }
+  }
+
+  HudFont font;
+  uint32_t composites = 0;
+
+private:
+  HudLine lines[LINES];
+};
+
+#endif // HECTOR_HUD_H
@@ -0,0 +1,198 @@
+/*
+  IMU fusion for Hector
+
+  A Mahony filter: the gyro is integrated into an orientation quaternion
+  and the accelerometer pulls the gravity direction of that orientation
+  back toward what it measures, in proportion to the error plus a small
+  integral that learns the gyro bias. A reading is trusted less the
+  further its magnitude is from 1 g, and not at all beyond accelGate: it
+  is a shake or a swing, not gravity, and linear acceleration no longer
+  tilts the estimate.
+
+  Gravity alone cannot see yaw, which drifts freely; Hector only uses the
+  gravity direction, quatGravity().
+
+  The sensor task publishes an OrientationSample (orientation, rate, time)
+  and the frame predicts it forward by its rate to the time it will be on
+  screen, orientationPredict().
+
+  mpu6886Decode() reads one packet of the MPU6886 FIFO (accelerometer,
+  temperature, gyro, big-endian) at the full scales M5Unified sets.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_IMU_FUSION_H
+#define HECTOR_IMU_FUSION_H
+
+#include <stdint.h>
+#include <math.h>
+
+#define FUSION_DEG_TO_RAD 0.017453292f
+
+struct Quat {
+  float w = 1, x = 0, y = 0, z = 0;
+};
+
+inline Quat quatMultiply(const Quat& a, const Quat& b) {
+  Quat q;
+  q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+  q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+  q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+  q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+  return q;
+}
+
+inline Quat quatNormalize(Quat q) {
+  float n = sqrtf(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+  if (n == 0) return Quat();
+  n = 1 / n;
+  q.w *= n;
+  q.x *= n;
+  q.y *= n;
+  q.z *= n;
+  return q;
+}
+
+// q turned by body rates (rad/s) held for dt seconds
+inline Quat quatIntegrate(const Quat& q, float gx, float gy, float gz, float dt) {
+  Quat d;
+  d.w = 0;
+  d.x = gx * 0.5f * dt;
+  d.y = gy * 0.5f * dt;
+  d.z = gz * 0.5f * dt;
+  Quat r = quatMultiply(q, d);
+  r.w += q.w;
+  r.x += q.x;
+  r.y += q.y;
+  r.z += q.z;
+  return quatNormalize(r);
+}
+
+// Roll and pitch that put gravity where an accelerometer reading says,
+// yaw 0
+inline Quat quatFromGravity(float ax, float ay, float az) {
+  float roll = atan2f(ay, az);
+  float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+  float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+  float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+  Quat q;
+  q.w = cr * cp;
+  q.x = sr * cp;
+  q.y = cr * sp;
+  q.z = -sr * sp;
+  return q;
+}
+
+// What an accelerometer at rest reads in this orientation, in g
+inline void quatGravity(const Quat& q, float& x, float& y, float& z) {
+  x = 2 * (q.x * q.z - q.w * q.y);
+  y = 2 * (q.w * q.x + q.y * q.z);
+  z = q.w * q.w - q.x * q.x - q.y * q.y + q.z * q.z;
+}
+
+struct ImuReading {
+  float accX, accY, accZ;     // g
+  float gyroX, gyroY, gyroZ;  // dps
+};
+
+struct FusionConfig {
+  float kp = 2.0f;          // 1/s, pull toward the measured gravity
+  float ki = 1.0f;          // 1/s^2, gyro bias learning
+  float accelGate = 0.05f;  // g away from 1 g at which a reading stops counting as gravity
+};
+
+class MahonyFilter {
+public:
+  void begin(const FusionConfig& c) {
+    config = c;
+    started = false;
+    q = Quat();
+    biasX = biasY = biasZ = 0;
+    rateX = rateY = rateZ = 0;
+  }
+
+  // One reading, dt seconds after the last; the first only sets the tilt
+  void update(const ImuReading& r, float dt) {
+    float norm = sqrtf(r.accX * r.accX + r.accY * r.accY + r.accZ * r.accZ);
+    if (!started) {
+      if (norm == 0) return;
+      q = quatFromGravity(r.accX, r.accY, r.accZ);
+      started = true;
+    }
+
+    float gx = r.gyroX * FUSION_DEG_TO_RAD;
+    float gy = r.gyroY * FUSION_DEG_TO_RAD;
+    float gz = r.gyroZ * FUSION_DEG_TO_RAD;
+    float ex = 0, ey = 0, ez = 0;
+    gravityWeight = norm > 0 ? 1 - fabsf(norm - 1) / config.accelGate : 0;
+    if (gravityWeight > 0) {
+      float ax = r.accX / norm, ay = r.accY / norm, az = r.accZ / norm;
+      float vx, vy, vz;
+      quatGravity(q, vx, vy, vz);
+      ex = (ay * vz - az * vy) * gravityWeight;
+      ey = (az * vx - ax * vz) * gravityWeight;
+      ez = (ax * vy - ay * vx) * gravityWeight;
+      biasX -= config.ki * ex * dt;
+      biasY -= config.ki * ey * dt;
+      biasZ -= config.ki * ez * dt;
+    } else {
+      gravityWeight = 0;
+    }
+
+    rateX = gx - biasX;
+    rateY = gy - biasY;
+    rateZ = gz - biasZ;
+    q = quatIntegrate(q, rateX + config.kp * ex, rateY + config.kp * ey, rateZ + config.kp * ez, dt);
+  }
+
+  bool ready() const { return started; }
+  const Quat& orientation() const { return q; }
+  float gravityTrust() const { return gravityWeight; }  // 0..1, of the last reading
+
+  // Gyro minus the learnt bias, rad/s
+  float rateX = 0, rateY = 0, rateZ = 0;
+  float biasX = 0, biasY = 0, biasZ = 0;
+
+private:
+  FusionConfig config;
+  Quat q;
+  bool started = false;
+  float gravityWeight = 0;
+};
+
+// Published by the sensor task, read at frame time
+struct OrientationSample {
+  Quat q;
+  float rateX = 0, rateY = 0, rateZ = 0;  // rad/s
+  uint32_t timeUs = 0;                    // of q
+};
+
+// s turned forward by its rate to nowUs + leadUs, at most maxUs ahead
+inline Quat orientationPredict(const OrientationSample& s, uint32_t nowUs, uint32_t leadUs, uint32_t maxUs) {
+  int32_t ahead = (int32_t)(nowUs - s.timeUs) + (int32_t)leadUs;
+  if (ahead <= 0) return s.q;
+  if ((uint32_t)ahead > maxUs) ahead = (int32_t)maxUs;
+  return quatIntegrate(s.q, s.rateX, s.rateY, s.rateZ, ahead * 1e-6f);
+}
+
+// MPU6886 FIFO with accelerometer and gyro enabled: 14-byte packets
+#define MPU6886_FIFO_PACKET 14
+#define MPU6886_ACCEL_LSB_PER_G 4096.0f  // +-8 g
+#define MPU6886_GYRO_LSB_PER_DPS 16.4f   // +-2000 dps
+
+inline ImuReading mpu6886Decode(const uint8_t* p) {
+  int16_t v[7];
+  for (int i = 0; i < 7; i++) v[i] = (int16_t)((p[2 * i] << 8) | p[2 * i + 1]);
+  ImuReading r;
+  r.accX = v[0] / MPU6886_ACCEL_LSB_PER_G;
+  r.accY = v[1] / MPU6886_ACCEL_LSB_PER_G;
+  r.accZ = v[2] / MPU6886_ACCEL_LSB_PER_G;
+  // v[3] is the temperature
+  r.gyroX = v[4] / MPU6886_GYRO_LSB_PER_DPS;
+  r.gyroY = v[5] / MPU6886_GYRO_LSB_PER_DPS;
+  r.gyroZ = v[6] / MPU6886_GYRO_LSB_PER_DPS;
+  return r;
+}
+
+#endif // HECTOR_IMU_FUSION_H
@@ -0,0 +1,170 @@
+/*
+  Button gestures for Hector
+
+  Raw edges (a button went down or up, and when) come from the GPIO
+  interrupts, or from polling the pin levels, and GestureDetector turns
+  them into gestures:
+
+    - PRESS when a button goes down, at once
+    - CLICK after a short press once the double-click window has passed
+    - DOUBLE_CLICK on the second press within that window
+    - LONG_PRESS once a button has been held longPressUs (no CLICK follows)
+
+  Debouncing takes the first edge of a change straight away and ignores
+  the contact bounce for debounceUs after it; a level that is still
+  different once that time is up (the bounce ended on the other level)
+  is taken by tick(). Every gesture keeps the time of the edge that made
+  it, so the frame that shows its effect can tell the latency.
+
+  edge() and tick() run on one task; the interrupt side only pushes
+  InputEdge records into a queue.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_INPUT_H
+#define HECTOR_INPUT_H
+
+#include <stdint.h>
+
+enum InputButton : uint8_t {
+  INPUT_BUTTON_A,
+  INPUT_BUTTON_B,
+  INPUT_BUTTON_PWR,
+  INPUT_BUTTON_COUNT
+};
+
+enum InputGesture : uint8_t {
+  GESTURE_PRESS,
+  GESTURE_CLICK,
+  GESTURE_DOUBLE_CLICK,
+  GESTURE_LONG_PRESS,
+  GESTURE_COUNT
+};
+
+static const char* const inputGestureNames[GESTURE_COUNT] = { "PRESS", "CLICK", "DOUBLE", "LONG" };
+
+// One raw transition of a button, from an interrupt or a poll
+struct InputEdge {
+  uint8_t button;
+  bool pressed;
+  uint32_t timeUs;
+};
+
+struct InputEvent {
+  uint8_t button;
+  InputGesture gesture;
+  uint32_t timeUs;  // the edge that made the gesture (for LONG_PRESS, when it became long)
+};
+
+struct InputConfig {
+  uint32_t debounceUs = 10000;
+  uint32_t doubleClickUs = 300000;  // release to the next press
+  uint32_t longPressUs = 600000;
+};
+
+#define INPUT_EVENT_CAPACITY 16
+
+class GestureDetector {
+public:
+  void begin(const InputConfig& c, uint32_t nowUs) {
+    config = c;
+    for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+      buttons[b] = ButtonState();
+      buttons[b].changedUs = nowUs - c.debounceUs;
+    }
+    head = tail = 0;
+  }
+
+  void edge(const InputEdge& e) {
+    if (e.button >= INPUT_BUTTON_COUNT) return;
+    ButtonState& s = buttons[e.button];
+    s.raw = e.pressed;
+    s.rawUs = e.timeUs;
+    if (e.pressed != s.down && after(e.timeUs, s.changedUs + config.debounceUs)) change(e.button, e.pressed, e.timeUs);
+  }
+
+  // Timeouts: a settled level, a long press, a click without a second one
+  void tick(uint32_t nowUs) {
+    for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+      ButtonState& s = buttons[b];
+      uint32_t settled = s.changedUs + config.debounceUs;
+      if (s.raw != s.down && after(nowUs, settled)) change(b, s.raw, after(s.rawUs, settled) ? s.rawUs : settled);
+      if (s.down && !s.longSent && after(nowUs, s.pressUs + config.longPressUs)) {
+        s.longSent = true;
+        emit(b, GESTURE_LONG_PRESS, s.pressUs + config.longPressUs);
+      }
+      if (s.clickPending && !after(s.releaseUs + config.doubleClickUs, nowUs)) {
+        s.clickPending = false;
+        emit(b, GESTURE_CLICK, s.releaseUs);
+      }
+    }
+  }
+
+  bool next(InputEvent& e) {
+    if (tail == head) return false;
+    e = events[tail++ % INPUT_EVENT_CAPACITY];
+    return true;
+  }
+
+  // The debounced level, and the level of the last edge seen
+  bool pressed(int button) const { return buttons[button].down; }
+  bool rawPressed(int button) const { return buttons[button].raw; }
+
+  // Gestures lost because nobody drained next() in time
+  uint32_t dropped() const { return drops; }
+
+private:
+  struct ButtonState {
+    bool down = false;          // debounced
+    bool raw = false;           // the last edge
+    bool longSent = false;      // this press already made a LONG_PRESS
+    bool secondPress = false;   // this press made a DOUBLE_CLICK
+    bool clickPending = false;  // released, waiting out the double-click window
+    uint32_t changedUs = 0, rawUs = 0, pressUs = 0, releaseUs = 0;
+  };
+
+  void change(int b, bool down, uint32_t timeUs) {
+    ButtonState& s = buttons[b];
+    s.down = down;
+    s.changedUs = timeUs;
+    if (down) {
+      bool second = false;
+      if (s.clickPending) {
+        s.clickPending = false;
+        second = after(s.releaseUs + config.doubleClickUs, timeUs);
+        if (!second) emit(b, GESTURE_CLICK, s.releaseUs);  // tick() did not run in between
+      }
+      s.pressUs = timeUs;
+      s.longSent = false;
+      s.secondPress = second;
+      emit(b, GESTURE_PRESS, timeUs);
+      if (second) emit(b, GESTURE_DOUBLE_CLICK, timeUs);
+    } else if (!s.longSent && !s.secondPress) {
+      s.clickPending = true;
+      s.releaseUs = timeUs;
+    }
+  }
+
+  // a at or after b, across the wrap of the microsecond clock
+  static bool after(uint32_t a, uint32_t b) { return (int32_t)(a - b) >= 0; }
+
+  void emit(int b, InputGesture g, uint32_t timeUs) {
+    if (head - tail >= INPUT_EVENT_CAPACITY) {
+      drops++;
+      return;
+    }
+    InputEvent& e = events[head++ % INPUT_EVENT_CAPACITY];
+    e.button = (uint8_t)b;
+    e.gesture = g;
+    e.timeUs = timeUs;
+  }
+
+  InputConfig config;
+  ButtonState buttons[INPUT_BUTTON_COUNT];
+  InputEvent events[INPUT_EVENT_CAPACITY];
+  uint32_t head = 0, tail = 0;
+  uint32_t drops = 0;
+};
+
+#endif // HECTOR_INPUT_H
@@ -0,0 +1,58 @@
+/*
+  Adaptive level of detail for Hector
+
+  Picks the grid density (columns per scan row) from the measured frame
+  rate. Rows follow the columns, so the vertex count and with it most of
+  the frame cost grow with the square of the density: the controller
+  scales the columns by sqrt(fps / target), damped and limited per step,
+  and leaves them alone while the frame rate is within the deadband.
+
+  Pure C++ with no Arduino dependencies: update() can be driven from
+  recorded frame rates on the host.
+*/
+
+#ifndef HECTOR_LOD_H
+#define HECTOR_LOD_H
+
+#include <math.h>
+
+class LodController {
+public:
+  void begin(int minCols, int maxCols, float deadband = 0.1f, float gain = 0.5f, int maxStep = 4) {
+    lo = minCols;
+    hi = maxCols;
+    band = deadband;
+    damping = gain;
+    stepLimit = maxStep;
+  }
+
+  // Columns for the next period, given the columns used and the frame
+  // rate measured over the last one
+  int update(int cols, float fps, float targetFps) const {
+    if (fps <= 0 || targetFps <= 0) return clamp(cols);
+
+    float ratio = fps / targetFps;
+    if (ratio > 1 - band && ratio < 1 + band) return clamp(cols);
+
+    float change = cols * (sqrtf(ratio) - 1) * damping;
+    int delta = (int)lroundf(change);
+    if (delta == 0) delta = ratio > 1 ? 1 : -1;
+    if (delta > stepLimit) delta = stepLimit;
+    if (delta < -stepLimit) delta = -stepLimit;
+    return clamp(cols + delta);
+  }
+
+  int clamp(int cols) const { return cols < lo ? lo : (cols > hi ? hi : cols); }
+
+  int minCols() const { return lo; }
+  int maxCols() const { return hi; }
+
+private:
+  int lo = 9;
+  int hi = 48;
+  float band = 0.1f;
+  float damping = 0.5f;
+  int stepLimit = 4;
+};
+
+#endif // HECTOR_LOD_H
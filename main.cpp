@@ -12,6 +12,31 @@
 #include <M5StickCPlus2.h>
 #include <math.h>
 #include <driver/i2s.h> // NEW: For proper I2S microphone reading
+#include <esp_heap_caps.h> // PSRAM / DMA-capable framebuffer allocation
+#include <LittleFS.h>      // Sensor trace storage
+#include "rom_math.h"     // Table-driven sin/cos/sqrt/log
+#include "raster.h"       // Off-screen rasterizer for the framebuffer mode
+#include "pipeline.h"     // Compute/render hand-off between the two cores
+#include "audio_analysis.h" // Incremental DC/RMS/peak for the microphone
+#include "spectrum.h"     // FFT band analysis for the spectrum mode
+#include "vertex_buffer.h" // Row-major SoA storage for projected vertices
+#include "lod.h"          // Grid density from the measured frame rate
+#include "projection.h"   // Float and fixed-point row projection
+#include "palette.h"      // Per-row/column base colors and height brightness
+#include "scheduler.h"    // Frame pacing, fixed-step time and periodic jobs
+#include "profiler.h"     // Per-stage min/avg/p99 timings
+#include "trace.h"        // Sensor trace record and replay
+#include "dirty_tiles.h"  // Changed-tile detection for partial panel updates
+#include "power.h"        // Idle detection and per-level frame rate, clock, backlight
+#include "formula.h"      // User surface formulas compiled to row bytecode
+#include "imu_fusion.h"   // Mahony orientation filter and MPU6886 FIFO packets
+#include "input.h"        // Debounced button gestures from timestamped edges
+#include "hud.h"          // Retained status text from cached glyphs
+#if defined(CONFIG_PM_ENABLE)
+#include <esp_pm.h>       // CPU clock and automatic light sleep per power level
+#include <esp_sleep.h>
+#include <driver/gpio.h>
+#endif
 
 // Remove conflicting definitions
 #ifdef PI
@@ -24,16 +49,26 @@
 #define PI 3.14159265359
 #define TWO_PI 6.28318530718
 
-float romsin(float x) { return sin(x); }
-float romcos(float x) { return cos(x); }
-float romsqrt(float x) { return sqrt(x); }
-float romlog(float x) { return log(x); }
-float rompow(float x) { return x * x; }
+// Surface math goes through the ROM tables instead of double precision libm
+inline float romsin(float x) { return romSinF(x); }
+inline float romcos(float x) { return romCosF(x); }
+inline float romsqrt(float x) { return romSqrtF(x); }
+inline float romlog(float x) { return romLogF(x); }
+inline float rompow(float x) { return x * x; }
 
 // Scaled down for M5StickC Plus2's display (135x240)
 #define SIZE 60
 #define STEP 2
-#define GRID_SIZE (SIZE/STEP)
+
+// Grid capacity. The arena size is fixed; how many columns and rows are
+// used within it is chosen at runtime from step (see the LOD controller).
+#ifndef GRID_MAX_COLS
+#define GRID_MAX_COLS 48
+#endif
+#define GRID_MAX_ROWS GRID_MAX_COLS
+#ifndef GRID_ARENA_VERTICES
+#define GRID_ARENA_VERTICES 1280
+#endif
 
 // 3D animation parameters (scaled for smaller screen)
 static float size = SIZE;
@@ -46,7 +81,6 @@ static float zoom = 1.33;
 static float k = 0;
 static float romcosav, romsinav, romcosah, romsinah;
 
-static int num = GRID_SIZE;
 static int fps = 0;
 
 static uint16_t screenWidth = 240;  // Landscape width (was 135)
@@ -54,9 +88,9 @@ static uint16_t screenHeight = 135; // Landscape height (was 200)
 static uint16_t screenHalfWidth = screenWidth / 2;
 static uint16_t screenHalfHeight = screenHeight / 2;
 
-static uint8_t maxrangecolor = 255;
-static uint8_t minrangecolor = 0;
-static uint8_t green, red, blue;
+// Surface colors: the power button cycles the palette, the tables are
+// rebuilt on the compute side the next frame
+static PaletteId paletteId = PALETTE_CLASSIC;
 
 static unsigned long framecount = 0;
 static uint32_t fstart = 0;
@@ -64,13 +98,152 @@ static uint32_t fstart = 0;
 bool sound = false;
 bool paused = false;
 
-struct Coords {
-  int16_t x = -1;
-  int16_t y = -1;
-  uint16_t color = 0;
+// One scan row of projected vertices, indexed by scan column
+typedef VertexRow GridRow;
+
+// Still scenes: when the surface does not move with time (FLAT, quiet
+// SOUND, TILT without gyro ripple) and the tilt stays within STILL_ACC of
+// the frame on screen, the frame is neither computed nor drawn again.
+// Set to 0 to draw every frame.
+#ifndef HECTOR_STILL_SKIP
+#define HECTOR_STILL_SKIP 1
+#endif
+#define STILL_ACC    0.002f  // g; under half a pixel at the edge of the grid
+#define STILL_RIPPLE 1.0f    // TILT gyro ripple amplitude that still counts as flat
+
+// What a frame was computed from, as far as a still surface goes
+struct SceneKey {
+  bool still = false;  // a key that is not still never matches
+  int style = -1;
+  int palette = -1;
+  float size = 0, step = 0;
+  float accX = 0, accY = 0;  // camera, and the plane in TILT
+  uint32_t formula = 0;      // formulas taken over, for FORMULA
+};
+
+static inline bool sceneMatches(const SceneKey& a, const SceneKey& b) {
+  return a.still && b.still && a.style == b.style && a.palette == b.palette &&
+         a.size == b.size && a.step == b.step && a.formula == b.formula &&
+         fabsf(a.accX - b.accX) < STILL_ACC && fabsf(a.accY - b.accY) < STILL_ACC;
+}
+
+// What the last command changed, shown over the status text for BANNER_MS
+enum BannerKind : uint8_t {
+  BANNER_NONE,
+  BANNER_STYLE,
+  BANNER_WAVE,
+  BANNER_PALETTE,
+  BANNER_AUTO
+};
+#define BANNER_MS 1000
+
+// What the render stage shows besides the rows, fixed when the frame is
+// computed so a command never changes a frame halfway through
+struct FrameStatus {
+  uint8_t display = 0;           // DisplayStyle
+  bool overlay = false;          // profiler overlay
+  uint8_t banner = BANNER_NONE;
+  bool autoMode = false;
+  uint32_t inputUs = 0;          // first button edge behind the commands applied, 0 without
+  float soundLevel = 0;          // SOUND readouts from the frame's sensor snapshot, 0 in other modes
+  float soundPower = 0;
+};
+
+// One computed frame: projected vertices and colors, handed from the
+// compute stage to the render stage
+struct HectorFrame {
+  VertexArena<GRID_ARENA_VERTICES, GRID_MAX_ROWS> grid;
+  uint32_t number = 0;  // frame sequence number
+  bool frontToBack = false;  // rows arrive nearest first (see beginRaster())
+  SceneKey scene;  // the rows are kept while the scene matches
+  FrameStatus status;
+};
+
+// Projection policy: 0 = float (the reference), 1 = fixed point with Q8
+// coordinates and a table reciprocal instead of the float divide
+#ifndef HECTOR_FIXED_PROJECTION
+#define HECTOR_FIXED_PROJECTION 0
+#endif
+
+#if HECTOR_FIXED_PROJECTION
+typedef FixedProjection<GRID_MAX_COLS> RowProjection;
+#else
+typedef FloatProjection<GRID_MAX_COLS> RowProjection;
+#endif
+
+static RowProjection projection;
+
+// Dual-core pipeline: surface evaluation and projection run in a task on
+// core 0 while loop() rasterizes the previous frame on core 1.
+// Set to 0 to run both stages back to back in loop().
+#ifndef HECTOR_PIPELINE
+#define HECTOR_PIPELINE 1
+#endif
+
+#if HECTOR_PIPELINE
+static FrameExchange<HectorFrame> frameExchange;
+#endif
+// Without the pipeline rows are drawn as they are computed, so only two
+// rows of vertices are ever stored
+static RowWindow<GRID_MAX_COLS> rowWindow;
+static PipelineStats pipelineStats;
+static bool pipelineRunning = false;
+static uint32_t computedFrames = 0;
+static uint32_t lastRenderStart = 0;
+
+// Frame scheduler: loop() starts a frame on every slot of the target rate
+// and runs the sensor and button jobs between frames. The animation
+// advances in fixed steps of simulated time, independent of the frame rate.
+#ifndef HECTOR_TARGET_FPS
+#define HECTOR_TARGET_FPS 60
+#endif
+#ifndef HECTOR_SIM_HZ
+#define HECTOR_SIM_HZ 30
+#endif
+#define BUTTON_PERIOD_US 20000
+#define IMU_PERIOD_US    50000
+#define AUDIO_PERIOD_US  10000  // only drains the DMA buffers without the capture task
+#define TRACE_PERIOD_US  20000
+#define POWER_PERIOD_US  50000
+#define SERIAL_PERIOD_US 50000
+
+static Scheduler<6> scheduler;
+static FixedStepClock simClock;
+static float simK = 0;  // k at the last whole step
+
+// Profiler stages; the names head the telemetry columns and the overlay
+enum ProfileStageId {
+  PROF_BUTTONS,
+  PROF_IMU,
+  PROF_AUDIO,    // one analyzed DMA block
+  PROF_SURFACE,  // height evaluation, per frame
+  PROF_SHADE,
+  PROF_PROJECT,
+  PROF_DRAW,
+  PROF_HUD,      // status text and overlay, per frame
+  PROF_FLUSH,    // DMA wait + push
+  PROF_PUSH,     // bytes sent to the panel, not microseconds
+  PROF_FRAME,    // render start to render start
+  PROF_INPUT,    // button edge to the frame that shows it pushed
+  PROF_STAGE_COUNT
+};
+
+static const char* const profileStageNames[PROF_STAGE_COUNT] = {
+  "btn", "imu", "audio", "surf", "shade", "proj", "draw", "hud", "flush", "push", "frame", "input"
 };
 
-static Coords HectorGrid[GRID_SIZE + 1][GRID_SIZE + 1];
+static Profiler profiler;
+static ProfileSummary profileSummary[PROF_STAGE_COUNT];  // last second, for the overlay
+static bool profileOverlay = false;
+
+// Power governor: with the stick lying still in a quiet room, steps the
+// frame rate, CPU clock and backlight down; motion, sound or a button
+// brings it back at once. Set to 0 to always run at full speed.
+#ifndef HECTOR_POWER
+#define HECTOR_POWER 1
+#endif
+
+static PowerGovernor power;
 
 enum DisplayStyle {
   DISPLAY_GRID,
@@ -78,6 +251,7 @@ enum DisplayStyle {
   DISPLAY_ZEBRA,
   DISPLAY_CHECKBOARD
 };
+#define DISPLAY_STYLE_COUNT (DISPLAY_CHECKBOARD + 1)
 
 enum WaveStyle {
   DRIP_WAVE,
@@ -89,44 +263,321 @@ enum WaveStyle {
   INTERFERENCE,   // NEW: Interference patterns
   MOUNTAIN_RANGE, // NEW: Mountain landscape
   RIPPLE_TANK,    // NEW: Multiple ripple sources
-  PLASMA_FIELD    // NEW: Plasma-like energy field
+  PLASMA_FIELD,   // NEW: Plasma-like energy field
+  SPECTRUM_WAVE,  // FFT bands mapped to radial rings
+  FORMULA_WAVE    // User formula from LittleFS or Serial
+};
+#define WAVE_STYLE_COUNT (FORMULA_WAVE + 1)
+
+// Adaptive level of detail: once a second the measured frame rate moves
+// the grid density of the current mode toward that mode's target.
+// Set to 0 to keep the fixed step.
+#ifndef HECTOR_LOD
+#define HECTOR_LOD 1
+#endif
+#define LOD_MIN_COLS 9
+
+static LodController lod;
+#if HECTOR_LOD
+static uint8_t lodCols[WAVE_STYLE_COUNT] = {};  // learned per mode, 0 = not yet
+static bool lodSettling = false;               // compute stage: skip the fps spanning a mode switch
+static bool lodRateChanged = false;            // loop(): skip the fps spanning a power level change
+#endif
+
+// Indexed by WaveStyle; the reactive modes want a faster response
+static const uint8_t lodTargetFps[WAVE_STYLE_COUNT] = {
+  30, // DRIP_WAVE
+  30, // SIN_WAVE
+  30, // FLAT_GRID
+  40, // TILT_REACTIVE
+  40, // SOUND_REACTIVE
+  30, // SPIRAL_WAVE
+  30, // INTERFERENCE
+  30, // MOUNTAIN_RANGE
+  30, // RIPPLE_TANK
+  30, // PLASMA_FIELD
+  40, // SPECTRUM_WAVE
+  30, // FORMULA_WAVE
 };
 
 WaveStyle waveStyle = FLAT_GRID;  // Start with flat grid
 WaveStyle oldWaveStyle = SIN_WAVE;
 DisplayStyle displayStyle = DISPLAY_GRID;
+// The display style of the frame being rendered, from its FrameStatus
+static DisplayStyle frameStyle = DISPLAY_GRID;
+
+static const char* const displayStyleNames[] = {"GRID", "SOLID", "ZEBRA", "CHECK"};
+static const char* const waveStyleNames[WAVE_STYLE_COUNT] = {
+  "DRIP", "SINE", "FLAT", "TILT", "SOUND", "SPIRAL", "INTER", "MOUNT", "RIPPLE", "PLASMA", "SPECTRUM", "FORMULA"
+};
+// The short mode label in the status text
+static const char* const waveLabelNames[WAVE_STYLE_COUNT] = {
+  "DRIP", "SINE", "FLAT", "TILT", "SND", "SPRL", "INTRF", "MNTN", "RIPP", "PLSM", "SPEC", "FX"
+};
+
+// Button B and auto mode, indexed by the current style
+static const WaveStyle nextWaveStyle[WAVE_STYLE_COUNT] = {
+  FORMULA_WAVE,    // DRIP_WAVE
+  DRIP_WAVE,       // SIN_WAVE
+  TILT_REACTIVE,   // FLAT_GRID
+  SOUND_REACTIVE,  // TILT_REACTIVE
+  SPECTRUM_WAVE,   // SOUND_REACTIVE
+  INTERFERENCE,    // SPIRAL_WAVE
+  MOUNTAIN_RANGE,  // INTERFERENCE
+  RIPPLE_TANK,     // MOUNTAIN_RANGE
+  PLASMA_FIELD,    // RIPPLE_TANK
+  SIN_WAVE,        // PLASMA_FIELD
+  SPIRAL_WAVE,     // SPECTRUM_WAVE
+  FLAT_GRID,       // FORMULA_WAVE
+};
+static const DisplayStyle nextDisplayStyle[] = {DISPLAY_SOLID, DISPLAY_ZEBRA, DISPLAY_CHECKBOARD, DISPLAY_GRID};
+static const DisplayStyle autoDisplayStyle[] = {DISPLAY_ZEBRA, DISPLAY_GRID, DISPLAY_CHECKBOARD, DISPLAY_SOLID};
 
 // IMU and sound variables - UPDATED FOR I2S
 float imu_accX = 0, imu_accY = 0, imu_accZ = 0;
 float imu_gyroX = 0, imu_gyroY = 0, imu_gyroZ = 0;
 float soundLevel = 0;
 float soundPower = 0;  // NEW: RMS power measurement
-unsigned long lastIMURead = 0;
-unsigned long lastSoundRead = 0;
+
+// Fused IMU state, published by the IMU task (or job) and turned into the
+// imu_* globals at the start of each computed frame
+struct ImuSample {
+  float accX = 0, accY = 0, accZ = 0;     // g, the latest reading
+  float gyroX = 0, gyroY = 0, gyroZ = 0;  // dps, smoothed
+  OrientationSample orientation;
+};
+static SeqLock<ImuSample> imuSamples;
+
+// IMU fusion: a task drains the MPU6886 FIFO (IMU_RATE_HZ) in bursts and
+// runs every reading through the Mahony filter; each frame then predicts
+// the orientation forward to when it will be on the panel. The task is
+// not started while a trace records or replays, and the IMU job then
+// reads one sample per run, as it does with -DHECTOR_IMU_TASK=0.
+#ifndef HECTOR_IMU_TASK
+#define HECTOR_IMU_TASK 1
+#endif
+#define IMU_RATE_HZ        250
+#define IMU_TASK_PERIOD_US 10000
+#define IMU_FIFO_BATCH     32      // readings per burst at most
+#define IMU_PREDICT_MAX_US 50000
+#define IMU_GYRO_SMOOTH_S  0.22f   // time constant of imu_gyro*, the old 0.8/0.2 at 20 Hz
+#define IMU_I2C_HZ         400000
+
+// MPU6886 registers
+#define MPU6886_ADDR         0x68
+#define MPU6886_SMPLRT_DIV   0x19
+#define MPU6886_CONFIG       0x1A
+#define MPU6886_GYRO_CONFIG  0x1B
+#define MPU6886_ACCEL_CONFIG 0x1C
+#define MPU6886_FIFO_EN      0x23
+#define MPU6886_USER_CTRL    0x6A
+#define MPU6886_FIFO_COUNTH  0x72
+#define MPU6886_FIFO_R_W     0x74
+#define MPU6886_FIFO_SIZE    1024
+
+static MahonyFilter imuFusion;
+static bool imuTaskRunning = false;
+static bool imuFifo = false;  // the FIFO is set up, otherwise the task polls
 
 // I2S Configuration for microphone - NEW
 #define I2S_SAMPLE_RATE 44100
 #define I2S_SAMPLE_BITS 16
-#define I2S_READ_LEN    512
+#define I2S_DMA_BUF_COUNT 8   // 8 x 256 samples = 46 ms of slack for the capture task
+#define I2S_DMA_BUF_LEN   256
 #define I2S_CHANNEL_NUM 1
 #define I2S_MIC_CHANNEL I2S_CHANNEL_FMT_ONLY_RIGHT
 #define I2S_MIC_SERIAL_CLOCK_PIN 0
 #define I2S_MIC_SERIAL_DATA_PIN 34
 
+// Continuous audio capture: a task drains every DMA buffer into the ring
+// and the analyzer, the frame loop only picks up the published levels
+#define AUDIO_RING_LEN 2048
+static SampleRing<AUDIO_RING_LEN> audioRing;
+static AudioAnalyzer audioAnalyzer;
+static SeqLock<AudioLevels> audioLevels;
+static bool audioTaskRunning = false;
+
+// Spectrum mode: a 1024-point FFT every 512 new samples (11.6 ms)
+#define SPECTRUM_FFT_LEN 1024
+#define SPECTRUM_HOP     512
+static SpectrumAnalyzer<SPECTRUM_FFT_LEN> spectrumAnalyzer;
+static SeqLock<SpectrumBands> spectrumBands;
+static int16_t spectrumWindow[SPECTRUM_FFT_LEN];
+static uint32_t samplesSinceFFT = 0;
+SpectrumBands spectrumLevels;  // per-frame snapshot read by spectrumwave()
+
+// Sensor traces: record the raw IMU readings and the published audio
+// levels (optionally the raw microphone samples) to LittleFS or Serial,
+// or replay a recorded trace in place of the sensors
+#define TRACE_OFF    0
+#define TRACE_RECORD 1
+#define TRACE_REPLAY 2
+#ifndef HECTOR_TRACE
+#define HECTOR_TRACE TRACE_OFF
+#endif
+#ifndef HECTOR_TRACE_SERIAL
+#define HECTOR_TRACE_SERIAL 0  // record as TRC lines on Serial instead of the file
+#endif
+#ifndef HECTOR_TRACE_PCM
+#define HECTOR_TRACE_PCM 0     // also record the microphone samples, file only (88 KB/s)
+#endif
+#define TRACE_PATH "/hector.trc"
+
+static int traceMode = TRACE_OFF;
+static TraceWriter traceWriter;
+static TraceReader traceReader;
+static TraceRecord traceRecord;  // next record to replay
+static bool tracePending = false;
+static bool traceReplayPcm = false;
+static TraceImu traceImu;        // latest replayed raw IMU reading
+static uint32_t traceStartUs = 0;
+static uint32_t traceLevelsVersion = 0;
+static uint32_t traceBandsVersion = 0;
+static uint32_t traceSamples = 0;  // audioRing position recorded up to
+static File traceFile;
+
+static uint32_t traceDeviceClock() { return pipelineMicros() - traceStartUs; }
+static uint32_t (*traceClock)() = traceDeviceClock;  // trace time, replaceable on the host
+
 // Manual control variables - ADDED FOR BUTTON CONTROL
 bool autoMode = false;  // Start in manual mode
 unsigned long lastStyleChange = 0;
 unsigned long styleChangeInterval = 5000; // 5 seconds for auto mode
 
+// Buttons: GPIO interrupts timestamp every edge into inputEdges, which the
+// btn job and the start of each frame drain through the gesture detector.
+// Gestures become commands that the compute stage applies between frames.
+// Set to 0 to poll the levels through M5.update() in the btn job instead.
+#ifndef HECTOR_INPUT_IRQ
+#define HECTOR_INPUT_IRQ 1
+#endif
+#define INPUT_PIN_A   37
+#define INPUT_PIN_B   39
+#define INPUT_PIN_PWR 35
+
+enum HectorCommandCode : uint8_t {
+  CMD_NEXT_STYLE,    // button A
+  CMD_AUTO_STYLE,    // auto mode, in its own order
+  CMD_NEXT_WAVE,     // button B
+  CMD_SET_WAVE,      // arg: the WaveStyle
+  CMD_NEXT_PALETTE,  // power button click
+  CMD_PROFILER,      // power button double click
+  CMD_AUTO_MODE,     // power button held
+  CMD_LOD_FPS,       // arg: frames counted over the last second
+};
+
+struct HectorCommand {
+  uint8_t code;
+  uint8_t arg;
+  uint32_t timeUs;  // the button edge behind it, 0 for Serial and auto mode
+};
+
+static SpscQueue<InputEdge, 32> inputEdges;        // interrupts to the btn job
+static SpscQueue<HectorCommand, 16> commandQueue;  // loop() to the compute stage
+static GestureDetector gestures;
+static uint8_t bannerKind = BANNER_NONE;  // compute stage
+static uint32_t bannerUntilMs = 0;
+
+// Off-screen render target: the frame is rasterized into RAM and pushed
+// to the panel in one DMA burst. Set to 0 to draw straight to the panel.
+#ifndef HECTOR_FRAMEBUFFER
+#define HECTOR_FRAMEBUFFER 1
+#endif
+
+// Partial updates: only the tiles that differ from the panel are pushed.
+// Set to 0 to push the whole frame every time.
+#ifndef HECTOR_DIRTY_TILES
+#define HECTOR_DIRTY_TILES 1
+#endif
+#define SCREEN_TILES (((240 + TILE_SIZE - 1) / TILE_SIZE) * ((135 + TILE_SIZE - 1) / TILE_SIZE))
+
+// Status text from cached glyphs, recomposed only when it changes and
+// drawn as opaque boxes at fixed places. Set to 0 to print it every frame.
+#ifndef HECTOR_HUD
+#define HECTOR_HUD 1
+#endif
+
+static FrameBuffer frameBuffers[2];
+static uint8_t backBuffer = 0;
+static bool useFramebuffer = false;  // true once the buffer(s) are allocated
+static bool doubleBuffered = false;  // two PSRAM buffers, DMA overlaps drawing
+static M5Canvas frameCanvas(&M5.Display); // text drawing on the back buffer
+static lgfx::LovyanGFX* gfx = &M5.Display; // target for status text
+static DirtyTiles<SCREEN_TILES> panelTiles;  // what the panel shows, per tile
+static TileRect pushRuns[SCREEN_TILES];
+static uint32_t pushedBytes = 0;             // by the last presentFrame()
+
+#if HECTOR_HUD
+// Status lines at their fixed places: FPS, or a banner in its place, at
+// the top left; the mode, or its full name as a banner, at the top right
+// with the sound readouts under it; the profiler lines down the left
+enum HudLineId {
+  HUD_FPS,
+  HUD_BANNER,
+  HUD_MODE,
+  HUD_WAVE_BANNER,
+  HUD_LEVEL,
+  HUD_POWER,
+  HUD_PROFILE,  // one per profiler stage
+  HUD_LINE_COUNT = HUD_PROFILE + PROF_STAGE_COUNT
+};
+
+static HudLayer<HUD_LINE_COUNT> hud;
+static HudStrip hudModeLabels[WAVE_STYLE_COUNT], hudWaveLabels[WAVE_STYLE_COUNT];
+static HudStrip hudStyleLabels[DISPLAY_STYLE_COUNT], hudPaletteLabels[PALETTE_COUNT];
+static HudStrip hudStageLabels[PROF_STAGE_COUNT];
+static HudStrip hudFpsLabel, hudStyleLabel, hudPaletteLabel, hudAutoLabel, hudOnLabel, hudOffLabel;
+#endif
+
+// The frame on the panel, for skipping still frames
+static SceneKey shownScene;
+static uint32_t shownStatus = 0;
+static uint32_t skippedFrames = 0;
+
 // Function declarations
 void setupScale();
-void resetCoords();
-void drawPath(int scan_y);
-void project(float x, float y, float z, int scan_x, int scan_y);
-void checkButtons();
-void updateIMU();      // Read IMU data
-void updateSound();    // Read microphone data
+int gridColsForStep(float s);
+void applyGridCols(int cols);
+void lodUpdate(int measuredFps);
+void lodReport(int measuredFps);
+void lodSelectMode();
+void drawPath(const GridRow& prev, const GridRow& row, int scan_y);
+struct ComputeState;
+ComputeState beginCompute();
+void computeRow(const ComputeState& state, int scan_y, const GridRow& row);
+void computeFrame(HectorFrame& frame);
+void renderFrame(const HectorFrame& frame);
+void finishFrame(const SceneKey& scene, const FrameStatus& status);
+void frameTick();
+void skipFrame(const FrameStatus& status);
+void streamFrame();
+void computeTask(void* arg);
+void checkButtons();   // Drain the button edges, gestures into commands
+void inputBegin();
+void queueCommand(uint8_t code, uint8_t arg, uint32_t timeUs);
+void applyCommands(FrameStatus& status);
+void setWave(WaveStyle w);
+void updateIMU();      // IMU job: without the task, read and fuse one sample
+void imuTask(void* arg);
+bool imuFifoBegin();
+void updateSound();    // Audio job: drain the microphone without the task
+void loadSensors();    // Per-frame snapshot of the published sensor data
 void initI2S();        // NEW: Initialize I2S for microphone
+void audioTask(void* arg);
+void analyzeAudioBlock(const int16_t* block, size_t samples);
+void traceBegin();     // Open the trace chosen with HECTOR_TRACE
+void updateTrace();    // Trace job: record audio levels or replay due records
+void tracePump(uint32_t nowUs);
+void updatePower();    // Power job: feed the governor, apply a new level
+void applyPowerLevel();
+void formulaBegin();   // Built-in formula, replaced by FORMULA_PATH if there is one
+bool loadFormula(const char* text, const char* from);
+void updateSerial();   // Serial job: "fx <formula>" lines
+void initFramebuffer();
+void beginFrame();
+void presentFrame();
+void hudBegin();       // Glyph cache, label strips and layout of the status text
+void hudRenderLabels();
 
 // Function pointer to sine wave function
 float (*surfaceFunction)(float x, float y, float k);
@@ -237,435 +688,2087 @@ float plasmawave(float x, float y, float k) {
   return (plasma1 + plasma2 + plasma3) * 15;
 }
 
-// NEW: Initialize I2S for proper microphone reading
-void initI2S() {
-  i2s_config_t i2s_config = {
-    .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_PDM),
-    .sample_rate = I2S_SAMPLE_RATE,
-    .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
-    .channel_format = I2S_MIC_CHANNEL,
-    .communication_format = I2S_COMM_FORMAT_I2S,
-    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
-    .dma_buf_count = 2,
-    .dma_buf_len = 256,
-  };
-  
-  i2s_pin_config_t pin_config = {
-    .bck_io_num   = I2S_PIN_NO_CHANGE,
-    .ws_io_num    = I2S_MIC_SERIAL_CLOCK_PIN,
-    .data_out_num = I2S_PIN_NO_CHANGE,
-    .data_in_num  = I2S_MIC_SERIAL_DATA_PIN,
-  };
-  
-  i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
-  i2s_set_pin(I2S_NUM_0, &pin_config);
-  i2s_set_clk(I2S_NUM_0, I2S_SAMPLE_RATE, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_MONO);
+// Spectrum analyzer: each radial ring follows one frequency band, bass in
+// the centre and treble at the rim
+float spectrumwave(float x, float y, float k) {
+  float ring = romsqrt(rompow(x) + rompow(y)) / halfsize * (SPECTRUM_BANDS - 1);
+  int band = (int)ring;
+  if (band >= SPECTRUM_BANDS - 1) {
+    return spectrumLevels.level[SPECTRUM_BANDS - 1] * 50;
+  }
+  float t = ring - band;
+  float level = spectrumLevels.level[band] * (1 - t) + spectrumLevels.level[band + 1] * t;
+  return level * 50;
 }
-// NEW: Update IMU data
-void updateIMU() {
-  if (millis() - lastIMURead > 50) { // Update every 50ms
-    lastIMURead = millis();
-    
-    // Read accelerometer and gyroscope
-    M5.Imu.getAccelData(&imu_accX, &imu_accY, &imu_accZ);
-    M5.Imu.getGyroData(&imu_gyroX, &imu_gyroY, &imu_gyroZ);
-    
-    // Apply smoothing filter to reduce noise
-    static float smoothAccX = 0, smoothAccY = 0;
-    static float smoothGyroX = 0, smoothGyroY = 0;
-    
-    smoothAccX = smoothAccX * 0.8 + imu_accX * 0.2;
-    smoothAccY = smoothAccY * 0.8 + imu_accY * 0.2;
-    smoothGyroX = smoothGyroX * 0.8 + imu_gyroX * 0.2;
-    smoothGyroY = smoothGyroY * 0.8 + imu_gyroY * 0.2;
-    
-    imu_accX = smoothAccX;
-    imu_accY = smoothAccY;
-    imu_gyroX = smoothGyroX;
-    imu_gyroY = smoothGyroY;
+
+// User formula: FORMULA_PATH on LittleFS at boot, or a Serial line
+// "fx <formula>" at any time. A new formula is compiled into the idle one
+// of two programs; the compute stage takes it over at its next frame.
+#define FORMULA_PATH "/hector.fx"
+#define FORMULA_DEFAULT "r = sqrt(x^2 + y^2); 20 * sin(r * 0.25 - k * 2) * cos(atan2(y, x) * 3 + k) / (1 + r * 0.05)"
+
+static FormulaProgram<GRID_MAX_COLS> formulaPrograms[2];
+static std::atomic<int> formulaActive{0};
+static std::atomic<bool> formulaPending{false};  // the idle program holds a newer formula
+static uint32_t formulaLoads = 0;                // formulas taken over so far
+
+static inline FormulaProgram<GRID_MAX_COLS>& activeFormula() {
+  return formulaPrograms[formulaActive.load(std::memory_order_relaxed)];
+}
+
+static inline FormulaInputs formulaInputs(float k) {
+  FormulaInputs in;
+  in.k = k;
+  in.accX = imu_accX;
+  in.accY = imu_accY;
+  in.sound = soundLevel;
+  return in;
+}
+
+float formulawave(float x, float y, float k) {
+  return activeFormula().eval(x, y, formulaInputs(k));
+}
+
+// ---------------------------------------------------------------------------
+// Precomputed surface terms
+// ---------------------------------------------------------------------------
+
+// Everything in a surface function that does not depend on k (radii,
+// angles, distances to the ripple sources, separable row/column factors)
+// is computed once per mode and grid scale. Each mode decides what its
+// vertex/row/column slots hold; per-frame 1-D tables go in the same
+// row/column slots and scalars. Vertex terms are packed row by row like
+// the vertex arena, so any density that fits the arena fits here.
+#define CACHE_VERTEX_TERMS 6
+#define CACHE_LINE_TERMS   5
+#define CACHE_SCALARS      3
+
+struct SurfaceCache {
+  // Key: rebuilt whenever one of these changes
+  WaveStyle style = FLAT_GRID;
+  float size = -1;
+  float step = -1;
+
+  float half = 0;
+  int rows = 0;                 // scan rows (x, from +half down)
+  int cols = 0;                 // scan columns (y, from -half up)
+  float x[GRID_MAX_ROWS];       // x of each row
+  float y[GRID_MAX_COLS];       // y of each column
+  float vertex[CACHE_VERTEX_TERMS][GRID_ARENA_VERTICES]; // [term][row * cols + col]
+  float row[CACHE_LINE_TERMS][GRID_MAX_ROWS];
+  float col[CACHE_LINE_TERMS][GRID_MAX_COLS];
+  float scalar[CACHE_SCALARS];
+
+  float& term(int t, int i, int j) { return vertex[t][i * cols + j]; }
+  // One vertex term for a whole scan row, cols long
+  const float* terms(int t, int i) const { return vertex[t] + i * cols; }
+};
+
+// Heights of scan row `row` into z[0..cols), from the cache alone. Rows
+// are written in single precision throughout (float constants, the rom*
+// functions), with z never aliasing the cache, so the column loops
+// pipeline on the ESP32 and the separable ones vectorize on the host.
+typedef void (*SurfaceRowFn)(const SurfaceCache& c, int row, float k, float* z);
+
+struct SurfaceMode {
+  float (*scalar)(float x, float y, float k);  // reference f(x, y, k)
+  void (*prepare)(SurfaceCache& c);            // k-independent tables
+  void (*frame)(SurfaceCache& c, float k);     // per-frame 1-D tables, optional
+  SurfaceRowFn row;
+  bool (*still)(const SurfaceCache& c);        // no k dependence this frame, optional
+};
+
+static SurfaceCache surfaceCache;
+static PaletteTables<GRID_MAX_ROWS, GRID_MAX_COLS> palette;
+
+static inline float vertexRadius(const SurfaceCache& c, int row, int col, float dx, float dy) {
+  return romsqrt(rompow(c.x[row] + dx) + rompow(c.y[col] + dy));
+}
+
+// sinwave: r and 100 / (2 + r)
+void sinPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r = 0.001f * (rompow(c.x[i]) + rompow(c.y[j]));
+      c.term(0, i, j) = r;
+      c.term(1, i, j) = 100 / (2 + r);
+    }
   }
 }
 
-// NEW: Update sound level from I2S microphone - PROPER IMPLEMENTATION
-void updateSound() {
-  if (millis() - lastSoundRead > 50) { // Update every 50ms
-    lastSoundRead = millis();
-    
-    // Read I2S audio data
-    int16_t i2s_data[I2S_READ_LEN];
-    size_t bytes_read;
-    
-    esp_err_t result = i2s_read(I2S_NUM_0, (char*)i2s_data, I2S_READ_LEN * sizeof(int16_t), &bytes_read, portMAX_DELAY);
-    
-    if (result == ESP_OK && bytes_read > 0) {
-      int samples_read = bytes_read / sizeof(int16_t);
-      
-      // Calculate DC offset
-      int32_t dc_offset = 0;
-      for (int i = 0; i < samples_read; i++) {
-        dc_offset += i2s_data[i];
-      }
-      dc_offset /= samples_read;
-      
-      // Calculate RMS power (proper audio analysis)
-      float power = 0;
-      for (int i = 0; i < samples_read; i++) {
-        int32_t sample = i2s_data[i] - dc_offset;
-        power += (float)(sample * sample);
-      }
-      
-      if (samples_read > 0) {
-        soundPower = sqrt(power / samples_read);
-        
-        // Convert to normalized level (0.0 to 1.0)
-        soundLevel = soundPower / 32768.0; // 16-bit max value
-        
-        // Apply noise gate - ignore very quiet sounds  
-        if (soundLevel < 0.01) {
-          soundLevel = 0;
-        }
-        
-        // Apply heavy smoothing to prevent jitter
-        static float smoothSound = 0;
-        smoothSound = smoothSound * 0.8 + soundLevel * 0.2;
-        soundLevel = smoothSound;
-        
-        // Scale for better visual effect but keep reasonable
-        soundLevel = min(0.8f, soundLevel * 3.0f);
-      }
+void sinRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* r = c.terms(0, i);
+  const float* a = c.terms(1, i);
+  for (int j = 0; j < n; j++) z[j] = a[j] * romcos(r[j] - k);
+}
+
+// dripwave: a / (1 + r) and r / log(r + 2); b only depends on k
+void dripPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r = 1.5f * vertexRadius(c, i, j, 0, 0);
+      c.term(0, i, j) = 200.0f / (1 + r);
+      c.term(1, i, j) = r / romlog(r + 2);
     }
   }
 }
 
-void resetCoords() {
-  for (uint16_t x = 0; x < GRID_SIZE + 1; x++) {
-    for (uint16_t y = 0; y < GRID_SIZE + 1; y++) {
-      HectorGrid[x][y].x = -1;
-      HectorGrid[x][y].y = -1;
-      HectorGrid[x][y].color = 0;
+void dripFrame(SurfaceCache& c, float k) {
+  const float amplitude = 2.5f;
+  c.scalar[0] = (amplitude - fmodf(k / 3, amplitude)) - amplitude / 2;
+}
+
+void dripRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* a = c.terms(0, i);
+  const float* p = c.terms(1, i);
+  const float b = c.scalar[0];
+  for (int j = 0; j < n; j++) z[j] = a[j] * romcos(b * p[j]);
+}
+
+void flatRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  for (int j = 0; j < c.cols; j++) z[j] = 0;
+}
+
+// tiltwave: the tilted plane is separable, the ripple needs r
+void tiltPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      c.term(0, i, j) = vertexRadius(c, i, j, 0, 0) * 0.1f;
     }
   }
 }
 
-void setupScale() {
-  num = GRID_SIZE;
-  doublestep = step * 2;
-  speed = 0.15;
-  tsize = 0.85 * size;
-  halfsize = size * 0.5;
-  zoom = 1.33;
-  resetCoords();
+void tiltFrame(SurfaceCache& c, float k) {
+  float tiltX = imu_accX * 20;
+  float tiltY = imu_accY * 20;
+  for (int i = 0; i < c.rows; i++) c.row[0][i] = c.x[i] * tiltX * 0.5f;
+  for (int j = 0; j < c.cols; j++) c.col[0][j] = c.y[j] * tiltY * 0.5f;
+  c.scalar[0] = (imu_gyroX + imu_gyroY) * 10 * 0.3f;
 }
 
-// projection
-void project(float x, float y, float z, int scan_x, int scan_y) {
-  if (scan_x >= GRID_SIZE + 1 || scan_y >= GRID_SIZE + 1) return;
-  
-  float x1 = x * romcosah - y * romsinah;
-  float y1 = x * romsinah + y * romcosah;
-  float z2 = z * romcosav - x1 * romsinav;
-  if ((tsize - x1) == 0) return;
-  float s = size / (tsize - x1);
-  HectorGrid[scan_x][scan_y].x = screenHalfWidth - (zoom * (y1 * s));
-  HectorGrid[scan_x][scan_y].y = screenHalfHeight - (zoom * (z2 * s));
+void tiltRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* r = c.terms(0, i);
+  const float* plane = c.col[0];
+  const float base = c.row[0][i], ripple = c.scalar[0];
+  for (int j = 0; j < n; j++) z[j] = base + plane[j] + ripple * romcos(k + r[j]);
 }
 
-void drawPath(int scan_y) {
-  if (scan_y == 0) return;
-  
-  for (int pathindex = 1; pathindex < num && pathindex < GRID_SIZE; pathindex++) {
-    if (scan_y >= GRID_SIZE) break;
-    
-    int16_t x0 = HectorGrid[pathindex-1][scan_y].x;
-    int16_t y0 = HectorGrid[pathindex-1][scan_y].y;
-    int16_t x1 = HectorGrid[pathindex][scan_y].x;
-    int16_t y1 = HectorGrid[pathindex][scan_y].y;
-    int16_t x2 = HectorGrid[pathindex][scan_y-1].x;
-    int16_t y2 = HectorGrid[pathindex][scan_y-1].y;
-    
-    uint16_t color = HectorGrid[pathindex][scan_y].color;
-    
-    if (color == 0 || x1 < 0 || y1 < 0) continue;
-    
-    // Draw based on display style with proper coordinate bounds checking
-    switch (displayStyle) {
-      case DISPLAY_GRID:
-        // Draw wireframe lines
-        if (x0 >= 0 && y0 >= 0) {
-          M5.Display.drawLine(constrain(x0, 0, 239), constrain(y0 + 10, 10, 130), 
-                             constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), color);
-        }
-        if (x2 >= 0 && y2 >= 0) {
-          M5.Display.drawLine(constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), 
-                             constrain(x2, 0, 239), constrain(y2 + 10, 10, 130), color);
-        }
-        break;
-        
-      case DISPLAY_SOLID:
-        // Draw filled triangles for solid surface effect
-        if (pathindex > 1 && scan_y > 1) {
-          int16_t x3 = HectorGrid[pathindex-1][scan_y-1].x;
-          int16_t y3 = HectorGrid[pathindex-1][scan_y-1].y;
-          
-          if (x3 >= 0 && y3 >= 0) {
-            // Draw triangulated surface
-            M5.Display.fillTriangle(
-              constrain(x0, 0, 239), constrain(y0 + 10, 10, 130),
-              constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), 
-              constrain(x2, 0, 239), constrain(y2 + 10, 10, 130), color);
-            M5.Display.fillTriangle(
-              constrain(x0, 0, 239), constrain(y0 + 10, 10, 130),
-              constrain(x2, 0, 239), constrain(y2 + 10, 10, 130),
-              constrain(x3, 0, 239), constrain(y3 + 10, 10, 130), color);
-          }
-        } else {
-          // Fallback to thicker lines for edge cases
-          M5.Display.drawLine(constrain(x0, 0, 239), constrain(y0 + 10, 10, 130), 
-                             constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), color);
-        }
-        break;
-        
-      case DISPLAY_ZEBRA:
-        // Draw lines only for alternating patterns (zebra stripes)
-        if (scan_y % 2 == pathindex % 2) {
-          if (x0 >= 0 && y0 >= 0) {
-            M5.Display.drawLine(constrain(x0, 0, 239), constrain(y0 + 10, 10, 130), 
-                               constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), color);
-          }
-          if (x2 >= 0 && y2 >= 0) {
-            M5.Display.drawLine(constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), 
-                               constrain(x2, 0, 239), constrain(y2 + 10, 10, 130), color);
-          }
-        }
-        break;
-        
-      case DISPLAY_CHECKBOARD:
-        // Draw filled rectangles in checkboard pattern
-        if ((pathindex + scan_y) % 2 == 0) {
-          // Draw a visible rectangle instead of just a pixel
-          int rectSize = 4; // Make it clearly visible
-          int centerX = constrain(x1, rectSize/2, 239-rectSize/2);
-          int centerY = constrain(y1 + 10, 10+rectSize/2, 130-rectSize/2);
-          M5.Display.fillRect(centerX - rectSize/2, centerY - rectSize/2, rectSize, rectSize, color);
-          
-          // Also add connecting lines for structure
-          if (x0 >= 0 && y0 >= 0) {
-            M5.Display.drawLine(constrain(x0, 0, 239), constrain(y0 + 10, 10, 130), 
-                               centerX, centerY, color);
-          }
-        }
-        break;
+// soundwave: r and the 1 / (1 + 0.05 r) falloff
+void soundPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r = vertexRadius(c, i, j, 0, 0) * 0.1f;
+      c.term(0, i, j) = r;
+      c.term(1, i, j) = 1 / (1 + r * 0.05f);
     }
   }
 }
 
-void sinLoop() {
-  if (paused) return;
+void soundFrame(SurfaceCache& c, float k) {
+  c.scalar[0] = soundLevel < 0.01f ? 0 : soundLevel * 50;
+  c.scalar[1] = soundLevel > 0.1f ? c.scalar[0] * 0.3f : 0;
+}
 
-  k += speed;
-  
-  // Update sensors for interactive modes
-  updateIMU();
-  updateSound();
+// The silence and harmonic tests are per frame, so each loop is branch-free
+void soundRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* r = c.terms(0, i);
+  const float* falloff = c.terms(1, i);
+  const float a = c.scalar[0], h = c.scalar[1];
+  if (a == 0) {
+    for (int j = 0; j < n; j++) z[j] = 0;
+  } else if (h == 0) {
+    for (int j = 0; j < n; j++) z[j] = a * romcos(-k * 2 + r[j] * 3) * falloff[j];
+  } else {
+    for (int j = 0; j < n; j++) {
+      z[j] = (a * romcos(-k * 2 + r[j] * 3) + h * romcos(-k * 3 + r[j] * 2)) * falloff[j];
+    }
+  }
+}
 
-  setupScale();
+// spiralwave: 3 * theta + 0.2 r and 30 / (1 + 0.1 r)
+void spiralPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r = vertexRadius(c, i, j, 0, 0);
+      float theta = atan2f(c.y[j], c.x[i]);
+      c.term(0, i, j) = theta * 3 + r * 0.2f;
+      c.term(1, i, j) = 30 / (1 + r * 0.1f);
+    }
+  }
+}
 
-  // Use real IMU data instead of simulated gyro for camera angle
-  float ah = imu_accY * 2.0; // Use real tilt for camera
-  float av = imu_accX * 1.5;
+void spiralRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* phase = c.terms(0, i);
+  const float* a = c.terms(1, i);
+  for (int j = 0; j < n; j++) z[j] = romsin(phase[j] - k * 2) * a[j];
+}
 
-  romcosav = romcos(av);
-  romsinav = romsin(av);
-  romcosah = romcos(ah);
-  romsinah = romsin(ah);
+// interferencewave: scaled distance to each of the three sources
+void interferencePrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      c.term(0, i, j) = vertexRadius(c, i, j, 20, 20) * 0.3f;
+      c.term(1, i, j) = vertexRadius(c, i, j, -20, -20) * 0.3f;
+      c.term(2, i, j) = vertexRadius(c, i, j, 0, 30) * 0.25f;
+    }
+  }
+}
 
-  M5.Display.fillScreen(BLACK);
+void interferenceFrame(SurfaceCache& c, float k) {
+  c.scalar[0] = k * 1.2f;
+  c.scalar[1] = k * 0.8f;
+}
+
+void interferenceRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* r1 = c.terms(0, i);
+  const float* r2 = c.terms(1, i);
+  const float* r3 = c.terms(2, i);
+  const float k2 = c.scalar[0], k3 = c.scalar[1];
+  for (int j = 0; j < n; j++) {
+    float wave1 = romsin(r1[j] - k) * 25;
+    float wave2 = romsin(r2[j] - k2) * 25;
+    float wave3 = romsin(r3[j] - k3) * 20;
+    z[j] = (wave1 + wave2 + wave3) * 0.6f;
+  }
+}
+
+// mountainwave: every term is a row factor times a column factor
+void mountainPrepare(SurfaceCache& c) {
+  for (int j = 0; j < c.cols; j++) {
+    c.col[0][j] = romcos(c.y[j] * 0.15f);
+    c.col[1][j] = romsin((c.y[j] + 10) * 0.12f);
+  }
+}
 
-  int scan_y = 0;
+void mountainFrame(SurfaceCache& c, float k) {
+  for (int i = 0; i < c.rows; i++) {
+    float x = c.x[i];
+    c.row[0][i] = 40 * romcos((x + k * 5) * 0.1f);
+    c.row[1][i] = 25 * romsin((x - k * 3) * 0.08f);
+    c.row[2][i] = 10 * romsin(x * 0.3f + k);
+  }
+  for (int j = 0; j < c.cols; j++) c.col[2][j] = romcos(c.y[j] * 0.25f + k * 0.7f);
+}
 
-  for (float x = halfsize; x >= -halfsize; x -= doublestep) {
-    blue = map(x, -halfsize, halfsize, minrangecolor, maxrangecolor);
+void mountainRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float a0 = c.row[0][i], a1 = c.row[1][i], a2 = c.row[2][i];
+  const float* b0 = c.col[0];
+  const float* b1 = c.col[1];
+  const float* b2 = c.col[2];
+  for (int j = 0; j < n; j++) z[j] = a0 * b0[j] + a1 * b1[j] + a2 * b2[j];
+}
 
-    int scan_x = 0;
+// ripplewave: per source, the phase r * w and the amplitude a / (1 + r * d)
+void ripplePrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r1 = vertexRadius(c, i, j, 15, 10);
+      float r2 = vertexRadius(c, i, j, -20, -15);
+      float r3 = vertexRadius(c, i, j, -10, 25);
+      c.term(0, i, j) = r1 * 0.3f;
+      c.term(1, i, j) = r2 * 0.28f;
+      c.term(2, i, j) = r3 * 0.35f;
+      c.term(3, i, j) = 30 / (1 + r1 * 0.1f);
+      c.term(4, i, j) = 25 / (1 + r2 * 0.12f);
+      c.term(5, i, j) = 20 / (1 + r3 * 0.08f);
+    }
+  }
+}
 
-    for (float y = -halfsize; y <= halfsize; y += step) {
-      if (scan_x >= GRID_SIZE || scan_y >= GRID_SIZE) break;
+void rippleFrame(SurfaceCache& c, float k) {
+  c.scalar[0] = k * 2;
+  c.scalar[1] = k * 2.5f;
+  c.scalar[2] = k * 1.8f;
+}
 
-      float z = surfaceFunction(x, y, k);
-      green = map(y, -halfsize, halfsize, minrangecolor, maxrangecolor);
-      float brightnessfactor = float(map(int(z), -50, 50, 100, 20)) / 100.0;
-      red = maxrangecolor - (green - minrangecolor);
-      green *= brightnessfactor;
-      red *= brightnessfactor;
-      blue *= brightnessfactor;
+void rippleRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* p1 = c.terms(0, i);
+  const float* p2 = c.terms(1, i);
+  const float* p3 = c.terms(2, i);
+  const float* a1 = c.terms(3, i);
+  const float* a2 = c.terms(4, i);
+  const float* a3 = c.terms(5, i);
+  const float k1 = c.scalar[0], k2 = c.scalar[1], k3 = c.scalar[2];
+  for (int j = 0; j < n; j++) {
+    z[j] = a1[j] * romcos(p1[j] - k1) + a2[j] * romcos(p2[j] - k2) + a3[j] * romcos(p3[j] - k3);
+  }
+}
 
-      HectorGrid[scan_x][scan_y].color = M5.Display.color565(red, green, blue);
-      project(x, y, z * 1.2, scan_x, scan_y);
-      scan_x++;
+// plasmawave: the diagonal terms are split with the angle-sum identities,
+// sin(a + b) = sin a cos b + cos a sin b, into row and column factors
+void plasmaPrepare(SurfaceCache& c) {
+  for (int j = 0; j < c.cols; j++) {
+    c.col[0][j] = romcos(c.y[j] * 0.15f);
+    c.col[1][j] = romsin(c.y[j] * 0.15f);
+    c.col[2][j] = romcos(c.y[j] * 0.18f);
+    c.col[3][j] = romsin(c.y[j] * 0.18f);
+  }
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      float r = romsqrt(c.x[i] * c.x[i] + c.y[j] * c.y[j]) * 0.1f;
+      c.term(0, i, j) = romsin(r);
+      c.term(1, i, j) = romcos(r);
     }
-    
-    // Draw the path for this scan line
-    drawPath(scan_y);
-    scan_y++;
   }
+}
 
-  // FPS display
-  unsigned long nowmillis = millis();
-  if (nowmillis - fstart >= 1000) {
-    fps = (framecount * 1000) / (nowmillis - fstart);
-    fstart = nowmillis;
-    M5.Display.setCursor(5, 5);
-    M5.Display.setTextColor(WHITE);
-    M5.Display.printf("FPS:%2d", fps);
-    framecount = 0;
-  } else {
-    framecount++;
+void plasmaFrame(SurfaceCache& c, float k) {
+  for (int i = 0; i < c.rows; i++) {
+    float x = c.x[i];
+    c.row[0][i] = romsin(x * 0.2f + k);
+    c.row[1][i] = romsin(x * 0.15f + k * 0.8f);
+    c.row[2][i] = romcos(x * 0.15f + k * 0.8f);
+    c.row[3][i] = romcos(x * 0.18f + k * 1.1f);
+    c.row[4][i] = romsin(x * 0.18f + k * 1.1f);
   }
-  
-  // Show current mode info with sound level for debugging
-  M5.Display.setCursor(180, 5);
-  M5.Display.setTextColor(GREEN);
-  switch(waveStyle) {
-    case FLAT_GRID: M5.Display.printf("FLAT"); break;
-    case TILT_REACTIVE: M5.Display.printf("TILT"); break;
-    case SOUND_REACTIVE: 
-      M5.Display.printf("SND");
-      // Show sound level and power for debugging
-      M5.Display.setCursor(180, 15);
-      M5.Display.setTextColor(soundLevel > 0.05 ? RED : YELLOW);
-      M5.Display.printf("%.2f", soundLevel);
-      M5.Display.setCursor(180, 25);
-      M5.Display.setTextColor(CYAN);
-      M5.Display.printf("%.0f", soundPower / 100);
-      break;
-    case SPIRAL_WAVE: M5.Display.printf("SPRL"); break;
-    case INTERFERENCE: M5.Display.printf("INTRF"); break;
-    case MOUNTAIN_RANGE: M5.Display.printf("MNTN"); break;
-    case RIPPLE_TANK: M5.Display.printf("RIPP"); break;
-    case PLASMA_FIELD: M5.Display.printf("PLSM"); break;
-    case SIN_WAVE: M5.Display.printf("SINE"); break;
-    case DRIP_WAVE: M5.Display.printf("DRIP"); break;
+  for (int j = 0; j < c.cols; j++) c.col[4][j] = romcos(c.y[j] * 0.25f + k * 1.3f);
+  c.scalar[0] = romcos(k * 0.6f);
+  c.scalar[1] = romsin(k * 0.6f);
+}
+
+void plasmaRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float a0 = c.row[0][i], a1 = c.row[1][i], a2 = c.row[2][i];
+  const float a3 = c.row[3][i], a4 = c.row[4][i];
+  const float* b0 = c.col[0];
+  const float* b1 = c.col[1];
+  const float* b2 = c.col[2];
+  const float* b3 = c.col[3];
+  const float* b4 = c.col[4];
+  const float* sinR = c.terms(0, i);
+  const float* cosR = c.terms(1, i);
+  const float cosK = c.scalar[0], sinK = c.scalar[1];
+  for (int j = 0; j < n; j++) {
+    float plasma1 = a0 + b4[j];
+    float plasma2 = a1 * b0[j] + a2 * b1[j] +  // sin(0.15(x+y) + 0.8k)
+                    a3 * b2[j] + a4 * b3[j];   // cos(0.18(x-y) + 1.1k)
+    float plasma3 = sinR[j] * cosK + cosR[j] * sinK;
+    z[j] = (plasma1 + plasma2 + plasma3) * 15;
   }
+}
 
-  // Only auto-change if in auto mode (keeping the existing auto feature)
-  if (autoMode) {
-    int32_t segment = nowmillis % 8000;
-    static int lastsegmentpos = -1;
-    int segmentpos = map(segment, 0, 8000, 0, 16);
-    
-    if (lastsegmentpos != segmentpos) {
-      lastsegmentpos = segmentpos;
-      if (segmentpos % 4 == 0) {
-        switch (displayStyle) {
-          case DISPLAY_SOLID: displayStyle = DISPLAY_GRID; break;
-          case DISPLAY_GRID: displayStyle = DISPLAY_ZEBRA; break;
-          case DISPLAY_ZEBRA: displayStyle = DISPLAY_CHECKBOARD; break;
-          case DISPLAY_CHECKBOARD: displayStyle = DISPLAY_SOLID; break;
-        }
-      }
+// spectrumwave: fractional band index of each vertex's ring
+void spectrumPrepare(SurfaceCache& c) {
+  for (int i = 0; i < c.rows; i++) {
+    for (int j = 0; j < c.cols; j++) {
+      c.term(0, i, j) = vertexRadius(c, i, j, 0, 0) / c.half * (SPECTRUM_BANDS - 1);
     }
   }
 }
 
-void checkButtons() {
-  M5.update();
-  
-  // Button A - Cycle through display styles manually
-  if (M5.BtnA.wasPressed()) {
-    // Cycle through display styles
-    switch (displayStyle) {
-      case DISPLAY_GRID: displayStyle = DISPLAY_SOLID; break;
-      case DISPLAY_SOLID: displayStyle = DISPLAY_ZEBRA; break;
-      case DISPLAY_ZEBRA: displayStyle = DISPLAY_CHECKBOARD; break;
-      case DISPLAY_CHECKBOARD: displayStyle = DISPLAY_GRID; break;
+void spectrumRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const int n = c.cols;
+  const float* ring = c.terms(0, i);
+  const float* level = spectrumLevels.level;
+  for (int j = 0; j < n; j++) {
+    int band = (int)ring[j];
+    if (band >= SPECTRUM_BANDS - 1) {
+      z[j] = level[SPECTRUM_BANDS - 1] * 50;
+    } else {
+      float t = ring[j] - band;
+      z[j] = (level[band] * (1 - t) + level[band + 1] * t) * 50;
     }
-    
-    // Show current style name
-    M5.Display.fillRect(0, 0, 120, 20, BLACK); // Clear status area
-    M5.Display.setCursor(5, 5);
-    M5.Display.setTextColor(WHITE);
-    const char* styleNames[] = {"GRID", "SOLID", "ZEBRA", "CHECK"};
-    M5.Display.printf("Style: %s", styleNames[displayStyle]);
   }
-  
-  // Button B - Cycle through wave types including NEW patterns
-  if (M5.BtnB.wasPressed()) {
-    // Cycle through all wave types including new ones
-    switch (waveStyle) {
-      case FLAT_GRID: 
-        waveStyle = TILT_REACTIVE;
-        surfaceFunction = &tiltwave;
-        break;
-      case TILT_REACTIVE: 
-        waveStyle = SOUND_REACTIVE;
-        surfaceFunction = &soundwave;
-        break;
-      case SOUND_REACTIVE: 
-        waveStyle = SPIRAL_WAVE;
-        surfaceFunction = &spiralwave;
-        break;
-      case SPIRAL_WAVE:
-        waveStyle = INTERFERENCE;
-        surfaceFunction = &interferencewave;
-        break;
-      case INTERFERENCE:
-        waveStyle = MOUNTAIN_RANGE;
-        surfaceFunction = &mountainwave;
-        break;
-      case MOUNTAIN_RANGE:
-        waveStyle = RIPPLE_TANK;
-        surfaceFunction = &ripplewave;
-        break;
-      case RIPPLE_TANK:
-        waveStyle = PLASMA_FIELD;
-        surfaceFunction = &plasmawave;
-        break;
-      case PLASMA_FIELD:
-        waveStyle = SIN_WAVE;
-        size = SIZE;
-        step = STEP * 1.5;
-        setupScale();
-        surfaceFunction = &sinwave;
+}
+
+// formulawave: the grid program fills the vertex terms it hoisted
+void formulaPrepare(SurfaceCache& c) {
+  float* terms[CACHE_VERTEX_TERMS];
+  for (int i = 0; i < c.rows; i++) {
+    for (int t = 0; t < CACHE_VERTEX_TERMS; t++) terms[t] = &c.term(t, i, 0);
+    activeFormula().gridRow(c.x[i], c.y, c.cols, terms);
+  }
+}
+
+void formulaFrame(SurfaceCache& c, float k) {
+  activeFormula().frame(formulaInputs(k));
+}
+
+void formulaRow(const SurfaceCache& c, int i, float k, float* __restrict z) {
+  const float* terms[CACHE_VERTEX_TERMS];
+  for (int t = 0; t < CACHE_VERTEX_TERMS; t++) terms[t] = c.terms(t, i);
+  activeFormula().row(c.x[i], c.y, terms, c.cols, z);
+}
+
+static void noPrepare(SurfaceCache& c) {}
+
+// Still surfaces, after the frame tables are built: the heights then only
+// depend on what SceneKey holds
+static bool flatStill(const SurfaceCache& c) { return true; }
+static bool tiltStill(const SurfaceCache& c) { return fabsf(c.scalar[0]) < STILL_RIPPLE; }
+static bool soundStill(const SurfaceCache& c) { return c.scalar[0] == 0; }
+static bool formulaStill(const SurfaceCache& c) { return !activeFormula().dependsOnTime(); }
+
+// Indexed by WaveStyle
+static const SurfaceMode surfaceModes[] = {
+  { dripwave,         dripPrepare,         dripFrame,         dripRow,         nullptr },    // DRIP_WAVE
+  { sinwave,          sinPrepare,          nullptr,           sinRow,          nullptr },    // SIN_WAVE
+  { flatgrid,         noPrepare,           nullptr,           flatRow,         flatStill },  // FLAT_GRID
+  { tiltwave,         tiltPrepare,         tiltFrame,         tiltRow,         tiltStill },  // TILT_REACTIVE
+  { soundwave,        soundPrepare,        soundFrame,        soundRow,        soundStill }, // SOUND_REACTIVE
+  { spiralwave,       spiralPrepare,       nullptr,           spiralRow,       nullptr },    // SPIRAL_WAVE
+  { interferencewave, interferencePrepare, interferenceFrame, interferenceRow, nullptr },    // INTERFERENCE
+  { mountainwave,     mountainPrepare,     mountainFrame,     mountainRow,     nullptr },    // MOUNTAIN_RANGE
+  { ripplewave,       ripplePrepare,       rippleFrame,       rippleRow,       nullptr },    // RIPPLE_TANK
+  { plasmawave,       plasmaPrepare,       plasmaFrame,       plasmaRow,       nullptr },    // PLASMA_FIELD
+  { spectrumwave,     spectrumPrepare,     nullptr,           spectrumRow,     nullptr },    // SPECTRUM_WAVE
+  { formulawave,      formulaPrepare,      formulaFrame,      formulaRow,      formulaStill }, // FORMULA_WAVE
+};
+
+// Specialized kernels: the strip drawer is instantiated for every display
+// style with the style switch resolved at compile time (the surfaces are
+// already one call per row). Set to 0 for the generic per-vertex switch.
+#ifndef HECTOR_KERNELS
+#define HECTOR_KERNELS 1
+#endif
+
+// Walk the grid exactly like the old float loops did and rebuild the
+// k-independent tables, only if the mode or the scale changed
+void prepareSurfaceCache(SurfaceCache& c, WaveStyle style, float scaleSize, float scaleStep) {
+  if (c.style == style && c.size == scaleSize && c.step == scaleStep) return;
+
+  c.style = style;
+  c.size = scaleSize;
+  c.step = scaleStep;
+  c.half = scaleSize * 0.5f;
+
+  // Columns first: the rows that fit the arena depend on them
+  c.cols = 0;
+  for (float y = -c.half; y <= c.half && c.cols < GRID_MAX_COLS; y += scaleStep) {
+    c.y[c.cols++] = y;
+  }
+  int maxRows = c.cols ? GRID_ARENA_VERTICES / c.cols : 0;
+  if (maxRows > GRID_MAX_ROWS) maxRows = GRID_MAX_ROWS;
+
+  const float rowstep = scaleStep * 2;
+  c.rows = 0;
+  for (float x = c.half; x >= -c.half && c.rows < maxRows; x -= rowstep) {
+    c.x[c.rows++] = x;
+  }
+
+  surfaceModes[style].prepare(c);
+}
+
+// Palette tables follow the grid layout; rebuilt when either changes
+void preparePalette(const SurfaceCache& c, PaletteId id) {
+  static PaletteId builtId = PALETTE_COUNT;
+  static float builtSize = -1, builtStep = -1;
+  if (builtId == id && builtSize == c.size && builtStep == c.step) return;
+
+  builtId = id;
+  builtSize = c.size;
+  builtStep = c.step;
+  palette.build(id, c.x, c.rows, c.y, c.cols, c.half);
+}
+
+// NEW: Initialize I2S for proper microphone reading
+void initI2S() {
+  i2s_config_t i2s_config = {
+    .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_PDM),
+    .sample_rate = I2S_SAMPLE_RATE,
+    .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+    .channel_format = I2S_MIC_CHANNEL,
+    .communication_format = I2S_COMM_FORMAT_I2S,
+    .intr_alloc_flags = ESP_INTR_FLAG_LEVEL1,
+    .dma_buf_count = I2S_DMA_BUF_COUNT,
+    .dma_buf_len = I2S_DMA_BUF_LEN,
+  };
+  
+  i2s_pin_config_t pin_config = {
+    .bck_io_num   = I2S_PIN_NO_CHANGE,
+    .ws_io_num    = I2S_MIC_SERIAL_CLOCK_PIN,
+    .data_out_num = I2S_PIN_NO_CHANGE,
+    .data_in_num  = I2S_MIC_SERIAL_DATA_PIN,
+  };
+  
+  i2s_driver_install(I2S_NUM_0, &i2s_config, 0, NULL);
+  i2s_set_pin(I2S_NUM_0, &pin_config);
+  i2s_set_clk(I2S_NUM_0, I2S_SAMPLE_RATE, I2S_BITS_PER_SAMPLE_16BIT, I2S_CHANNEL_MONO);
+}
+// Sample rate IMU_RATE_HZ, accelerometer and gyro into the FIFO, at the
+// full scales mpu6886Decode() expects
+bool imuFifoBegin() {
+  struct { uint8_t reg, value; } setup[] = {
+    {MPU6886_SMPLRT_DIV, 1000 / IMU_RATE_HZ - 1},
+    {MPU6886_CONFIG, 0x02},        // 92 Hz gyro low-pass, 1 kHz internal rate, FIFO overwrites when full
+    {MPU6886_GYRO_CONFIG, 0x18},   // +-2000 dps
+    {MPU6886_ACCEL_CONFIG, 0x10},  // +-8 g
+    {MPU6886_FIFO_EN, 0x18},       // gyro (with temperature) and accelerometer
+    {MPU6886_USER_CTRL, 0x44},     // enable and reset the FIFO
+  };
+  for (size_t i = 0; i < sizeof(setup) / sizeof(setup[0]); i++) {
+    if (!M5.In_I2C.writeRegister8(MPU6886_ADDR, setup[i].reg, setup[i].value, IMU_I2C_HZ)) return false;
+  }
+  return true;
+}
+
+// The readings waiting in the FIFO, up to max, in one burst
+static int imuFifoRead(ImuReading* out, int max) {
+  uint8_t count[2];
+  if (!M5.In_I2C.readRegister(MPU6886_ADDR, MPU6886_FIFO_COUNTH, count, 2, IMU_I2C_HZ)) return 0;
+  int bytes = (count[0] & 0x1F) << 8 | count[1];
+  if (bytes > MPU6886_FIFO_SIZE - 2 * MPU6886_FIFO_PACKET) {
+    // Overflowed while the task was held up: packets no longer line up
+    M5.In_I2C.writeRegister8(MPU6886_ADDR, MPU6886_USER_CTRL, 0x44, IMU_I2C_HZ);
+    return 0;
+  }
+  int n = bytes / MPU6886_FIFO_PACKET;
+  if (n > max) n = max;
+  uint8_t data[IMU_FIFO_BATCH * MPU6886_FIFO_PACKET];
+  if (n == 0 || !M5.In_I2C.readRegister(MPU6886_ADDR, MPU6886_FIFO_R_W, data, n * MPU6886_FIFO_PACKET, IMU_I2C_HZ)) return 0;
+  for (int i = 0; i < n; i++) out[i] = mpu6886Decode(data + i * MPU6886_FIFO_PACKET);
+  return n;
+}
+
+static ImuReading imuPoll() {
+  ImuReading r;
+  M5.Imu.getAccelData(&r.accX, &r.accY, &r.accZ);
+  M5.Imu.getGyroData(&r.gyroX, &r.gyroY, &r.gyroZ);
+  return r;
+}
+
+// Fuse n readings dt seconds apart and publish the orientation as of nowUs
+static void imuPublish(const ImuReading* r, int n, float dt, uint32_t nowUs) {
+  static float smoothGyroX = 0, smoothGyroY = 0;
+  float gx = 0, gy = 0, gz = 0;
+  for (int i = 0; i < n; i++) {
+    imuFusion.update(r[i], dt);
+    gx += r[i].gyroX;
+    gy += r[i].gyroY;
+    gz += r[i].gyroZ;
+  }
+  const float alpha = n * dt / (IMU_GYRO_SMOOTH_S + n * dt);
+  smoothGyroX += (gx / n - smoothGyroX) * alpha;
+  smoothGyroY += (gy / n - smoothGyroY) * alpha;
+
+  ImuSample sample;
+  sample.accX = r[n - 1].accX;
+  sample.accY = r[n - 1].accY;
+  sample.accZ = r[n - 1].accZ;
+  sample.gyroX = smoothGyroX;
+  sample.gyroY = smoothGyroY;
+  sample.gyroZ = gz / n;
+  sample.orientation.q = imuFusion.orientation();
+  sample.orientation.rateX = imuFusion.rateX;
+  sample.orientation.rateY = imuFusion.rateY;
+  sample.orientation.rateZ = imuFusion.rateZ;
+  sample.orientation.timeUs = nowUs;
+  imuSamples.store(sample);
+}
+
+// IMU task: every IMU_TASK_PERIOD_US, whatever the FIFO collected (or one
+// polled reading without it) through the filter
+void imuTask(void* arg) {
+  ImuReading batch[IMU_FIFO_BATCH];
+  uint32_t last = traceClock();
+  for (;;) {
+    pipelineSleepMicros(IMU_TASK_PERIOD_US);
+    ProfileScope scope(profiler, PROF_IMU);
+    const uint32_t now = traceClock();
+    int n = 1;
+    float dt = (now - last) * 1e-6f;
+    if (imuFifo) {
+      n = imuFifoRead(batch, IMU_FIFO_BATCH);
+      dt = 1.0f / IMU_RATE_HZ;
+    } else {
+      batch[0] = imuPoll();
+    }
+    last = now;
+    if (n > 0) imuPublish(batch, n, dt, now);
+  }
+}
+
+// IMU job: without the task, read (or replay) one sample and fuse it
+void updateIMU() {
+  if (imuTaskRunning) return;
+  ProfileScope scope(profiler, PROF_IMU);
+  ImuReading raw;
+  if (traceMode == TRACE_REPLAY) {
+    tracePump(traceClock());
+    raw.accX = traceImu.accX;
+    raw.accY = traceImu.accY;
+    raw.accZ = traceImu.accZ;
+    raw.gyroX = traceImu.gyroX;
+    raw.gyroY = traceImu.gyroY;
+    raw.gyroZ = traceImu.gyroZ;
+  } else {
+    raw = imuPoll();
+  }
+  if (traceMode == TRACE_RECORD) {
+    TraceImu v = {raw.accX, raw.accY, raw.accZ, raw.gyroX, raw.gyroY, raw.gyroZ};
+    traceWriter.imu(traceClock(), v);
+  }
+
+  static uint32_t last = 0;
+  const uint32_t now = traceClock();
+  const float dt = last ? (now - last) * 1e-6f : IMU_PERIOD_US * 1e-6f;
+  last = now;
+  imuPublish(&raw, 1, dt, now);
+}
+
+// Feed one DMA buffer to the ring and the analyzer, then publish levels
+void analyzeAudioBlock(const int16_t* block, size_t samples) {
+  ProfileScope scope(profiler, PROF_AUDIO);
+  audioRing.push(block, samples);
+  audioAnalyzer.process(block, samples, pipelineMicros());
+  audioLevels.store(audioAnalyzer.levels());
+
+  // The FFT only runs while the spectrum mode is on screen
+  samplesSinceFFT += samples;
+  if (samplesSinceFFT >= SPECTRUM_HOP) {
+    samplesSinceFFT = 0;
+    if (waveStyle == SPECTRUM_WAVE) {
+      audioRing.copyLatest(spectrumWindow, SPECTRUM_FFT_LEN);
+      spectrumBands.store(spectrumAnalyzer.analyze(spectrumWindow));
+    }
+  }
+}
+
+// Capture task: blocks on the I2S driver, never on the render path
+void audioTask(void* arg) {
+  int16_t block[I2S_DMA_BUF_LEN];
+  for (;;) {
+    size_t bytes_read = 0;
+    esp_err_t result = i2s_read(I2S_NUM_0, (char*)block, sizeof(block), &bytes_read, portMAX_DELAY);
+    // A replayed trace stands in for the microphone
+    if (result == ESP_OK && bytes_read > 0 && traceMode != TRACE_REPLAY) {
+      analyzeAudioBlock(block, bytes_read / sizeof(int16_t));
+    }
+  }
+}
+
+// Audio job: without the capture task, drain whatever the DMA buffers
+// already hold without waiting
+void updateSound() {
+  if (audioTaskRunning || traceMode == TRACE_REPLAY) return;
+
+  int16_t block[I2S_DMA_BUF_LEN];
+  size_t bytes_read = 0;
+  while (i2s_read(I2S_NUM_0, (char*)block, sizeof(block), &bytes_read, 0) == ESP_OK && bytes_read > 0) {
+    analyzeAudioBlock(block, bytes_read / sizeof(int16_t));
+  }
+}
+
+// Snapshot the latest IMU sample and sound levels for one frame
+void loadSensors() {
+  ImuSample imu = imuSamples.load();
+  // imu_acc* is the fused gravity, where it will be when the frame is on
+  // the panel: a frame later behind the pipeline
+  const uint32_t lead = pipelineRunning ? scheduler.frames().period() : 0;
+  Quat q = orientationPredict(imu.orientation, traceClock(), lead, IMU_PREDICT_MAX_US);
+  quatGravity(q, imu_accX, imu_accY, imu_accZ);
+  imu_gyroX = imu.gyroX;
+  imu_gyroY = imu.gyroY;
+  imu_gyroZ = imu.gyroZ;
+
+  AudioLevels levels = audioLevels.load();
+  soundLevel = levels.level;
+  soundPower = levels.power;
+  spectrumLevels = spectrumBands.load();
+}
+
+// Start the governor at ACTIVE, the settings setup() leaves in place
+void powerBegin() {
+  PowerConfig config;
+  config.level[POWER_ACTIVE].fps = HECTOR_TARGET_FPS;
+  power.begin(config, millis());
+#if defined(CONFIG_PM_ENABLE) && !HECTOR_INPUT_IRQ
+  // Buttons A and B pull low: either one ends a light sleep. A wake-up
+  // level would replace the edge trigger of the button interrupts, which
+  // instead leave a press in DOZE to the poll at the next frame.
+  gpio_wakeup_enable(GPIO_NUM_37, GPIO_INTR_LOW_LEVEL);
+  gpio_wakeup_enable(GPIO_NUM_39, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+#endif
+}
+
+// Put the settings of the governor's level into effect
+void applyPowerLevel() {
+  const PowerSettings& s = power.settings();
+  scheduler.setFrameRate(s.fps);
+  M5.Display.setBrightness(s.backlight);
+#if defined(CONFIG_PM_ENABLE)
+  // One clock per level, so the profiler's cycle counts keep one unit
+  esp_pm_config_esp32_t pm = {};
+  pm.max_freq_mhz = s.cpuMhz;
+  pm.min_freq_mhz = s.cpuMhz;
+#if CONFIG_FREERTOS_USE_TICKLESS_IDLE
+  pm.light_sleep_enable = s.lightSleep;
+#endif
+  esp_pm_configure(&pm);
+#else
+  setCpuFrequencyMhz(s.cpuMhz);
+#endif
+  profiler.setCyclesPerMicro(getCpuFrequencyMhz());
+#if HECTOR_LOD
+  lodRateChanged = true;  // the next fps spans two rates
+#endif
+}
+
+// Power job: the published sensors and sound level, as the frames see them
+void updatePower() {
+  ImuSample imu = imuSamples.load();
+  PowerInputs in = {imu.accX, imu.accY, imu.accZ, imu.gyroX, imu.gyroY, imu.gyroZ,
+                    audioLevels.load().level, false};
+  if (power.update(millis(), in)) applyPowerLevel();
+}
+
+static size_t traceFileWrite(void* ctx, const uint8_t* data, size_t bytes) {
+  return traceFile.write(data, bytes);
+}
+
+static size_t traceFileRead(void* ctx, uint8_t* data, size_t bytes) {
+  return traceFile.read(data, bytes);
+}
+
+// One base64 line per buffer, between the other Serial reports;
+// tools/trace_tool.py turns a captured log back into a trace file
+static size_t traceSerialWrite(void* ctx, const uint8_t* data, size_t bytes) {
+  static char line[(TRACE_BUFFER_BYTES + 2) / 3 * 4 + 1];
+  traceBase64(data, bytes, line);
+  Serial.printf("TRC,%s\n", line);
+  return bytes;
+}
+
+bool traceStartRecord(TraceWriteFn sink, void* ctx) {
+  const bool pcm = HECTOR_TRACE_PCM && sink != traceSerialWrite;
+  if (!traceWriter.begin(sink, ctx, I2S_SAMPLE_RATE, pcm ? TRACE_FLAG_PCM : 0)) return false;
+  traceLevelsVersion = audioLevels.version();
+  traceBandsVersion = spectrumBands.version();
+  traceSamples = audioRing.written();
+  traceStartUs = pipelineMicros();
+  traceMode = TRACE_RECORD;
+  return true;
+}
+
+bool traceStartReplay(TraceReadFn source, void* ctx) {
+  if (!traceReader.begin(source, ctx)) return false;
+  traceReplayPcm = traceReader.flags() & TRACE_FLAG_PCM;
+  tracePending = traceReader.next(traceRecord);
+  traceStartUs = pipelineMicros();
+  traceMode = TRACE_REPLAY;
+  return true;
+}
+
+// Record to or replay from TRACE_PATH, as chosen with HECTOR_TRACE
+void traceBegin() {
+  if (HECTOR_TRACE == TRACE_OFF) return;
+  bool ok;
+  if (HECTOR_TRACE == TRACE_RECORD && HECTOR_TRACE_SERIAL) {
+    ok = traceStartRecord(traceSerialWrite, nullptr);
+  } else {
+    const bool record = HECTOR_TRACE == TRACE_RECORD;
+    ok = LittleFS.begin(record);  // format an empty partition only to record
+    if (ok) traceFile = LittleFS.open(TRACE_PATH, record ? "w" : "r");
+    ok = ok && traceFile;
+    if (ok) ok = record ? traceStartRecord(traceFileWrite, nullptr) : traceStartReplay(traceFileRead, nullptr);
+  }
+  Serial.printf("[trace] %s %s%s\n", HECTOR_TRACE == TRACE_RECORD ? "recording" : "replaying",
+                HECTOR_TRACE_SERIAL && HECTOR_TRACE == TRACE_RECORD ? "to Serial" : TRACE_PATH,
+                ok ? "" : " failed, sensors stay live");
+}
+
+// Hand every record due by nowUs to the path the live sensor would take
+void tracePump(uint32_t nowUs) {
+  while (tracePending && (int32_t)(nowUs - traceRecord.timeUs) >= 0) {
+    switch (traceRecord.type) {
+      case TRACE_IMU:
+        traceImu = traceRecord.imu();
+        break;
+      case TRACE_LEVELS:
+        if (!traceReplayPcm) {
+          AudioLevels levels;
+          traceRecord.levels(levels.level, levels.power);
+          levels.updatedUs = pipelineMicros();
+          audioLevels.store(levels);
+        }
+        break;
+      case TRACE_BANDS:
+        if (!traceReplayPcm) spectrumBands.store(traceRecord.bands());
+        break;
+      case TRACE_PCM:
+        analyzeAudioBlock(traceRecord.pcm(), traceRecord.pcmSamples());
+        break;
+    }
+    tracePending = traceReader.next(traceRecord);
+    if (!tracePending) Serial.printf("[trace] replay finished\n");
+  }
+}
+
+// Trace job: record what the audio path published since the last run, or
+// replay the records that are due. Records only come from this core.
+void updateTrace() {
+  if (traceMode == TRACE_REPLAY) {
+    tracePump(traceClock());
+    return;
+  }
+  if (traceMode != TRACE_RECORD) return;
+
+  uint32_t now = traceClock();
+  uint32_t version = audioLevels.version();
+  if (version != traceLevelsVersion) {
+    traceLevelsVersion = version;
+    AudioLevels levels = audioLevels.load();
+    traceWriter.levels(now, levels.level, levels.power);
+  }
+  version = spectrumBands.version();
+  if (version != traceBandsVersion) {
+    traceBandsVersion = version;
+    traceWriter.bands(now, spectrumBands.load());
+  }
+
+#if HECTOR_TRACE_PCM
+  if (!HECTOR_TRACE_SERIAL) {
+    uint32_t written = audioRing.written();
+    if (written - traceSamples > AUDIO_RING_LEN) traceSamples = written - AUDIO_RING_LEN;  // overrun
+    int16_t block[I2S_DMA_BUF_LEN];
+    while (traceSamples != written) {
+      size_t n = written - traceSamples < I2S_DMA_BUF_LEN ? written - traceSamples : I2S_DMA_BUF_LEN;
+      audioRing.copyFrom(traceSamples, block, n);
+      traceWriter.pcm(now, block, n);
+      traceSamples += n;
+    }
+  }
+#endif
+
+  // Once a second, so a power-off loses at most the last second
+  static uint8_t runs = 0;
+  if (++runs >= 1000000 / TRACE_PERIOD_US) {
+    runs = 0;
+    traceWriter.flush();
+    if (traceFile) traceFile.flush();
+  }
+  if (!traceWriter.ok()) {
+    Serial.printf("[trace] recording stopped after %lu bytes\n", (unsigned long)traceWriter.bytes());
+    traceMode = TRACE_OFF;
+    if (traceFile) traceFile.close();
+  }
+}
+
+// The built-in formula, then FORMULA_PATH if the partition has one
+void formulaBegin() {
+  formulaPrograms[0].compile(FORMULA_DEFAULT, CACHE_VERTEX_TERMS);
+  if (!LittleFS.begin(false) || !LittleFS.exists(FORMULA_PATH)) return;
+  File f = LittleFS.open(FORMULA_PATH, "r");
+  if (!f) return;
+  char text[FORMULA_MAX_TEXT];
+  size_t n = f.read((uint8_t*)text, sizeof(text) - 1);
+  f.close();
+  text[n] = 0;
+  loadFormula(text, FORMULA_PATH);
+}
+
+// Compile into the idle program and hand it to the compute stage
+bool loadFormula(const char* text, const char* from) {
+  if (formulaPending.load(std::memory_order_acquire)) {
+    Serial.printf("[fx] %s: the last formula is not taken over yet, send again\n", from);
+    return false;
+  }
+  FormulaProgram<GRID_MAX_COLS>& p = formulaPrograms[formulaActive.load(std::memory_order_relaxed) ^ 1];
+  if (!p.compile(text, CACHE_VERTEX_TERMS)) {
+    Serial.printf("[fx] %s: %s at column %d\n", from, p.error(), p.errorAt() + 1);
+    return false;
+  }
+  Serial.printf("[fx] %s: %d grid, %d frame, %d row ops, %d terms hoisted\n", from,
+                p.gridOps(), p.frameOps(), p.rowOps(), p.hoisted());
+  formulaPending.store(true, std::memory_order_release);
+  return true;
+}
+
+// Serial job: a line "fx <formula>" loads the formula and shows it
+void updateSerial() {
+  static char line[FORMULA_MAX_TEXT + 4];
+  static int used = 0;
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (used < (int)sizeof(line) - 1) line[used++] = (char)c;
+      continue;
+    }
+    line[used] = 0;
+    used = 0;
+    if (strncmp(line, "fx ", 3) == 0 && loadFormula(line + 3, "Serial")) {
+      queueCommand(CMD_SET_WAVE, FORMULA_WAVE, 0);
+    }
+  }
+}
+
+// Derive the projection constants from size/step. Called from setup() and
+// from setWave() when a mode changes the scale, not per frame.
+void setupScale() {
+  doublestep = step * 2;
+  speed = 0.15;
+  tsize = 0.85 * size;
+  halfsize = size * 0.5;
+  zoom = 1.33;
+}
+
+// Columns a step produces across the grid, and the step for a column count
+int gridColsForStep(float s) {
+  return (int)(size / s + 0.001f) + 1;
+}
+
+void applyGridCols(int cols) {
+  step = size / (cols - 1);
+  setupScale();
+}
+
+// loop(), once a second: the frame rate measured over that second goes to
+// the compute stage, which owns step and the learned densities
+void lodReport(int measuredFps) {
+#if HECTOR_LOD
+  if (lodRateChanged) {
+    lodRateChanged = false;
+    return;
+  }
+  queueCommand(CMD_LOD_FPS, (uint8_t)(measuredFps < 255 ? measuredFps : 255), 0);
+#else
+  (void)measuredFps;
+#endif
+}
+
+// Compute stage, from CMD_LOD_FPS: move this mode's density toward its target
+void lodUpdate(int measuredFps) {
+#if HECTOR_LOD
+  if (lodSettling) {
+    lodSettling = false;
+    return;
+  }
+  int cols = gridColsForStep(step);
+  int next = lod.update(cols, measuredFps, lodTargetFps[waveStyle]);
+  lodCols[waveStyle] = next;
+  if (next != cols) applyGridCols(next);
+#endif
+}
+
+// After a mode switch: restore the density learned for the new mode
+void lodSelectMode() {
+#if HECTOR_LOD
+  if (lodCols[waveStyle]) applyGridCols(lodCols[waveStyle]);
+  lodSettling = true;
+#endif
+}
+
+// Allocate the render target: front + back buffers in PSRAM when present,
+// otherwise a single DMA-capable buffer in internal RAM
+void initFramebuffer() {
+#if HECTOR_FRAMEBUFFER
+  const size_t bytes = (size_t)screenWidth * screenHeight * sizeof(uint16_t);
+  uint16_t* a = nullptr;
+  uint16_t* b = nullptr;
+
+#ifdef BOARD_HAS_PSRAM
+  if (psramFound()) {
+    a = (uint16_t*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    b = (uint16_t*)heap_caps_malloc(bytes, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    if (!a || !b) {
+      heap_caps_free(a);
+      heap_caps_free(b);
+      a = b = nullptr;
+    }
+  }
+#endif
+  if (!a) {
+    a = (uint16_t*)heap_caps_malloc(bytes, MALLOC_CAP_DMA | MALLOC_CAP_8BIT);
+  }
+  if (!a) {
+    Serial.println("Framebuffer allocation failed, drawing direct");
+    return;
+  }
+
+  frameBuffers[0].pixels = a;
+  frameBuffers[1].pixels = b ? b : a;
+  for (int i = 0; i < 2; i++) {
+    frameBuffers[i].width = screenWidth;
+    frameBuffers[i].height = screenHeight;
+  }
+  doubleBuffered = (b != nullptr);
+  useFramebuffer = true;
+  backBuffer = 0;
+  frameCanvas.setBuffer(frameBuffers[backBuffer].pixels, screenWidth, screenHeight, lgfx::rgb565_2Byte);
+  gfx = &frameCanvas;
+
+  panelTiles.begin(screenWidth, screenHeight);
+
+  // Keep the bus transaction open so pushImageDMA() returns immediately
+  M5.Display.startWrite();
+  Serial.printf("Framebuffer: %s, %u bytes each\n", doubleBuffered ? "double (PSRAM)" : "single", (unsigned)bytes);
+#endif
+}
+
+void beginFrame() {
+  if (!useFramebuffer) {
+    gfx->fillScreen(BLACK);
+    return;
+  }
+  // With a single buffer the previous push must finish before we overwrite
+  // it; with two, the buffer we are about to draw was pushed a frame ago
+  if (!doubleBuffered) {
+    uint32_t waitStart = profilerCycles();
+    M5.Display.waitDMA();
+    profiler.accumulate(PROF_FLUSH, profilerCycles() - waitStart);
+  }
+  fbClear(frameBuffers[backBuffer], BLACK);
+}
+
+// Push the tiles that differ from the panel: full-width bands in one DMA
+// transfer, narrower runs through a window written line by line.
+// Returns the bytes sent.
+static uint32_t pushChangedTiles(const FrameBuffer& fb) {
+  if (!panelTiles.diff(fb)) return 0;
+  const int n = panelTiles.runs(pushRuns);
+  uint32_t pixels = 0;
+  for (int i = 0; i < n; i++) {
+    const TileRect& r = pushRuns[i];
+    const uint16_t* p = fb.pixels + r.y * fb.width + r.x;
+    if (r.w == fb.width) {
+      M5.Display.pushImageDMA(r.x, r.y, r.w, r.h, (const lgfx::swap565_t*)p);
+    } else {
+      M5.Display.setAddrWindow(r.x, r.y, r.w, r.h);
+      for (int y = 0; y < r.h; y++) {
+        M5.Display.writePixelsDMA((const lgfx::swap565_t*)(p + y * fb.width), r.w);
+      }
+    }
+    pixels += (uint32_t)r.w * r.h;
+  }
+  return pixels * sizeof(uint16_t);
+}
+
+void presentFrame() {
+  if (!useFramebuffer) return;
+  uint32_t start = profilerCycles();
+  FrameBuffer& fb = frameBuffers[backBuffer];
+#if HECTOR_DIRTY_TILES
+  pushedBytes = pushChangedTiles(fb);
+#else
+  M5.Display.pushImageDMA(0, 0, fb.width, fb.height, (const lgfx::swap565_t*)fb.pixels);
+  pushedBytes = fbBytes(fb);
+#endif
+  if (doubleBuffered) {
+    backBuffer ^= 1;
+    frameCanvas.setBuffer(frameBuffers[backBuffer].pixels, fb.width, fb.height, lgfx::rgb565_2Byte);
+  }
+  profiler.accumulate(PROF_FLUSH, profilerCycles() - start);
+  profiler.commit(PROF_FLUSH);
+  profiler.recordMicros(PROF_PUSH, pushedBytes);
+}
+
+// Primitive wrappers used by drawPath(), routed to the active render target
+static inline void targetLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  if (useFramebuffer) fbDrawLine(frameBuffers[backBuffer], x0, y0, x1, y1, color);
+  else gfx->drawLine(x0, y0, x1, y1, color);
+}
+
+static inline void targetTriangle(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                                  int16_t x2, int16_t y2, uint16_t color) {
+  if (useFramebuffer) fbFillTriangle(frameBuffers[backBuffer], x0, y0, x1, y1, x2, y2, color);
+  else gfx->fillTriangle(x0, y0, x1, y1, x2, y2, color);
+}
+
+static inline void targetRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  if (useFramebuffer) fbFillRect(frameBuffers[backBuffer], x, y, w, h, color);
+  else gfx->fillRect(x, y, w, h, color);
+}
+
+// Clip target for the surface: the rows the clamped primitives used to
+// cover, with the surface drawn 10 pixels down
+static FbClip surfaceViewport;
+static FbCoverage solidCoverage;
+static FbPen columnPens[GRID_MAX_COLS];  // grid columns, continued row by row
+
+// What drawLineStrip() put out, for the native bench; cleared by it
+struct LineStats {
+  uint32_t segments = 0;      // segments left after clipping
+  uint32_t pixels = 0;        // framebuffer pixels written
+  uint32_t transactions = 0;  // startWrite()/endWrite() pairs on the panel
+};
+static LineStats lineStats;
+
+// Start rasterizing a frame. Solid coverage is only used when the scan
+// rows run nearest first: with the camera yawed past 45 degrees a row no
+// longer hides the rows after it, so the quads are painted in plain order.
+void beginRaster(bool frontToBack) {
+  surfaceViewport.left = 0;
+  surfaceViewport.top = 10;
+  surfaceViewport.right = 239;
+  surfaceViewport.bottom = 130;
+  for (int i = 0; i < GRID_MAX_COLS; i++) columnPens[i].down = false;
+  if (!useFramebuffer) return;
+  const FrameBuffer& fb = frameBuffers[backBuffer];
+  solidCoverage.reset(fb.width, fb.height, frontToBack);
+}
+
+// One polyline segment on the active render target, clipped to the
+// viewport; returns which of its endpoints are on screen
+static inline uint8_t targetPolyline(FbPen& pen, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                                     uint16_t color, bool skipLast = false) {
+  if (useFramebuffer) {
+    const uint32_t written = pen.written;
+    uint8_t kept = fbPolylineTo(frameBuffers[backBuffer], surfaceViewport, pen, x0, y0, x1, y1, color, skipLast);
+    lineStats.segments += pen.down;
+    lineStats.pixels += pen.written - written;
+    return kept;
+  }
+  int32_t cx0 = x0, cy0 = y0, cx1 = x1, cy1 = y1;
+  if (!fbClipLine(surfaceViewport, cx0, cy0, cx1, cy1)) return 0;
+  gfx->drawLine(cx0, cy0, cx1, cy1, color);
+  lineStats.segments++;
+  return (cx0 == x0 && cy0 == y0 ? FB_SEG_START : 0) | (cx1 == x1 && cy1 == y1 ? FB_SEG_END : 0);
+}
+
+// A vertex the line modes draw: projected and not off the top/left edge
+static inline bool onScreen(const GridRow& row, int i) {
+  return row.isValid(i) && row.x[i] >= 0 && row.y[i] >= 0;
+}
+
+// Fill the strip between two scan rows into the framebuffer. Every quad
+// whose corners were projected is drawn and clipped to the viewport, so
+// quads crossing the edge keep their shape instead of being clamped.
+void drawSolidStrip(const GridRow& prev, const GridRow& row) {
+  FrameBuffer& fb = frameBuffers[backBuffer];
+
+  for (int i = 1; i < row.cols; i++) {
+    if (!row.isValid(i) || !row.isValid(i - 1) || !prev.isValid(i) || !prev.isValid(i - 1)) continue;
+
+    uint16_t color = row.color[i];
+    if (color == 0) continue;
+
+    fbFillQuadClipped(fb, surfaceViewport, &solidCoverage,
+                      row.x[i - 1], row.y[i - 1] + 10, row.x[i], row.y[i] + 10,
+                      prev.x[i], prev.y[i] + 10, prev.x[i - 1], prev.y[i - 1] + 10, color);
+  }
+}
+
+// Grid and zebra lines between two scan rows. Vertex by vertex, as the
+// per-vertex lines were drawn, the row polyline is extended to the
+// vertex and then the column's polyline down to it, leaving out the
+// vertex pixel the row just drew in the same color. Each segment is
+// clipped once; straight to the panel the strip is a single write
+// transaction.
+void drawLineStrip(const GridRow& prev, const GridRow& row, int scan_y, bool zebra) {
+  FbPen rowPen;
+
+  if (!useFramebuffer) {
+    gfx->startWrite();
+    lineStats.transactions++;
+  }
+
+  for (int i = 1; i < row.cols; i++) {
+    if (zebra && scan_y % 2 != i % 2) continue;
+    if (!row.isValid(i) || row.color[i] == 0) {
+      columnPens[i].down = false;
+      continue;
+    }
+
+    bool joint = false;  // row vertex already on screen
+    if (row.isValid(i - 1)) {
+      joint = targetPolyline(rowPen, row.x[i - 1], row.y[i - 1] + 10, row.x[i], row.y[i] + 10,
+                             row.color[i]) & FB_SEG_END;
+    }
+    if (!prev.isValid(i)) {
+      columnPens[i].down = false;
+      continue;
+    }
+    targetPolyline(columnPens[i], prev.x[i], prev.y[i] + 10, row.x[i], row.y[i] + 10, row.color[i], joint);
+  }
+
+  if (!useFramebuffer) gfx->endWrite();
+}
+
+// Direct-to-panel solid fill left of vertex i: two clamped triangles, or
+// a line on the first row and column (the framebuffer uses drawSolidStrip())
+static inline void drawSolidVertex(const GridRow& prev, const GridRow& row, int i, int scan_y,
+                                   uint16_t color) {
+  int16_t x0 = row.x[i - 1];
+  int16_t y0 = row.y[i - 1];
+  int16_t x1 = row.x[i];
+  int16_t y1 = row.y[i];
+
+  if (i > 1 && scan_y > 1) {
+    if (!onScreen(prev, i - 1)) return;
+    int16_t x2 = prev.x[i];
+    int16_t y2 = prev.y[i];
+    int16_t x3 = prev.x[i - 1];
+    int16_t y3 = prev.y[i - 1];
+
+    // Draw triangulated surface
+    targetTriangle(
+      constrain(x0, 0, 239), constrain(y0 + 10, 10, 130),
+      constrain(x1, 0, 239), constrain(y1 + 10, 10, 130),
+      constrain(x2, 0, 239), constrain(y2 + 10, 10, 130), color);
+    targetTriangle(
+      constrain(x0, 0, 239), constrain(y0 + 10, 10, 130),
+      constrain(x2, 0, 239), constrain(y2 + 10, 10, 130),
+      constrain(x3, 0, 239), constrain(y3 + 10, 10, 130), color);
+  } else {
+    // Fallback to thicker lines for edge cases
+    targetLine(constrain(x0, 0, 239), constrain(y0 + 10, 10, 130),
+               constrain(x1, 0, 239), constrain(y1 + 10, 10, 130), color);
+  }
+}
+
+// Checkboard cell at vertex i: a 4 px square, joined to its left neighbour
+static inline void drawCheckerVertex(const GridRow& row, int i, uint16_t color) {
+  int rectSize = 4; // Make it clearly visible
+  int centerX = constrain(row.x[i], rectSize/2, 239-rectSize/2);
+  int centerY = constrain(row.y[i] + 10, 10+rectSize/2, 130-rectSize/2);
+  targetRect(centerX - rectSize/2, centerY - rectSize/2, rectSize, rectSize, color);
+
+  // Also add connecting lines for structure
+  if (onScreen(row, i - 1)) {
+    targetLine(constrain(row.x[i - 1], 0, 239), constrain(row.y[i - 1] + 10, 10, 130),
+               centerX, centerY, color);
+  }
+}
+
+// Draw scan row scan_y (> 0) against the row computed before it. The
+// generic drawer: the display style is switched on for every vertex.
+void drawPath(const GridRow& prev, const GridRow& row, int scan_y) {
+  if (scan_y == 0) return;
+  if (!row.anyValid()) return;
+
+  switch (frameStyle) {
+    case DISPLAY_GRID:
+      drawLineStrip(prev, row, scan_y, false);
+      return;
+    case DISPLAY_ZEBRA:
+      drawLineStrip(prev, row, scan_y, true);
+      return;
+    case DISPLAY_SOLID:
+      if (!useFramebuffer) break;
+      drawSolidStrip(prev, row);
+      return;
+    default:
+      break;
+  }
+  
+  for (int pathindex = 1; pathindex < row.cols; pathindex++) {
+    if (!onScreen(row, pathindex)) continue;
+
+    uint16_t color = row.color[pathindex];
+    
+    if (color == 0) continue;
+    
+    switch (frameStyle) {
+      case DISPLAY_SOLID:
+        drawSolidVertex(prev, row, pathindex, scan_y, color);
         break;
-      case SIN_WAVE: 
-        waveStyle = DRIP_WAVE;
-        setupScale();
-        surfaceFunction = &dripwave;
+        
+      case DISPLAY_CHECKBOARD:
+        // Draw filled rectangles in checkboard pattern
+        if ((pathindex + scan_y) % 2 == 0) drawCheckerVertex(row, pathindex, color);
         break;
-      case DRIP_WAVE: 
-        waveStyle = FLAT_GRID;
-        surfaceFunction = &flatgrid;
+
+      default:
         break;
     }
-    oldWaveStyle = waveStyle;
+  }
+}
+
+typedef void (*DrawStripFn)(const GridRow& prev, const GridRow& row, int scan_y);
+
+#if HECTOR_KERNELS
+// drawPath() for one display style. The checkboard only visits the cells
+// of this row's parity: every other vertex, starting at 1 or 2.
+template <DisplayStyle STYLE>
+void drawStrip(const GridRow& prev, const GridRow& row, int scan_y) {
+  if (scan_y == 0) return;
+  if (!row.anyValid()) return;
+
+  if (STYLE == DISPLAY_GRID || STYLE == DISPLAY_ZEBRA) {
+    drawLineStrip(prev, row, scan_y, STYLE == DISPLAY_ZEBRA);
+    return;
+  }
+  if (STYLE == DISPLAY_SOLID && useFramebuffer) {
+    drawSolidStrip(prev, row);
+    return;
+  }
+
+  const int first = STYLE == DISPLAY_CHECKBOARD ? 2 - (scan_y & 1) : 1;
+  const int stride = STYLE == DISPLAY_CHECKBOARD ? 2 : 1;
+  for (int i = first; i < row.cols; i += stride) {
+    if (!onScreen(row, i) || row.color[i] == 0) continue;
+    if (STYLE == DISPLAY_SOLID) drawSolidVertex(prev, row, i, scan_y, row.color[i]);
+    else drawCheckerVertex(row, i, row.color[i]);
+  }
+}
+
+// Indexed by DisplayStyle
+static const DrawStripFn drawStrips[] = {
+  drawStrip<DISPLAY_GRID>, drawStrip<DISPLAY_SOLID>,
+  drawStrip<DISPLAY_ZEBRA>, drawStrip<DISPLAY_CHECKBOARD>,
+};
+#endif
+
+// Strip drawer for the current display style, chosen once per frame
+static inline DrawStripFn selectDrawStrip() {
+#if HECTOR_KERNELS
+  return drawStrips[frameStyle];
+#else
+  return drawPath;
+#endif
+}
+
+// Per-frame snapshot shared by the pipelined and the streaming paths
+struct ComputeState {
+  float (*surface)(float x, float y, float k);
+  const SurfaceMode* mode;
+  bool cached;       // surface is the mode's own: its row function and tables apply
+  bool frontToBack;  // scan rows run nearest first
+  SceneKey scene;
+  FrameStatus status;
+};
+
+// Start a frame: advance time, take the latest sensor data, apply the
+// queued commands and snapshot the mode they leave
+ComputeState beginCompute() {
+  // speed per step of simulated time, interpolated between steps so a
+  // faster frame rate is smoother rather than faster
+  simK += speed * simClock.advance(pipelineMicros());
+  k = simK + speed * simClock.alpha();
+
+  loadSensors();
+
+  // A formula loaded since the last frame: switch programs, rebuild its terms
+  if (formulaPending.load(std::memory_order_acquire)) {
+    formulaActive.store(formulaActive.load(std::memory_order_relaxed) ^ 1, std::memory_order_relaxed);
+    formulaPending.store(false, std::memory_order_release);
+    formulaLoads++;
+    surfaceCache.size = -1;
+  }
+
+  ComputeState state;
+  applyCommands(state.status);
+
+  // Scale constants are only rebuilt by setupScale() when size/step change
+  state.surface = surfaceFunction;
+  const WaveStyle style = waveStyle;
+
+  // Precomputed terms are only used when they belong to the active surface
+  state.mode = &surfaceModes[style];
+  prepareSurfaceCache(surfaceCache, style, size, step);
+  state.cached = (state.mode->scalar == state.surface);
+  if (state.cached && state.mode->frame) state.mode->frame(surfaceCache, k);
+
+  state.scene.still = HECTOR_STILL_SKIP && state.cached && state.mode->still &&
+                      state.mode->still(surfaceCache);
+  state.scene.style = style;
+  state.scene.palette = paletteId;
+  state.scene.size = size;
+  state.scene.step = step;
+  state.scene.accX = imu_accX;
+  state.scene.accY = imu_accY;
+  state.scene.formula = formulaLoads;
+  if (style == SOUND_REACTIVE) {
+    state.status.soundLevel = soundLevel;
+    state.status.soundPower = soundPower;
+  }
+  preparePalette(surfaceCache, paletteId);
+
+  // Use real IMU data instead of simulated gyro for camera angle
+  float ah = imu_accY * 2.0; // Use real tilt for camera
+  float av = imu_accX * 1.5;
+
+  romcosav = romcos(av);
+  romsinav = romsin(av);
+  romcosah = romcos(ah);
+  romsinah = romsin(ah);
+
+  // Rows step away from the camera along x; within 45 degrees of yaw the
+  // row order is also a valid front-to-back order for the height field
+  state.frontToBack = romcosah > fabsf(romsinah);
+
+  ProjectionSetup view;
+  view.cosAh = romcosah;
+  view.sinAh = romsinah;
+  view.cosAv = romcosav;
+  view.sinAv = romsinav;
+  view.size = size;
+  view.tsize = tsize;
+  view.zoom = zoom;
+  view.halfWidth = screenHalfWidth;
+  view.halfHeight = screenHalfHeight;
+  projection.begin(view, surfaceCache.y, surfaceCache.cols);
+
+  return state;
+}
+
+// Evaluate, color and project one scan row
+void computeRow(const ComputeState& state, int scan_y, const GridRow& row) {
+  const SurfaceCache& cache = surfaceCache;
+
+  row.clearValid();
+
+  float x = cache.x[scan_y];
+
+  // Heights for the whole row first, then one batched shade and projection
+  float z[GRID_MAX_COLS];
+  float heights[GRID_MAX_COLS];
+
+  uint32_t t0 = profilerCycles();
+  if (state.cached) {
+    state.mode->row(cache, scan_y, k, z);
+  } else {
+    for (int scan_x = 0; scan_x < cache.cols; scan_x++) z[scan_x] = state.surface(x, cache.y[scan_x], k);
+  }
+  for (int scan_x = 0; scan_x < cache.cols; scan_x++) heights[scan_x] = z[scan_x] * 1.2f;
+  uint32_t t1 = profilerCycles();
+  palette.shadeRow(scan_y, z, row.color, cache.cols);
+  uint32_t t2 = profilerCycles();
+  projection.row(x, heights, row);
+
+  profiler.accumulate(PROF_SURFACE, t1 - t0);
+  profiler.accumulate(PROF_SHADE, t2 - t1);
+  profiler.accumulate(PROF_PROJECT, profilerCycles() - t2);
+}
+
+// One sample per frame for the stages computeRow() adds up
+void commitComputeProfile() {
+  profiler.commit(PROF_SURFACE);
+  profiler.commit(PROF_SHADE);
+  profiler.commit(PROF_PROJECT);
+}
+
+// Compute stage: sensors, surface evaluation and projection into frame
+void computeFrame(HectorFrame& frame) {
+  ComputeState state = beginCompute();
+  frame.status = state.status;
+
+  // A still scene this slot already holds: its rows are still valid
+  if (sceneMatches(state.scene, frame.scene)) {
+    frame.number = ++computedFrames;
+    return;
+  }
+  frame.scene = state.scene;
+
+  frame.grid.layout(surfaceCache.rows, surfaceCache.cols);
+  for (int scan_y = 0; scan_y < frame.grid.rows(); scan_y++) {
+    computeRow(state, scan_y, frame.grid.row(scan_y));
+  }
+
+  frame.frontToBack = state.frontToBack;
+  frame.number = ++computedFrames;
+  commitComputeProfile();
+}
+
+// Jobs run, deadlines missed and worst lateness over the last second,
+// plus the frames that started a whole slot late
+void reportSchedulerStats() {
+  Serial.printf("[sched] target %lu fps, late frames %lu", (unsigned long)(1000000 / scheduler.frames().period()),
+                (unsigned long)scheduler.frames().takeOverruns());
+  for (int i = 0; i < scheduler.count(); i++) {
+    uint32_t runs, misses, lateUs;
+    PeriodicJob& job = scheduler.job(i);
+    job.takeStats(runs, misses, lateUs);
+    Serial.printf(", %s %lu/%lu miss, late %lu us", job.name, (unsigned long)misses,
+                  (unsigned long)runs, (unsigned long)lateUs);
+  }
+  Serial.printf("\n");
+}
+
+// Telemetry, one CSV record a second: time, fps, modes and grid, then
+// count,min,avg,p99,max in microseconds for every stage in the order of
+// the #PROF header printed by setup(). tools/profile_decode.py reads it.
+void reportProfile(unsigned long nowMs) {
+  profiler.take(profileSummary);
+  Serial.printf("PROF,%lu,%d,%d,%d,%d,%d", nowMs, fps, (int)waveStyle, (int)displayStyle,
+                surfaceCache.cols, surfaceCache.rows);
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    const ProfileSummary& p = profileSummary[i];
+    Serial.printf(",%lu,%lu,%lu,%lu,%lu", (unsigned long)p.count, (unsigned long)p.minUs,
+                  (unsigned long)p.avgUs, (unsigned long)p.p99Us, (unsigned long)p.maxUs);
+  }
+  Serial.printf("\n");
+}
+
+// Estimated draw over the last second: the profiled stages ahead of
+// PROF_PUSH are CPU work, summed over both cores, at the clock and
+// backlight of the power level. Skipped frames count as frames.
+void reportPower() {
+  uint64_t busyUs = 0;
+  for (int i = 0; i < PROF_PUSH; i++) busyUs += (uint64_t)profileSummary[i].count * profileSummary[i].avgUs;
+  const PowerSettings& s = power.settings();
+  float busy = busyUs / 1e6f;
+  float mw = powerEstimateMw(s.cpuMhz, busy, s.backlight);
+  Serial.printf("[power] %s, %d fps, %d MHz, backlight %d, busy %.2f cores, ~%.0f mW, ~%.1f mJ/frame, still %lu s\n",
+                powerLevelNames[power.level()], fps, s.cpuMhz, s.backlight, busy, mw, fps ? mw / fps : 0.0f,
+                (unsigned long)(power.idleMs(millis()) / 1000));
+}
+
+void printProfileHeader() {
+  Serial.printf("#PROF,ms,fps,wave,display,cols,rows");
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) Serial.printf(",%s", profileStageNames[i]);
+  Serial.printf("\n");
+}
+
+// Print per-stage timings once a second; render + compute exceeding the
+// frame time shows how much the two cores overlap
+void reportPipelineStats() {
+  uint32_t computeAvg, computeMax, renderAvg, renderMax;
+  uint32_t computeWaitAvg, computeWaitMax, renderWaitAvg, renderWaitMax;
+  uint32_t frameAvg, frameMax;
+  pipelineStats.compute.take(computeAvg, computeMax);
+  pipelineStats.render.take(renderAvg, renderMax);
+  pipelineStats.computeWait.take(computeWaitAvg, computeWaitMax);
+  pipelineStats.renderWait.take(renderWaitAvg, renderWaitMax);
+  pipelineStats.frame.take(frameAvg, frameMax);
+  Serial.printf("[%s] grid %dx%d, compute %lu/%lu us, render %lu/%lu us, wait c%lu r%lu us, frame %lu us, still %lu\n",
+                pipelineRunning ? "pipe" : "serial", surfaceCache.cols, surfaceCache.rows,
+                (unsigned long)computeAvg, (unsigned long)computeMax,
+                (unsigned long)renderAvg, (unsigned long)renderMax,
+                (unsigned long)computeWaitAvg, (unsigned long)renderWaitAvg,
+                (unsigned long)frameAvg, (unsigned long)skippedFrames);
+  skippedFrames = 0;
+  reportSchedulerStats();
+}
+
+// Everything the status text and overlay show besides the mode, from the
+// frame's snapshot rather than the live state the compute side is already
+// changing, so a skipped frame never leaves stale text on the panel
+static uint32_t statusStamp(const FrameStatus& status) {
+  uint32_t stamp = fstart;  // FPS and the overlay change once a second
+  stamp = stamp * 31 + status.display;
+  stamp = stamp * 31 + status.overlay;
+  stamp = stamp * 31 + status.banner;
+  stamp = stamp * 31 + (uint32_t)lroundf(status.soundLevel * 100);
+  stamp = stamp * 31 + (uint32_t)lroundf(status.soundPower / 100);
+  return stamp;
+}
+
+// Nothing on the panel would change: a still scene within STILL_ACC of
+// the one shown, and the same status text
+static bool frameUnchanged(const SceneKey& scene, const FrameStatus& status) {
+  return sceneMatches(scene, shownScene) && statusStamp(status) == shownStatus;
+}
+
+// Render stage: rasterize a computed frame, draw status text and push
+void renderFrame(const HectorFrame& frame) {
+  frameStyle = (DisplayStyle)frame.status.display;
+  beginFrame();
+  beginRaster(frame.frontToBack);
+
+  const DrawStripFn draw = selectDrawStrip();
+  uint32_t drawStart = profilerCycles();
+  for (int scan_y = 1; scan_y < frame.grid.rows(); scan_y++) {
+    // Draw the path for this scan line
+    draw(frame.grid.row(scan_y - 1), frame.grid.row(scan_y), scan_y);
+  }
+  profiler.record(PROF_DRAW, profilerCycles() - drawStart);
+
+  finishFrame(frame.scene, frame.status);
+}
+
+// Single core: compute each row and draw it straight away, keeping only
+// the current and previous rows in rowWindow
+void streamFrame() {
+  uint32_t start = pipelineMicros();
+  uint32_t computeUs = 0;
+
+  ComputeState state = beginCompute();
+  if (frameUnchanged(state.scene, state.status)) {
+    skipFrame(state.status);
+    pipelineStats.compute.add(pipelineMicros() - start);
+    return;
+  }
+  frameStyle = (DisplayStyle)state.status.display;
+  beginFrame();
+  const DrawStripFn draw = selectDrawStrip();
+  rowWindow.begin(surfaceCache.cols);
+  beginRaster(state.frontToBack);
+  computeUs += pipelineMicros() - start;
+
+  for (int scan_y = 0; scan_y < surfaceCache.rows; scan_y++) {
+    uint32_t rowStart = pipelineMicros();
+    GridRow row = rowWindow.next(scan_y);
+    computeRow(state, scan_y, row);
+    computeUs += pipelineMicros() - rowStart;
+
+    uint32_t drawStart = profilerCycles();
+    draw(rowWindow.previous(scan_y), rowWindow.current(scan_y), scan_y);
+    profiler.accumulate(PROF_DRAW, profilerCycles() - drawStart);
+  }
+  ++computedFrames;
+  commitComputeProfile();
+  profiler.commit(PROF_DRAW);
+
+  finishFrame(state.scene, state.status);
+
+  uint32_t total = pipelineMicros() - start;
+  pipelineStats.compute.add(computeUs);
+  pipelineStats.render.add(total - computeUs);
+}
+
+// Per frame, drawn or skipped: FPS, the reports once a second, auto mode
+void frameTick() {
+  // FPS display
+  unsigned long nowmillis = millis();
+  if (nowmillis - fstart >= 1000) {
+    fps = (framecount * 1000) / (nowmillis - fstart);
+    fstart = nowmillis;
+    framecount = 0;
+    reportPipelineStats();
+    reportProfile(nowmillis);
+#if HECTOR_POWER
+    reportPower();
+#endif
+    // A lowered rate is the governor's doing, not a sign of too much detail
+    if (power.level() == POWER_ACTIVE) lodReport(fps);
+  } else {
+    framecount++;
+  }
+
+  // Only auto-change if in auto mode (keeping the existing auto feature)
+  if (autoMode) {
+    int32_t segment = nowmillis % 8000;
+    static int lastsegmentpos = -1;
+    int segmentpos = map(segment, 0, 8000, 0, 16);
     
-    // Show current wave type with shorter names for screen space
-    M5.Display.fillRect(120, 0, 120, 20, BLACK);
-    M5.Display.setCursor(125, 5);
-    M5.Display.setTextColor(GREEN);
-    switch(waveStyle) {
-      case FLAT_GRID: M5.Display.printf("FLAT"); break;
-      case TILT_REACTIVE: M5.Display.printf("TILT"); break;
-      case SOUND_REACTIVE: M5.Display.printf("SOUND"); break;
-      case SPIRAL_WAVE: M5.Display.printf("SPIRAL"); break;
-      case INTERFERENCE: M5.Display.printf("INTER"); break;
-      case MOUNTAIN_RANGE: M5.Display.printf("MOUNT"); break;
-      case RIPPLE_TANK: M5.Display.printf("RIPPLE"); break;
-      case PLASMA_FIELD: M5.Display.printf("PLASMA"); break;
-      case SIN_WAVE: M5.Display.printf("SINE"); break;
-      case DRIP_WAVE: M5.Display.printf("DRIP"); break;
+    if (lastsegmentpos != segmentpos) {
+      lastsegmentpos = segmentpos;
+      if (segmentpos % 4 == 0) queueCommand(CMD_AUTO_STYLE, 0, 0);
+    }
+  }
+}
+
+// A frame that applied a button's command is on the panel
+static void recordInputLatency(const FrameStatus& status) {
+  if (status.inputUs) profiler.recordMicros(PROF_INPUT, pipelineMicros() - status.inputUs);
+}
+
+// The panel keeps the last frame: nothing is drawn or pushed
+void skipFrame(const FrameStatus& status) {
+  frameTick();
+  skippedFrames++;
+  profiler.recordMicros(PROF_PUSH, 0);
+  recordInputLatency(status);
+}
+
+#if HECTOR_HUD
+// Glyphs of the panel font, read back once from a small canvas
+static void hudLoadFont() {
+  M5Canvas glyph(&M5.Display);
+  glyph.setColorDepth(16);
+  if (!glyph.createSprite(HUD_GLYPH_W, HUD_GLYPH_H)) {
+    Serial.println("HUD glyph canvas allocation failed, status text is blank");
+    return;
+  }
+  glyph.setTextSize(1);
+  glyph.setTextColor(WHITE);
+  for (int c = 0; c < HUD_CHAR_COUNT; c++) {
+    glyph.fillSprite(BLACK);
+    glyph.setCursor(0, 0);
+    glyph.print((char)(HUD_FIRST_CHAR + c));
+    for (int y = 0; y < HUD_GLYPH_H; y++) {
+      uint8_t bits = 0;
+      for (int x = 0; x < HUD_GLYPH_W; x++) {
+        if (glyph.readPixel(x, y)) bits |= 0x80 >> x;
+      }
+      hud.font.rows[c][y] = bits;
+    }
+  }
+  glyph.deleteSprite();
+}
+
+// Every fixed label as a strip, from the glyph cache
+void hudRenderLabels() {
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    hudModeLabels[w].render(hud.font, waveLabelNames[w]);
+    hudWaveLabels[w].render(hud.font, waveStyleNames[w]);
+  }
+  for (int d = 0; d < DISPLAY_STYLE_COUNT; d++) hudStyleLabels[d].render(hud.font, displayStyleNames[d]);
+  for (int p = 0; p < PALETTE_COUNT; p++) hudPaletteLabels[p].render(hud.font, paletteSpecs[p].name);
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    char name[8];
+    snprintf(name, sizeof(name), "%-5s", profileStageNames[i]);
+    hudStageLabels[i].render(hud.font, name);
+  }
+  hudFpsLabel.render(hud.font, "FPS:");
+  hudStyleLabel.render(hud.font, "Style: ");
+  hudPaletteLabel.render(hud.font, "Palette: ");
+  hudAutoLabel.render(hud.font, "Auto: ");
+  hudOnLabel.render(hud.font, "ON");
+  hudOffLabel.render(hud.font, "OFF");
+  hud.invalidate();
+}
+
+void hudBegin() {
+  hudLoadFont();
+  hudRenderLabels();
+  hud.line(HUD_FPS).place(5, 5);
+  hud.line(HUD_BANNER).place(5, 5);
+  hud.line(HUD_MODE).place(180, 5);
+  hud.line(HUD_WAVE_BANNER).place(125, 5);
+  hud.line(HUD_LEVEL).place(180, 15);
+  hud.line(HUD_POWER).place(180, 25);
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) hud.line(HUD_PROFILE + i).place(2, 18 + 8 * i);
+}
+
+// Status text: a line is recomposed only when what it shows changes,
+// and every shown line is drawn over the frame as an opaque box
+static void drawStatus(const SceneKey& scene, const FrameStatus& status) {
+  ProfileScope scope(profiler, PROF_HUD);
+
+  // FPS, or what the last command changed in its place
+  const bool banner = status.banner != BANNER_NONE && status.banner != BANNER_WAVE;
+  const int left = banner ? HUD_BANNER : HUD_FPS;
+  hud.line(banner ? HUD_FPS : HUD_BANNER).hide();
+  HudLine& l = hud.line(left);
+  l.begin();
+  switch (status.banner) {
+    case BANNER_STYLE: l.label(hudStyleLabel); l.label(hudStyleLabels[status.display]); break;
+    case BANNER_PALETTE: l.label(hudPaletteLabel); l.label(hudPaletteLabels[scene.palette]); break;
+    case BANNER_AUTO: l.label(hudAutoLabel); l.label(status.autoMode ? hudOnLabel : hudOffLabel); break;
+    default: l.label(hudFpsLabel); l.number(fps, 2); break;
+  }
+  hud.end(left, WHITE);
+
+  // The mode, or its full name after button B
+  const bool waveBanner = status.banner == BANNER_WAVE;
+  const int right = waveBanner ? HUD_WAVE_BANNER : HUD_MODE;
+  hud.line(waveBanner ? HUD_MODE : HUD_WAVE_BANNER).hide();
+  hud.line(right).begin();
+  hud.line(right).label(waveBanner ? hudWaveLabels[scene.style] : hudModeLabels[scene.style]);
+  hud.end(right, GREEN);
+
+  // Sound level and power for debugging, as the frame's snapshot had them
+  if (scene.style == SOUND_REACTIVE) {
+    hud.line(HUD_LEVEL).begin();
+    hud.line(HUD_LEVEL).number(lroundf(status.soundLevel * 100), 1, 2);
+    hud.end(HUD_LEVEL, status.soundLevel > 0.05 ? RED : YELLOW);
+    hud.line(HUD_POWER).begin();
+    hud.line(HUD_POWER).number(lroundf(status.soundPower / 100), 1);
+    hud.end(HUD_POWER, CYAN);
+  } else {
+    hud.line(HUD_LEVEL).hide();
+    hud.line(HUD_POWER).hide();
+  }
+
+  // Average and p99 per stage over the last second, in microseconds
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    HudLine& p = hud.line(HUD_PROFILE + i);
+    if (!status.overlay) {
+      p.hide();
+      continue;
+    }
+    p.begin();
+    p.label(hudStageLabels[i]);
+    p.number((int32_t)profileSummary[i].avgUs, 5);
+    p.number((int32_t)profileSummary[i].p99Us, 6);
+    hud.end(HUD_PROFILE + i, CYAN);
+  }
+
+  if (useFramebuffer) {
+    hud.draw(frameBuffers[backBuffer], BLACK);
+    return;
+  }
+  for (int i = 0; i < HUD_LINE_COUNT; i++) {
+    const HudLine& line = hud.line(i);
+    if (line.visible()) gfx->drawBitmap(line.x, line.y, line.mask(), line.width(), HUD_GLYPH_H, line.color, BLACK);
+  }
+}
+#else
+void hudBegin() {}
+
+// Average and p99 per stage over the last second, in microseconds
+void drawProfileOverlay() {
+  gfx->fillRect(0, 16, 100, 8 * PROF_STAGE_COUNT + 4, BLACK);
+  gfx->setTextColor(CYAN);
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    gfx->setCursor(2, 18 + 8 * i);
+    gfx->printf("%-5s%5lu%6lu", profileStageNames[i], (unsigned long)profileSummary[i].avgUs,
+                (unsigned long)profileSummary[i].p99Us);
+  }
+}
+
+// What the last command changed, over the status text
+static void drawBanner(const SceneKey& scene, const FrameStatus& status) {
+  if (status.banner == BANNER_NONE) return;
+  if (status.banner == BANNER_WAVE) {
+    gfx->fillRect(120, 0, 120, 20, BLACK);
+    gfx->setCursor(125, 5);
+    gfx->setTextColor(GREEN);
+    gfx->printf("%s", waveStyleNames[scene.style]);
+    return;
+  }
+  gfx->fillRect(0, 0, 120, 20, BLACK);
+  gfx->setCursor(5, 5);
+  gfx->setTextColor(WHITE);
+  switch (status.banner) {
+    case BANNER_STYLE: gfx->printf("Style: %s", displayStyleNames[status.display]); break;
+    case BANNER_PALETTE: gfx->printf("Palette: %s", paletteSpecs[scene.palette].name); break;
+    case BANNER_AUTO: gfx->printf("Auto: %s", status.autoMode ? "ON" : "OFF"); break;
+  }
+}
+
+// Status text printed every frame, with the font drawn glyph by glyph
+static void drawStatus(const SceneKey& scene, const FrameStatus& status) {
+  ProfileScope scope(profiler, PROF_HUD);
+  gfx->setCursor(5, 5);
+  gfx->setTextColor(WHITE);
+  gfx->printf("FPS:%2d", fps);
+  if (status.overlay) drawProfileOverlay();
+  
+  // Show the frame's mode, with its sound level for debugging
+  gfx->setCursor(180, 5);
+  gfx->setTextColor(GREEN);
+  gfx->printf("%s", waveLabelNames[scene.style]);
+  if (scene.style == SOUND_REACTIVE) {
+    gfx->setCursor(180, 15);
+    gfx->setTextColor(status.soundLevel > 0.05 ? RED : YELLOW);
+    gfx->printf("%.2f", status.soundLevel);
+    gfx->setCursor(180, 25);
+    gfx->setTextColor(CYAN);
+    gfx->printf("%.0f", status.soundPower / 100);
+  }
+  drawBanner(scene, status);
+}
+#endif
+
+// Status text and the push to the panel
+void finishFrame(const SceneKey& scene, const FrameStatus& status) {
+  frameTick();
+  drawStatus(scene, status);
+  presentFrame();
+  shownScene = scene;
+  shownStatus = statusStamp(status);
+  recordInputLatency(status);
+}
+
+#if HECTOR_PIPELINE
+// Compute task pinned to core 0: fills the next frame while core 1 renders
+void computeTask(void* arg) {
+  for (;;) {
+    uint32_t waitStart = pipelineMicros();
+    HectorFrame* frame = nullptr;
+    while (paused || !(frame = frameExchange.acquireWrite())) {
+      pipelineYield();
     }
+    uint32_t start = pipelineMicros();
+    pipelineStats.computeWait.add(start - waitStart);
+
+    computeFrame(*frame);
+    pipelineStats.compute.add(pipelineMicros() - start);
+    frameExchange.publish(frame);
   }
 }
+#endif
+
+void sinLoop() {
+  // Buttons pressed since the last job run reach this frame's commands
+  checkButtons();
+  if (paused) return;
+
+  // Without the pipeline both stages run interleaved row by row on this core
+  if (!pipelineRunning) {
+    uint32_t start = pipelineMicros();
+    if (lastRenderStart) {
+      pipelineStats.frame.add(start - lastRenderStart);
+      profiler.recordMicros(PROF_FRAME, start - lastRenderStart);
+    }
+    lastRenderStart = start;
+    streamFrame();
+    return;
+  }
+
+#if HECTOR_PIPELINE
+  uint32_t waitStart = pipelineMicros();
+  HectorFrame* frame;
+  while (!(frame = frameExchange.acquireRead())) {
+    pipelineYield();
+  }
+  uint32_t start = pipelineMicros();
+  pipelineStats.renderWait.add(start - waitStart);
+  if (lastRenderStart) {
+    pipelineStats.frame.add(start - lastRenderStart);
+    profiler.recordMicros(PROF_FRAME, start - lastRenderStart);
+  }
+  lastRenderStart = start;
+
+  if (frameUnchanged(frame->scene, frame->status)) skipFrame(frame->status);
+  else renderFrame(*frame);
+  frameExchange.release(frame);
+  pipelineStats.render.add(pipelineMicros() - start);
+#endif
+}
+
+#if HECTOR_INPUT_IRQ
+static uint8_t inputPins[INPUT_BUTTON_COUNT] = {INPUT_PIN_A, INPUT_PIN_B, INPUT_PIN_PWR};
+
+// Any edge of a button: its level and the time, nothing else. GPIO 39
+// may interrupt spuriously on the ESP32; the level read settles it.
+static void IRAM_ATTR inputIsr(void* arg) {
+  const uint8_t b = (uint8_t)(uintptr_t)arg;
+  InputEdge e = {b, digitalRead(inputPins[b]) == LOW, (uint32_t)micros()};
+  inputEdges.push(e);
+}
+#endif
+
+void inputBegin() {
+  gestures.begin(InputConfig(), pipelineMicros());
+#if HECTOR_INPUT_IRQ
+  for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+    pinMode(inputPins[b], INPUT);
+    attachInterruptArg(inputPins[b], inputIsr, (void*)(uintptr_t)b, CHANGE);
+  }
+#endif
+}
+
+// The buttons held down now (active low)
+static void readButtonLevels(bool* down) {
+#if HECTOR_INPUT_IRQ
+  for (int b = 0; b < INPUT_BUTTON_COUNT; b++) down[b] = digitalRead(inputPins[b]) == LOW;
+#else
+  M5.update();
+  down[INPUT_BUTTON_A] = M5.BtnA.isPressed();
+  down[INPUT_BUTTON_B] = M5.BtnB.isPressed();
+  down[INPUT_BUTTON_PWR] = M5.BtnPWR.isPressed();
+#endif
+}
+
+// From loop() only, so the queue has a single producer
+void queueCommand(uint8_t code, uint8_t arg, uint32_t timeUs) {
+  HectorCommand c = {code, arg, timeUs};
+  commandQueue.push(c);
+}
+
+// Button job, and the start of every frame: the edges since the last run
+// through the gesture detector, the gestures into commands
+void checkButtons() {
+  ProfileScope scope(profiler, PROF_BUTTONS);
+  InputEdge edge;
+  while (inputEdges.pop(edge)) gestures.edge(edge);
+
+  // A level the interrupts missed, or every change without them
+  const uint32_t now = pipelineMicros();
+  bool down[INPUT_BUTTON_COUNT];
+  readButtonLevels(down);
+  bool held = false;
+  for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+    if (down[b] != gestures.rawPressed(b)) {
+      InputEdge e = {(uint8_t)b, down[b], now};
+      gestures.edge(e);
+    }
+    held |= down[b];
+  }
+  gestures.tick(now);
+
+  InputEvent ev;
+  bool any = held;
+  while (gestures.next(ev)) {
+    any = true;
+    switch (ev.button) {
+      case INPUT_BUTTON_A:
+        // Button A - Cycle through display styles manually
+        if (ev.gesture == GESTURE_PRESS) queueCommand(CMD_NEXT_STYLE, 0, ev.timeUs);
+        break;
+      case INPUT_BUTTON_B:
+        // Button B - Cycle through wave types
+        if (ev.gesture == GESTURE_PRESS) queueCommand(CMD_NEXT_WAVE, 0, ev.timeUs);
+        break;
+      case INPUT_BUTTON_PWR:
+        // Power button - palettes, the profiler overlay, auto mode
+        if (ev.gesture == GESTURE_CLICK) queueCommand(CMD_NEXT_PALETTE, 0, ev.timeUs);
+        if (ev.gesture == GESTURE_DOUBLE_CLICK) queueCommand(CMD_PROFILER, 0, ev.timeUs);
+        if (ev.gesture == GESTURE_LONG_PRESS) queueCommand(CMD_AUTO_MODE, 0, ev.timeUs);
+        break;
+    }
+  }
+
+#if HECTOR_POWER
+  // Any button wakes the governor; its usual action still runs
+  if (any && power.wake(millis())) applyPowerLevel();
+#else
+  (void)any;
+#endif
+}
+
+// Make w the current mode. SINE sets its own step and DRIP rebuilds the
+// scale, as the button cycle always did; LOD then takes the density it
+// learned for w.
+void setWave(WaveStyle w) {
+  waveStyle = w;
+  surfaceFunction = surfaceModes[w].scalar;
+  if (w == SIN_WAVE) {
+    size = SIZE;
+    step = STEP * 1.5;
+  }
+  if (w == SIN_WAVE || w == DRIP_WAVE) setupScale();
+  oldWaveStyle = waveStyle;
+  lodSelectMode();
+}
+
+// Compute stage, before a frame takes its snapshot: every queued command,
+// so a frame sees all of a change or none of it
+void applyCommands(FrameStatus& status) {
+  HectorCommand c;
+  status.inputUs = 0;
+  while (commandQueue.pop(c)) {
+    switch (c.code) {
+      case CMD_NEXT_STYLE:
+        displayStyle = nextDisplayStyle[displayStyle];
+        bannerKind = BANNER_STYLE;
+        break;
+      case CMD_AUTO_STYLE:
+        displayStyle = autoDisplayStyle[displayStyle];
+        break;
+      case CMD_NEXT_WAVE:
+        setWave(nextWaveStyle[waveStyle]);
+        bannerKind = BANNER_WAVE;
+        break;
+      case CMD_SET_WAVE:
+        setWave((WaveStyle)c.arg);
+        break;
+      case CMD_NEXT_PALETTE:
+        paletteId = (PaletteId)((paletteId + 1) % PALETTE_COUNT);
+        bannerKind = BANNER_PALETTE;
+        break;
+      case CMD_PROFILER:
+        profileOverlay = !profileOverlay;
+        break;
+      case CMD_AUTO_MODE:
+        autoMode = !autoMode;
+        bannerKind = BANNER_AUTO;
+        break;
+      case CMD_LOD_FPS:
+        lodUpdate(c.arg);
+        break;
+    }
+    if (c.timeUs) {
+      if (!status.inputUs) status.inputUs = c.timeUs;
+      bannerUntilMs = millis() + BANNER_MS;
+    }
+  }
+
+  status.display = displayStyle;
+  status.overlay = profileOverlay;
+  status.autoMode = autoMode;
+  status.banner = (int32_t)(millis() - bannerUntilMs) < 0 ? bannerKind : BANNER_NONE;
+}
 
 void setup() {
   M5.begin();
+
+  // Build the sin/log lookup tables before any surface is evaluated
+  romMathInit();
   
   // Initialize IMU
   M5.Imu.init();
   
   // Initialize I2S microphone - NEW
   initI2S();
+  audioAnalyzer.begin(I2S_SAMPLE_RATE, I2S_DMA_BUF_LEN);
+  spectrumAnalyzer.begin(I2S_SAMPLE_RATE, 1000.0f * SPECTRUM_HOP / I2S_SAMPLE_RATE);
+  // Above the compute task so DMA buffers are drained as soon as they fill
+  audioTaskRunning = pipelineStartTask(audioTask, nullptr, "hector_audio", 0, 4096, 2);
   
   // Set up display - CHANGED TO LANDSCAPE MODE
   M5.Display.setRotation(1); // Landscape mode (was 0 for portrait)
@@ -688,6 +2791,7 @@ void setup() {
 
   surfaceFunction = &sinwave;
   setupScale();
+  lod.begin(LOD_MIN_COLS, GRID_MAX_COLS);
 
   fstart = millis() - 1;
 
@@ -696,13 +2800,45 @@ void setup() {
   M5.Display.printf("A:Style B:Mode");
 
   Serial.begin(115200);
-  Serial.println("Hector M5StickC Plus2 initialized");
+  profiler.begin(PROF_STAGE_COUNT);
+  printProfileHeader();
+  initFramebuffer();
+  hudBegin();
+
+  SchedulerClock clock;
+  clock.now = pipelineMicros;
+  clock.sleep = pipelineSleepMicros;
+  scheduler.begin(clock, HECTOR_TARGET_FPS);
+  inputBegin();
+  scheduler.addJob("btn", checkButtons, BUTTON_PERIOD_US);
+  scheduler.addJob("imu", updateIMU, IMU_PERIOD_US);
+  scheduler.addJob("audio", updateSound, AUDIO_PERIOD_US);
+  scheduler.addJob("trace", updateTrace, TRACE_PERIOD_US);
+#if HECTOR_POWER
+  powerBegin();
+  scheduler.addJob("power", updatePower, POWER_PERIOD_US);
+#endif
+  traceBegin();
+  formulaBegin();
+  scheduler.addJob("serial", updateSerial, SERIAL_PERIOD_US);
+  imuFusion.begin(FusionConfig());
+#if HECTOR_IMU_TASK
+  // Next to the audio task, above the compute stage; traces stay on the job
+  if (traceMode == TRACE_OFF) {
+    imuFifo = imuFifoBegin();
+    imuTaskRunning = pipelineStartTask(imuTask, nullptr, "hector_imu", 0, 4096, 2);
+  }
+#endif
+  simClock.begin(1000000 / HECTOR_SIM_HZ);
+
+#if HECTOR_PIPELINE
+  // loop() runs on core 1, so the compute stage gets core 0
+  pipelineRunning = pipelineStartTask(computeTask, nullptr, "hector_compute", 0, 8192, 1);
+#endif
+  Serial.printf("Hector M5StickC Plus2 initialized (%s)\n", pipelineRunning ? "dual-core pipeline" : "single core");
 }
 
 void loop() {
-  checkButtons();
-  sinLoop();
-  
-  // Small delay to prevent overwhelming the system
-  delay(30);
+  // Jobs run between frames; the scheduler sleeps until the next is due
+  if (scheduler.waitForFrame()) sinLoop();
 }
\ No newline at end of file
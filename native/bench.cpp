@@ -0,0 +1,2607 @@
+/*
+  Native benchmark and headless renderer for Hector
+
+  Builds main.cpp against the stub HAL in native/hal and runs every
+  WaveStyle x DisplayStyle combination for a number of frames through the
+  same computeFrame()/renderFrame() stages the device runs, one after the
+  other on this core. Reports frames/s, vertices/s and the split between
+  compute and render; --images writes the last frame of each combination
+  into DIR, creating it first; it exits 1 if DIR or an image cannot be
+  written.
+
+  Time is pinned per frame (k advances by speed every frame, the IMU
+  tilts along a fixed path, the microphone plays a generated signal), so
+  two runs render the same pixels and only the timings differ.
+  --record saves the sensors of the first combination as a trace, and
+  --replay feeds a trace (from here or from a device) to every
+  combination instead, on the same frame clock.
+
+  --surfaces times each mode's row function against its scalar reference
+  f(x, y, k) over the whole grid, on the same frames, and reports the
+  largest height difference between the two. A frame takes a few
+  microseconds, so each path's time is its best frame, with the order of
+  the two alternating; a row function slower than its reference fails.
+
+  --formula compiles interferencewave and ripplewave written as formulas
+  and times the formula programs against those modes' scalar and row
+  functions, with the largest height difference from the scalar one. It
+  then compiles malformed and deeply nested formulas and fails unless each
+  gives its expected error and column.
+
+  --power runs no frames: it plays a scripted stretch of use (in hand, on
+  a desk, a button, talking) through the power governor on a simulated
+  clock, checks that it wakes at once and steps down on time, and
+  compares its estimated draw with running flat out.
+
+  --fusion runs no frames either: it replays synthetic motion (turns,
+  holds, a shake, a wobble, with gyro bias and noise) through the IMU
+  fusion filter as the IMU task would, and checks the gravity the frames
+  see against the true one, next to the old smoothed accelerometer.
+
+  --input plays scripted button edges (contact bounce, a lost edge, two
+  buttons at once) through the gesture detector on a 60 fps poll and
+  checks the gestures and their times, then presses the stub GPIOs and
+  checks that each command shows in the next frame.
+
+  --hud fills the glyph cache with a pattern per character (the host has
+  no font) and runs the status text through a scripted stretch of frames:
+  sound readouts changing every frame, banners, the profiler overlay.
+  The live mode and sound values are set to ones the frame's scene and
+  status do not hold, so only the frame's may show. It checks every
+  shown line pixel by pixel against the same text printed glyph by glyph,
+  and times it against recomposing every line on every frame, which is
+  what printing it did.
+
+  --exchange runs a producer and a consumer thread through FrameExchange
+  and a SeqLock writer and reader, and checks the frame numbers arrive in
+  order with none dropped and no frame or value torn.
+
+  --fill draws SOLID strips nearest first with the coverage mask and
+  compares them with the same triangles painted in exactly the reverse
+  order without it, over every mode, three densities and 20 camera
+  angles: no holes, few pixels different, and the pixel writes and fill
+  rate of both.
+
+  --lines draws GRID and ZEBRA for every mode through drawLineStrip() and
+  through every segment clipped and drawn whole in the same order, and
+  checks the pixels match: skipping shared joints must not change any.
+  It counts segments and pixels written for both, and the panel write
+  transactions against one per line.
+
+  --shading colors every mode's rows at four densities through the
+  palette tables and checks each color against the per-vertex math:
+  CLASSIC against the map()/color565() code the renderer used before the
+  tables, the other palettes against their functions called per vertex.
+  It times the old per-vertex code against the tables.
+
+  --density runs RIPPLE (or --wave) at grids of 30, 60 and 120 steps both
+  ways the rows can be kept: the whole frame, as handed to the other
+  core, and the two-row window of the single core path. It times each
+  and checks they draw the same pixels, with the bytes each keeps.
+
+  --projection projects every mode's rows with both projection policies
+  while sweeping the camera over the whole tilt range, and checks that the
+  fixed-point one puts every on-screen vertex within a pixel of the float
+  one; it times both on the same rows.
+
+  --audio feeds native/fixtures/rms_tones.wav, stretches of known RMS,
+  through the audio analyzer in DMA buffers and checks power, peak, DC
+  offset and the gated level against them; run it from the repository
+  root.
+
+  --fft checks the spectrum bands at several FFT sizes and sample rates
+  (every band non-empty, contiguous up to Nyquist), that a tone in each
+  band lights it the most, and times the 512 and 1024 point transforms.
+
+  --raster draws spans, lines and triangles (clipped, degenerate, past
+  the edges) into a small frame and checks each against a golden frame
+  and the words around the frame against being written.
+
+  --rommath sweeps each rom_math.h function over the range the surfaces
+  use and checks its largest error against libm double with the bound
+  the header states, then times it against the libm float and double
+  calls on the same inputs. A function slower than the libm float call
+  fails; for sqrt and division, one instruction on the host's FPU but
+  software on the ESP32's, up to 4x that call is allowed.
+
+  --scheduler drives scheduler.h from a mock clock: fixed steps from
+  irregular frame gaps, a stall, the 32-bit wrap; jobs polled on time,
+  late and starved by a long stall; and the Scheduler pacing frames and
+  jobs while frames are cheap and while they overrun.
+
+    pio run -e native
+    .pio/build/native/program --frames 300 --images out/
+    .pio/build/native/program --surfaces
+    .pio/build/native/program --formula
+    .pio/build/native/program --power
+    .pio/build/native/program --fusion
+    .pio/build/native/program --input
+    .pio/build/native/program --hud
+    .pio/build/native/program --exchange
+    .pio/build/native/program --density
+    .pio/build/native/program --projection
+    .pio/build/native/program --fill
+    .pio/build/native/program --lines
+    .pio/build/native/program --shading
+    .pio/build/native/program --audio
+    .pio/build/native/program --fft
+    .pio/build/native/program --raster
+    .pio/build/native/program --rommath
+    .pio/build/native/program --scheduler
+*/
+
+#include "main.cpp"
+#include "headless.h"
+
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+static const char* const benchWaveNames[WAVE_STYLE_COUNT] = {
+  "DRIP", "SINE", "FLAT", "TILT", "SOUND", "SPIRAL", "INTER", "MOUNT", "RIPPLE", "PLASMA", "SPECTRUM", "FORMULA"
+};
+static const char* const benchDisplayNames[] = { "GRID", "SOLID", "ZEBRA", "CHECK" };
+#define BENCH_DISPLAY_COUNT 4
+#define BENCH_WARMUP_FRAMES 10
+
+struct BenchOptions {
+  int frames = 300;
+  int wave = -1;     // all
+  int display = -1;  // all
+  int cols = 0;      // mode default
+  const char* images = nullptr;
+  const char* record = nullptr;
+  const char* replay = nullptr;
+  bool ppm = false;
+  bool csv = false;
+  bool surfaces = false;
+  bool formula = false;
+  bool power = false;
+  bool fusion = false;
+  bool input = false;
+  bool hud = false;
+  bool exchange = false;
+  bool audio = false;
+  bool fft = false;
+  bool density = false;
+  bool projection = false;
+  bool fill = false;
+  bool lines = false;
+  bool shading = false;
+  bool scheduler = false;
+  bool raster = false;
+  bool rommath = false;
+};
+
+struct BenchResult {
+  int cols = 0, rows = 0;
+  double seconds = 0;
+  double computeUs = 0;  // per frame
+  double renderUs = 0;
+  double pushBytes = 0;  // per frame, changed tiles only
+  long vertices = 0;
+};
+
+static HectorFrame benchFrame;
+static int benchFrameNumber = 0;
+static FILE* benchTrace = nullptr;
+
+// Trace time follows the frame number, 30 frames per second
+static uint32_t benchTraceClock() { return (uint32_t)benchFrameNumber * (1000000 / 30); }
+
+static size_t benchTraceWrite(void* ctx, const uint8_t* data, size_t bytes) {
+  return fwrite(data, 1, bytes, (FILE*)ctx);
+}
+
+static size_t benchTraceRead(void* ctx, uint8_t* data, size_t bytes) {
+  return fread(data, 1, bytes, (FILE*)ctx);
+}
+
+static void benchTraceOpen(const char* path, bool record) {
+  benchTrace = fopen(path, record ? "wb" : "rb");
+  bool ok = benchTrace && (record ? traceStartRecord(benchTraceWrite, benchTrace)
+                                  : traceStartReplay(benchTraceRead, benchTrace));
+  if (!ok) {
+    fprintf(stderr, "cannot %s trace %s\n", record ? "record" : "replay", path);
+    exit(1);
+  }
+}
+
+static void benchTraceClose() {
+  if (traceMode == TRACE_RECORD) traceWriter.flush();
+  traceMode = TRACE_OFF;
+  fclose(benchTrace);
+  benchTrace = nullptr;
+}
+
+static double benchNow() {
+  using namespace std::chrono;
+  return duration_cast<duration<double>>(steady_clock::now().time_since_epoch()).count();
+}
+
+static int benchFind(const char* const* names, int count, const char* name) {
+  for (int i = 0; i < count; i++) {
+    if (strcasecmp(names[i], name) == 0) return i;
+  }
+  fprintf(stderr, "unknown name: %s\n", name);
+  exit(2);
+}
+
+// The hardware bring-up of setup(), minus the splash screen and tasks
+static void benchSetup() {
+  nativeHal().serialQuiet = true;
+  romMathInit();
+  M5.Imu.init();
+  initI2S();
+  audioAnalyzer.begin(I2S_SAMPLE_RATE, I2S_DMA_BUF_LEN);
+  spectrumAnalyzer.begin(I2S_SAMPLE_RATE, 1000.0f * SPECTRUM_HOP / I2S_SAMPLE_RATE);
+  audioTaskRunning = false;  // the audio job drains the generated signal
+  autoMode = false;
+  initFramebuffer();
+  hudBegin();
+  formulaBegin();
+  if (!useFramebuffer) {
+    fprintf(stderr, "the native bench needs HECTOR_FRAMEBUFFER=1\n");
+    exit(1);
+  }
+}
+
+// Mode state as after a button press from boot: SINE uses the finer step
+// checkButtons() gives it, every other mode the boot step
+static void benchSelect(int wave, int display, int cols) {
+  waveStyle = (WaveStyle)wave;
+  displayStyle = (DisplayStyle)display;
+  surfaceFunction = surfaceModes[wave].scalar;
+  size = SIZE;
+  step = wave == SIN_WAVE ? STEP * 1.5 : STEP * 1.2;
+  setupScale();
+  if (cols) applyGridCols(cols);
+}
+
+// Sensor input for frame n, at 30 frames per simulated second
+static void benchSensors(int n) {
+  float t = n / 30.0f;
+  NativeHal& hal = nativeHal();
+  hal.accX = 0.3f * sinf(t * 0.9f);
+  hal.accY = 0.4f * sinf(t * 0.6f + 1.0f);
+  hal.gyroX = 20 * cosf(t * 0.9f);
+  hal.gyroY = 15 * cosf(t * 0.6f + 1.0f);
+  hal.audioBlocks = 6;  // 1536 samples, about one frame at 30 fps
+
+  benchFrameNumber = n;
+  updateIMU();
+  updateSound();
+  updateTrace();
+}
+
+static BenchResult benchRun(const BenchOptions& opt, int wave, int display) {
+  benchSelect(wave, display, opt.cols);
+  nativeHal().audioSample = 0;
+  if (opt.replay) benchTraceOpen(opt.replay, false);
+
+  BenchResult r;
+  double computeTotal = 0, renderTotal = 0, pushTotal = 0;
+  double start = 0;
+  for (int n = 0; n < BENCH_WARMUP_FRAMES + opt.frames; n++) {
+    if (n == BENCH_WARMUP_FRAMES) {
+      start = benchNow();
+      computeTotal = renderTotal = pushTotal = 0;
+    }
+    benchSensors(n);
+
+    // k = n * speed exactly: restart the fixed-step clock on every frame
+    simClock.begin(1000000 / HECTOR_SIM_HZ);
+    simK = n * speed;
+
+    double t0 = benchNow();
+    computeFrame(benchFrame);
+    double t1 = benchNow();
+    renderFrame(benchFrame);
+    double t2 = benchNow();
+    computeTotal += t1 - t0;
+    renderTotal += t2 - t1;
+    pushTotal += pushedBytes;
+    if (n >= BENCH_WARMUP_FRAMES) r.vertices += (long)surfaceCache.rows * surfaceCache.cols;
+  }
+
+  r.seconds = benchNow() - start;
+  if (benchTrace) benchTraceClose();
+  r.computeUs = computeTotal * 1e6 / opt.frames;
+  r.renderUs = renderTotal * 1e6 / opt.frames;
+  r.pushBytes = pushTotal / opt.frames;
+  r.cols = surfaceCache.cols;
+  r.rows = surfaceCache.rows;
+  return r;
+}
+
+// mkdir -p: false, with errno set, if a part of the path cannot be made
+static bool benchMakeDir(const char* dir) {
+  std::string path(dir);
+  for (size_t i = 1; i <= path.size(); i++) {
+    if (i < path.size() && path[i] != '/') continue;
+    std::string part = path.substr(0, i);
+    if (mkdir(part.c_str(), 0755) != 0 && errno != EEXIST) return false;
+  }
+  struct stat st;
+  if (stat(dir, &st) != 0) return false;
+  if (!S_ISDIR(st.st_mode)) {
+    errno = ENOTDIR;
+    return false;
+  }
+  return true;
+}
+
+static bool benchImage(const BenchOptions& opt, int wave, int display) {
+  std::string path = std::string(opt.images) + "/" + benchWaveNames[wave] + "_" +
+                     benchDisplayNames[display] + (opt.ppm ? ".ppm" : ".png");
+  const FrameBuffer& fb = frameBuffers[backBuffer];
+  bool ok = opt.ppm ? writeFramePpm(path.c_str(), fb) : writeFramePng(path.c_str(), fb);
+  if (!ok) fprintf(stderr, "cannot write %s\n", path.c_str());
+  return ok;
+}
+
+struct SurfaceResult {
+  double scalarNs = 0;  // per vertex, best frame
+  double rowNs = 0;
+  float maxError = 0;   // largest |row - scalar|
+  float maxZ = 0;       // largest |scalar|, for scale
+};
+
+static SurfaceResult benchSurface(const BenchOptions& opt, int wave) {
+  static float scalarZ[GRID_ARENA_VERTICES], rowZ[GRID_ARENA_VERTICES];
+  benchSelect(wave, DISPLAY_GRID, opt.cols);
+  nativeHal().audioSample = 0;
+  if (opt.replay) benchTraceOpen(opt.replay, false);
+  const SurfaceMode& mode = surfaceModes[wave];
+  const SurfaceCache& c = surfaceCache;
+
+  SurfaceResult r;
+  r.scalarNs = r.rowNs = DBL_MAX;
+  for (int n = 0; n < BENCH_WARMUP_FRAMES + opt.frames; n++) {
+    benchSensors(n);
+    simClock.begin(1000000 / HECTOR_SIM_HZ);
+    simK = n * speed;
+    beginCompute();  // sensors, k and the mode's frame tables
+
+    double scalarSeconds = 0, rowSeconds = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      const bool scalar = (pass == 0) == (n % 2 == 0);
+      double t0 = benchNow();
+      if (scalar) {
+        for (int i = 0; i < c.rows; i++) {
+          for (int j = 0; j < c.cols; j++) scalarZ[i * c.cols + j] = mode.scalar(c.x[i], c.y[j], k);
+        }
+      } else {
+        for (int i = 0; i < c.rows; i++) mode.row(c, i, k, rowZ + i * c.cols);
+      }
+      (scalar ? scalarSeconds : rowSeconds) = benchNow() - t0;
+    }
+    if (n < BENCH_WARMUP_FRAMES) continue;
+
+    const double vertices = (double)c.rows * c.cols;
+    r.scalarNs = std::min(r.scalarNs, scalarSeconds * 1e9 / vertices);
+    r.rowNs = std::min(r.rowNs, rowSeconds * 1e9 / vertices);
+    for (int v = 0; v < c.rows * c.cols; v++) {
+      r.maxError = std::max(r.maxError, fabsf(rowZ[v] - scalarZ[v]));
+      r.maxZ = std::max(r.maxZ, fabsf(scalarZ[v]));
+    }
+  }
+  if (benchTrace) benchTraceClose();
+  return r;
+}
+
+static int benchSurfaces(const BenchOptions& opt) {
+  if (opt.csv) printf("wave,cols,rows,frames,scalar_ns,row_ns,max_error,max_z\n");
+  else printf("%-10s %6s %11s %11s %8s %10s %8s\n", "wave", "grid", "scalar ns", "row ns", "speedup", "max |dz|", "max |z|");
+  int failures = 0;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    SurfaceResult r = benchSurface(opt, w);
+    const bool failed = r.rowNs > r.scalarNs;
+    failures += failed;
+    if (opt.csv) {
+      printf("%s,%d,%d,%d,%.2f,%.2f,%g,%g\n", benchWaveNames[w], surfaceCache.cols, surfaceCache.rows,
+             opt.frames, r.scalarNs, r.rowNs, r.maxError, r.maxZ);
+    } else {
+      printf("%-10s %3dx%-2d %11.2f %11.2f %7.2fx %10.2g %8.1f%s\n", benchWaveNames[w], surfaceCache.cols,
+             surfaceCache.rows, r.scalarNs, r.rowNs, r.rowNs > 0 ? r.scalarNs / r.rowNs : 0, r.maxError, r.maxZ,
+             failed ? "  FAIL" : "");
+    }
+    fflush(stdout);
+  }
+  if (!opt.csv) printf("ns per vertex, best frame\n%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// Built-in modes written as formulas, term for term
+struct BenchFormula {
+  int wave;
+  const char* text;
+};
+
+static const BenchFormula benchFormulas[] = {
+  { INTERFERENCE,
+    "(sin(sqrt((x + 20)^2 + (y + 20)^2) * 0.3 - k) * 25 +"
+    " sin(sqrt((x - 20)^2 + (y - 20)^2) * 0.3 - k * 1.2) * 25 +"
+    " sin(sqrt(x^2 + (y + 30)^2) * 0.25 - k * 0.8) * 20) * 0.6" },
+  { RIPPLE_TANK,
+    "r1 = sqrt((x + 15)^2 + (y + 10)^2);"
+    " r2 = sqrt((x - 20)^2 + (y - 15)^2);"
+    " r3 = sqrt((x - 10)^2 + (y + 25)^2);"
+    " 30 * cos(-k * 2 + r1 * 0.3) / (1 + r1 * 0.1) +"
+    " 25 * cos(-k * 2.5 + r2 * 0.28) / (1 + r2 * 0.12) +"
+    " 20 * cos(-k * 1.8 + r3 * 0.35) / (1 + r3 * 0.08)" },
+};
+
+struct FormulaResult {
+  double scalarNs = 0;  // per vertex, the mode's scalar function
+  double rowNs = 0;     // the mode's row function
+  double formulaNs = 0; // the formula's frame and row programs
+  double gridUs = 0;    // the formula's grid program, once per grid
+  float maxError = 0;   // largest |formula - scalar|
+};
+
+static FormulaProgram<GRID_MAX_COLS> benchProgram;
+
+static FormulaResult benchFormula(const BenchOptions& opt, const BenchFormula& f) {
+  static float scalarZ[GRID_ARENA_VERTICES], rowZ[GRID_ARENA_VERTICES], formulaZ[GRID_ARENA_VERTICES];
+  static float terms[CACHE_VERTEX_TERMS][GRID_ARENA_VERTICES];
+  if (!benchProgram.compile(f.text, CACHE_VERTEX_TERMS)) {
+    fprintf(stderr, "%s formula: %s at column %d\n", benchWaveNames[f.wave], benchProgram.error(),
+            benchProgram.errorAt() + 1);
+    exit(1);
+  }
+  benchSelect(f.wave, DISPLAY_GRID, opt.cols);
+  nativeHal().audioSample = 0;
+  if (opt.replay) benchTraceOpen(opt.replay, false);
+  const SurfaceMode& mode = surfaceModes[f.wave];
+  const SurfaceCache& c = surfaceCache;
+
+  FormulaResult r;
+  double scalarTotal = 0, rowTotal = 0, formulaTotal = 0;
+  long vertices = 0;
+  for (int n = 0; n < BENCH_WARMUP_FRAMES + opt.frames; n++) {
+    benchSensors(n);
+    simClock.begin(1000000 / HECTOR_SIM_HZ);
+    simK = n * speed;
+    beginCompute();
+
+    if (n == 0) {
+      float* rowTerms[CACHE_VERTEX_TERMS];
+      double g0 = benchNow();
+      for (int i = 0; i < c.rows; i++) {
+        for (int t = 0; t < CACHE_VERTEX_TERMS; t++) rowTerms[t] = terms[t] + i * c.cols;
+        benchProgram.gridRow(c.x[i], c.y, c.cols, rowTerms);
+      }
+      r.gridUs = (benchNow() - g0) * 1e6;
+    }
+
+    double t0 = benchNow();
+    for (int i = 0; i < c.rows; i++) {
+      for (int j = 0; j < c.cols; j++) scalarZ[i * c.cols + j] = mode.scalar(c.x[i], c.y[j], k);
+    }
+    double t1 = benchNow();
+    for (int i = 0; i < c.rows; i++) mode.row(c, i, k, rowZ + i * c.cols);
+    double t2 = benchNow();
+    benchProgram.frame(formulaInputs(k));
+    const float* rowTerms[CACHE_VERTEX_TERMS];
+    for (int i = 0; i < c.rows; i++) {
+      for (int t = 0; t < CACHE_VERTEX_TERMS; t++) rowTerms[t] = terms[t] + i * c.cols;
+      benchProgram.row(c.x[i], c.y, rowTerms, c.cols, formulaZ + i * c.cols);
+    }
+    double t3 = benchNow();
+    if (n < BENCH_WARMUP_FRAMES) continue;
+
+    scalarTotal += t1 - t0;
+    rowTotal += t2 - t1;
+    formulaTotal += t3 - t2;
+    vertices += (long)c.rows * c.cols;
+    for (int v = 0; v < c.rows * c.cols; v++) r.maxError = std::max(r.maxError, fabsf(formulaZ[v] - scalarZ[v]));
+  }
+  if (benchTrace) benchTraceClose();
+  r.scalarNs = scalarTotal * 1e9 / vertices;
+  r.rowNs = rowTotal * 1e9 / vertices;
+  r.formulaNs = formulaTotal * 1e9 / vertices;
+  return r;
+}
+
+// Formulas around x nested n deep: prefix n times, x, suffix n times
+static const char* benchNested(const char* prefix, const char* suffix, int n) {
+  static char text[FORMULA_MAX_TEXT];
+  text[0] = 0;
+  for (int i = 0; i < n; i++) strcat(text, prefix);
+  strcat(text, "x");
+  for (int i = 0; i < n; i++) strcat(text, suffix);
+  return text;
+}
+
+// compile() on malformed and deeply nested formulas: each must give the
+// expected error at the expected column (or compile, for error 0)
+static int benchFormulaErrors() {
+  struct Case {
+    const char* prefix;
+    const char* suffix;
+    int depth;
+    const char* error;
+    int column;
+  };
+  static const Case cases[] = {
+    {"(", ")", FORMULA_MAX_DEPTH, 0, 0},
+    {"(", ")", FORMULA_MAX_DEPTH + 1, "nested too deep", FORMULA_MAX_DEPTH + 2},
+    {"(", ")", 120, "nested too deep", FORMULA_MAX_DEPTH + 2},
+    {"-", "", FORMULA_MAX_DEPTH, 0, 0},
+    {"-", "", FORMULA_MAX_DEPTH + 1, "nested too deep", FORMULA_MAX_DEPTH + 2},
+    {"-(", ")", 60, "nested too deep", FORMULA_MAX_DEPTH + 2},
+    {"sin(", ")", FORMULA_MAX_DEPTH, 0, 0},
+    {"abs(", ")", 40, "nested too deep", 4 * FORMULA_MAX_DEPTH + 5},
+    {"", "^1", FORMULA_MAX_DEPTH, 0, 0},
+    {"", "^1", 100, "nested too deep", 2 * FORMULA_MAX_DEPTH + 3},
+    {"(", "", 1, "expected ')'", 3},
+    {"", "+(", 1, "unexpected end", 4},
+    {"sin(", "", 1, "expected ')'", 6},
+  };
+  int failures = 0;
+  printf("\n%-34s %-16s %6s\n", "formula", "error", "column");
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const Case& c = cases[i];
+    const char* text = benchNested(c.prefix, c.suffix, c.depth);
+    bool compiled = benchProgram.compile(text, CACHE_VERTEX_TERMS);
+    const char* error = compiled ? 0 : benchProgram.error();
+    int column = compiled ? 0 : benchProgram.errorAt() + 1;
+    bool failed = (error == 0) != (c.error == 0) || (error && (strcmp(error, c.error) || column != c.column));
+    failures += failed;
+    char shown[40];
+    snprintf(shown, sizeof(shown), "%.30s%s", text, strlen(text) > 30 ? "..." : "");
+    printf("%-34s %-16s %6d%s\n", shown, error ? error : "compiles", column, failed ? "  FAIL" : "");
+  }
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures;
+}
+
+static int benchFormulaModes(const BenchOptions& opt) {
+  if (opt.csv) printf("wave,cols,rows,frames,grid_ops,frame_ops,row_ops,hoisted,grid_us,scalar_ns,row_ns,formula_ns,max_error\n");
+  else printf("%-8s %6s %9s %5s %8s %10s %8s %11s %8s %10s\n", "wave", "grid", "ops g/f/r", "terms", "grid us",
+              "scalar ns", "row ns", "formula ns", "vs row", "max |dz|");
+  for (size_t f = 0; f < sizeof(benchFormulas) / sizeof(benchFormulas[0]); f++) {
+    if (opt.wave >= 0 && benchFormulas[f].wave != opt.wave) continue;
+    FormulaResult r = benchFormula(opt, benchFormulas[f]);
+    const FormulaProgram<GRID_MAX_COLS>& p = benchProgram;
+    const char* name = benchWaveNames[benchFormulas[f].wave];
+    if (opt.csv) {
+      printf("%s,%d,%d,%d,%d,%d,%d,%d,%.1f,%.2f,%.2f,%.2f,%g\n", name, surfaceCache.cols, surfaceCache.rows,
+             opt.frames, p.gridOps(), p.frameOps(), p.rowOps(), p.hoisted(), r.gridUs, r.scalarNs, r.rowNs,
+             r.formulaNs, r.maxError);
+    } else {
+      char ops[16];
+      snprintf(ops, sizeof(ops), "%d/%d/%d", p.gridOps(), p.frameOps(), p.rowOps());
+      printf("%-8s %3dx%-2d %9s %5d %8.1f %10.2f %8.2f %11.2f %7.2fx %10.2g\n", name, surfaceCache.cols,
+             surfaceCache.rows, ops, p.hoisted(), r.gridUs, r.scalarNs, r.rowNs, r.formulaNs,
+             r.rowNs > 0 ? r.formulaNs / r.rowNs : 0, r.maxError);
+    }
+    fflush(stdout);
+  }
+  if (opt.csv) return 0;
+  return benchFormulaErrors() ? 1 : 0;
+}
+
+// One stretch of the --power script; the sensors are noise of the given
+// amplitude around a stick lying tilted, with some gyro bias
+struct PowerScene {
+  const char* what;
+  int seconds;
+  float accNoise, gyroNoise;  // g, dps
+  float sound;
+  bool button;                // held for the whole stretch
+  bool active;                // the governor must stay ACTIVE
+};
+
+static const PowerScene powerScript[] = {
+  {"in hand",      30, 0.08f,  40.0f, 0.02f, false, true},
+  {"on a desk",   120, 0.003f, 0.4f,  0.01f, false, false},
+  {"button",        1, 0.003f, 0.4f,  0.01f, true,  true},
+  {"on a desk",    90, 0.003f, 0.4f,  0.01f, false, false},
+  {"talking",      10, 0.003f, 0.4f,  0.30f, false, true},
+  {"on a desk",   300, 0.003f, 0.4f,  0.02f, false, false},
+  {"picked up",    10, 0.08f,  40.0f, 0.02f, false, true},
+  {"on a desk",    90, 0.003f, 0.4f,  0.01f, false, false},
+};
+#define POWER_SIM_STEP_MS (POWER_PERIOD_US / 1000)
+#define POWER_SIM_FRAME_US 8000   // one frame's work on one core at 240 MHz
+#define POWER_SIM_WAKE_MS 250     // worst wake-up allowed
+#define POWER_SIM_SETTLE_MS 1000  // for the variance of the motion to die down
+
+static uint32_t powerNoiseState = 12345;
+
+static float powerNoise(float amplitude) {
+  powerNoiseState = powerNoiseState * 1664525u + 1013904223u;
+  return amplitude * ((powerNoiseState >> 8) / 8388608.0f - 1.0f);
+}
+
+// Estimated draw at a level, with the frame work scaled to its clock
+static float powerSimMw(const PowerSettings& s) {
+  float busy = s.fps * POWER_SIM_FRAME_US * (240.0f / s.cpuMhz) / 1e6f;
+  return powerEstimateMw(s.cpuMhz, busy, s.backlight);
+}
+
+static int benchPower() {
+  PowerConfig config;
+  config.level[POWER_ACTIVE].fps = HECTOR_TARGET_FPS;
+  PowerGovernor governor;
+  governor.begin(config, 0);
+  printf("power governor: %d ms updates, DIM after %lu s, DOZE after %lu s\n", POWER_SIM_STEP_MS,
+         (unsigned long)(config.dimAfterMs / 1000), (unsigned long)(config.dozeAfterMs / 1000));
+
+  double levelMs[POWER_LEVEL_COUNT] = {}, energy = 0, flatOut = 0;
+  uint32_t worstWakeMs = 0, t = 0;
+  int failures = 0;
+  for (const PowerScene& scene : powerScript) {
+    printf("%7.1f s  %s\n", t / 1000.0, scene.what);
+    const uint32_t start = t, end = t + scene.seconds * 1000u;
+    bool woke = governor.level() == POWER_ACTIVE;
+    bool dimmed = false, dozed = false;
+    for (; t < end; t += POWER_SIM_STEP_MS) {
+      PowerInputs in = {0.1f + powerNoise(scene.accNoise), 0.2f + powerNoise(scene.accNoise),
+                        0.97f + powerNoise(scene.accNoise), 1.5f + powerNoise(scene.gyroNoise),
+                        -0.8f + powerNoise(scene.gyroNoise), powerNoise(scene.gyroNoise),
+                        scene.sound, scene.button};
+      PowerLevel was = governor.level();
+      if (governor.update(t, in)) {
+        printf("%7.1f s    %s -> %s\n", t / 1000.0, powerLevelNames[was], powerLevelNames[governor.level()]);
+      }
+      PowerLevel now = governor.level();
+      if (scene.active && !woke && now == POWER_ACTIVE) {
+        woke = true;
+        // The activity may have begun just after the previous update
+        uint32_t wakeMs = t - start + POWER_SIM_STEP_MS;
+        if (wakeMs > worstWakeMs) worstWakeMs = wakeMs;
+      }
+      if (!scene.active && now == POWER_ACTIVE && was != POWER_ACTIVE) {
+        printf("  FAIL: woke while still\n");
+        failures++;
+      }
+      dimmed |= now == POWER_DIM && t - start <= config.dimAfterMs + POWER_SIM_SETTLE_MS;
+      dozed |= now == POWER_DOZE && t - start <= config.dozeAfterMs + POWER_SIM_SETTLE_MS;
+
+      levelMs[now] += POWER_SIM_STEP_MS;
+      energy += powerSimMw(governor.settings()) * POWER_SIM_STEP_MS;
+      flatOut += powerSimMw(config.level[POWER_ACTIVE]) * POWER_SIM_STEP_MS;
+    }
+    if (scene.active && !woke) {
+      printf("  FAIL: never woke\n");
+      failures++;
+    }
+    if (!scene.active && scene.seconds * 1000u > config.dimAfterMs && !dimmed) {
+      printf("  FAIL: not DIM %lu s after the activity\n", (unsigned long)(config.dimAfterMs / 1000));
+      failures++;
+    }
+    if (!scene.active && scene.seconds * 1000u > config.dozeAfterMs && !dozed) {
+      printf("  FAIL: not DOZE %lu s after the activity\n", (unsigned long)(config.dozeAfterMs / 1000));
+      failures++;
+    }
+  }
+  if (worstWakeMs > POWER_SIM_WAKE_MS) {
+    printf("FAIL: woke %lu ms after the activity started, allowed %d\n", (unsigned long)worstWakeMs,
+           POWER_SIM_WAKE_MS);
+    failures++;
+  }
+
+  printf("\n%-8s %9s %6s %6s %10s %9s %10s\n", "level", "time s", "fps", "MHz", "backlight", "~mW", "~mJ/frame");
+  for (int i = 0; i < POWER_LEVEL_COUNT; i++) {
+    const PowerSettings& s = config.level[i];
+    float mw = powerSimMw(s);
+    printf("%-8s %9.1f %6d %6d %10d %9.0f %10.2f\n", powerLevelNames[i], levelMs[i] / 1000, s.fps, s.cpuMhz,
+           s.backlight, mw, mw / s.fps);
+  }
+  printf("average ~%.0f mW governed, ~%.0f mW at full speed (%.0f%% less), a frame taking %d us at 240 MHz\n",
+         energy / t, flatOut / t, 100 * (1 - energy / flatOut), POWER_SIM_FRAME_US);
+  printf("worst wake-up %lu ms: %s\n", (unsigned long)worstWakeMs, failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// One stretch of the --fusion script: a body rate, and a linear
+// acceleration along world x on top of gravity
+struct FusionScene {
+  const char* what;
+  float seconds;
+  float rateX, rateY, rateZ;  // dps, body frame
+  float wobbleHz;             // 0: steady rates, else rates * sin(2 pi f t)
+  float shakeG, shakeHz;
+  float limitDeg;             // largest error allowed after the first FUSION_SIM_SETTLE_S
+};
+
+static const FusionScene fusionScript[] = {
+  {"still, tilted", 3, 0, 0, 0, 0, 0, 0, 1.0f},
+  {"turn 90 dps x", 1, 90, 0, 0, 0, 0, 0, 2.0f},
+  {"hold", 2, 0, 0, 0, 0, 0, 0, 1.0f},
+  {"turn 60 dps y", 1.5f, 0, -60, 0, 0, 0, 0, 2.0f},
+  {"shake 0.5 g", 3, 0, 0, 0, 0, 0.5f, 3, 2.0f},
+  {"wobble 1 Hz", 4, 40, 30, 10, 1, 0, 0, 2.0f},
+  {"hold", 3, 0, 0, 0, 0, 0, 0, 1.0f},
+};
+
+#define FUSION_SIM_FPS     60
+#define FUSION_SIM_SETTLE_S 0.5f  // from the start, and after each change of motion
+#define FUSION_GYRO_BIAS_X 1.5f   // dps
+#define FUSION_GYRO_BIAS_Y -1.0f
+#define FUSION_GYRO_BIAS_Z 0.5f
+
+// v (world) in the body frame of q
+static void fusionToBody(const Quat& q, float& x, float& y, float& z) {
+  Quat v;
+  v.w = 0;
+  v.x = x;
+  v.y = y;
+  v.z = z;
+  Quat c = q;
+  c.x = -c.x;
+  c.y = -c.y;
+  c.z = -c.z;
+  Quat r = quatMultiply(quatMultiply(c, v), q);
+  x = r.x;
+  y = r.y;
+  z = r.z;
+}
+
+static float fusionAngleDeg(float ax, float ay, float az, float bx, float by, float bz) {
+  float d = (ax * bx + ay * by + az * bz) /
+            sqrtf((ax * ax + ay * ay + az * az) * (bx * bx + by * by + bz * bz));
+  return acosf(d > 1 ? 1 : (d < -1 ? -1 : d)) / FUSION_DEG_TO_RAD;
+}
+
+static int benchFusion() {
+  const uint32_t readingUs = 1000000 / IMU_RATE_HZ;
+  const uint32_t frameUs = 1000000 / FUSION_SIM_FPS;
+  const uint32_t leadUs = frameUs;  // shown a frame later, as behind the pipeline
+
+  MahonyFilter filter;
+  filter.begin(FusionConfig());
+  Quat truth = quatFromGravity(-0.17f, 0.34f, 0.92f);  // about 20 degrees of roll, 10 of pitch
+  SeqLock<ImuSample> published;
+  ImuSample sample;
+  ImuReading batch[IMU_FIFO_BATCH];
+  int batched = 0;
+  float smoothAccX = 0, smoothAccY = 0, smoothAccZ = 1;  // the old 0.8/0.2 job
+
+  // Truth at frame time + lead, kept until the clock gets there
+  struct Pending {
+    uint32_t dueUs;
+    float fusedX, fusedY, fusedZ, oldX, oldY, oldZ;
+  } pending[8];
+  int pendingCount = 0;
+
+  printf("%-16s %8s %18s %18s\n", "scene", "seconds", "fused max/mean deg", "old max/mean deg");
+  int failures = 0;
+  uint32_t nowUs = 0;
+  for (size_t s = 0; s < sizeof(fusionScript) / sizeof(fusionScript[0]); s++) {
+    const FusionScene& scene = fusionScript[s];
+    const uint32_t startUs = nowUs, endUs = nowUs + (uint32_t)(scene.seconds * 1e6f);
+    float fusedMax = 0, fusedSum = 0, oldMax = 0, oldSum = 0;
+    int measured = 0;
+    for (; nowUs < endUs; nowUs += readingUs) {
+      const float t = (nowUs - startUs) * 1e-6f;
+      const float wobble = scene.wobbleHz ? sinf(2 * (float)M_PI * scene.wobbleHz * t) : 1;
+      const float rx = scene.rateX * wobble, ry = scene.rateY * wobble, rz = scene.rateZ * wobble;
+      truth = quatIntegrate(truth, rx * FUSION_DEG_TO_RAD, ry * FUSION_DEG_TO_RAD, rz * FUSION_DEG_TO_RAD,
+                            readingUs * 1e-6f);
+
+      // What the sensor reads: gravity and the shake in the body frame, bias, noise
+      ImuReading r;
+      quatGravity(truth, r.accX, r.accY, r.accZ);
+      float sx = scene.shakeG * sinf(2 * (float)M_PI * scene.shakeHz * t), sy = 0, sz = 0;
+      fusionToBody(truth, sx, sy, sz);
+      r.accX += sx + powerNoise(0.01f);
+      r.accY += sy + powerNoise(0.01f);
+      r.accZ += sz + powerNoise(0.01f);
+      r.gyroX = rx + FUSION_GYRO_BIAS_X + powerNoise(0.2f);
+      r.gyroY = ry + FUSION_GYRO_BIAS_Y + powerNoise(0.2f);
+      r.gyroZ = rz + FUSION_GYRO_BIAS_Z + powerNoise(0.2f);
+      batch[batched++] = r;
+
+      // The task: a burst every IMU_TASK_PERIOD_US
+      if (nowUs % IMU_TASK_PERIOD_US < readingUs) {
+        for (int i = 0; i < batched; i++) filter.update(batch[i], readingUs * 1e-6f);
+        batched = 0;
+        sample.orientation.q = filter.orientation();
+        sample.orientation.rateX = filter.rateX;
+        sample.orientation.rateY = filter.rateY;
+        sample.orientation.rateZ = filter.rateZ;
+        sample.orientation.timeUs = nowUs;
+        published.store(sample);
+      }
+      // The old IMU job
+      if (nowUs % IMU_PERIOD_US < readingUs) {
+        smoothAccX = smoothAccX * 0.8f + r.accX * 0.2f;
+        smoothAccY = smoothAccY * 0.8f + r.accY * 0.2f;
+        smoothAccZ = r.accZ;
+      }
+      // A frame: what each would show, checked when it is on the panel
+      if (nowUs % frameUs < readingUs && pendingCount < 8) {
+        Pending& p = pending[pendingCount++];
+        p.dueUs = nowUs + leadUs;
+        Quat q = orientationPredict(published.load().orientation, nowUs, leadUs, IMU_PREDICT_MAX_US);
+        quatGravity(q, p.fusedX, p.fusedY, p.fusedZ);
+        p.oldX = smoothAccX;
+        p.oldY = smoothAccY;
+        p.oldZ = smoothAccZ;
+      }
+      while (pendingCount && (int32_t)(nowUs - pending[0].dueUs) >= 0) {
+        Pending p = pending[0];
+        for (int i = 1; i < pendingCount; i++) pending[i - 1] = pending[i];
+        pendingCount--;
+        if (t < FUSION_SIM_SETTLE_S) continue;
+        float gx, gy, gz;
+        quatGravity(truth, gx, gy, gz);
+        float fused = fusionAngleDeg(p.fusedX, p.fusedY, p.fusedZ, gx, gy, gz);
+        float old = fusionAngleDeg(p.oldX, p.oldY, p.oldZ, gx, gy, gz);
+        fusedMax = std::max(fusedMax, fused);
+        oldMax = std::max(oldMax, old);
+        fusedSum += fused;
+        oldSum += old;
+        measured++;
+      }
+    }
+    bool failed = fusedMax > scene.limitDeg;
+    failures += failed;
+    printf("%-16s %8.1f %9.2f / %-6.2f %9.2f / %-6.2f%s\n", scene.what, scene.seconds, fusedMax,
+           measured ? fusedSum / measured : 0, oldMax, measured ? oldSum / measured : 0,
+           failed ? "  FAIL" : "");
+  }
+  printf("gyro bias learnt %.2f %.2f %.2f dps (true %.2f %.2f %.2f): %s\n", filter.biasX / FUSION_DEG_TO_RAD,
+         filter.biasY / FUSION_DEG_TO_RAD, filter.biasZ / FUSION_DEG_TO_RAD, FUSION_GYRO_BIAS_X,
+         FUSION_GYRO_BIAS_Y, FUSION_GYRO_BIAS_Z, failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// One transition in an --input script: bouncy contacts add four more
+// edges over 1.5 ms, a lost one never reaches the interrupt
+struct InputStep {
+  float atMs;
+  uint8_t button;
+  bool pressed;
+  bool bouncy, lost;
+};
+
+struct InputExpect {
+  uint8_t button;
+  InputGesture gesture;
+  float atMs;  // < 0: when the poll saw it, not checked
+};
+
+struct InputScript {
+  const char* what;
+  InputStep steps[6];
+  int stepCount;
+  InputExpect expect[6];
+  int expectCount;
+};
+
+#define INPUT_SIM_TICK_US 16667  // the btn poll at the start of every 60 fps frame
+#define INPUT_SIM_END_MS  1500
+
+static const InputScript inputScript[] = {
+  {"bouncy click A", {{100, INPUT_BUTTON_A, true, true, false}, {250, INPUT_BUTTON_A, false, true, false}}, 2,
+   {{INPUT_BUTTON_A, GESTURE_PRESS, 100}, {INPUT_BUTTON_A, GESTURE_CLICK, 250}}, 2},
+  {"double click PWR",
+   {{100, INPUT_BUTTON_PWR, true, true, false}, {180, INPUT_BUTTON_PWR, false, true, false},
+    {300, INPUT_BUTTON_PWR, true, true, false}, {380, INPUT_BUTTON_PWR, false, true, false}}, 4,
+   {{INPUT_BUTTON_PWR, GESTURE_PRESS, 100}, {INPUT_BUTTON_PWR, GESTURE_PRESS, 300},
+    {INPUT_BUTTON_PWR, GESTURE_DOUBLE_CLICK, 300}}, 3},
+  {"two slow clicks",
+   {{100, INPUT_BUTTON_PWR, true, true, false}, {180, INPUT_BUTTON_PWR, false, true, false},
+    {600, INPUT_BUTTON_PWR, true, true, false}, {680, INPUT_BUTTON_PWR, false, true, false}}, 4,
+   {{INPUT_BUTTON_PWR, GESTURE_PRESS, 100}, {INPUT_BUTTON_PWR, GESTURE_CLICK, 180},
+    {INPUT_BUTTON_PWR, GESTURE_PRESS, 600}, {INPUT_BUTTON_PWR, GESTURE_CLICK, 680}}, 4},
+  {"long press PWR", {{100, INPUT_BUTTON_PWR, true, true, false}, {1000, INPUT_BUTTON_PWR, false, true, false}}, 2,
+   {{INPUT_BUTTON_PWR, GESTURE_PRESS, 100}, {INPUT_BUTTON_PWR, GESTURE_LONG_PRESS, 700}}, 2},
+  {"release edge lost", {{100, INPUT_BUTTON_B, true, true, false}, {200, INPUT_BUTTON_B, false, false, true}}, 2,
+   {{INPUT_BUTTON_B, GESTURE_PRESS, 100}, {INPUT_BUTTON_B, GESTURE_CLICK, -1}}, 2},
+  {"A and B overlap",
+   {{100, INPUT_BUTTON_A, true, true, false}, {120, INPUT_BUTTON_B, true, true, false},
+    {200, INPUT_BUTTON_B, false, true, false}, {220, INPUT_BUTTON_A, false, true, false}}, 4,
+   {{INPUT_BUTTON_A, GESTURE_PRESS, 100}, {INPUT_BUTTON_B, GESTURE_PRESS, 120},
+    {INPUT_BUTTON_B, GESTURE_CLICK, 200}, {INPUT_BUTTON_A, GESTURE_CLICK, 220}}, 4},
+};
+
+static const char* const benchButtonNames[INPUT_BUTTON_COUNT] = { "A", "B", "PWR" };
+
+// The script through the detector as checkButtons() runs it: the edges
+// the interrupts queued, then the polled levels, then the timeouts
+static bool benchInputScript(const InputScript& script, std::string& got) {
+  InputEdge edges[64];
+  int edgeCount = 0;
+  for (int i = 0; i < script.stepCount; i++) {
+    const InputStep& st = script.steps[i];
+    if (st.lost) continue;
+    static const float bounceMs[5] = {0, 0.3f, 0.6f, 1.0f, 1.5f};
+    for (int b = 0; b < (st.bouncy ? 5 : 1); b++) {
+      InputEdge e = {st.button, (b % 2 == 0) == st.pressed, (uint32_t)((st.atMs + bounceMs[b]) * 1000)};
+      edges[edgeCount++] = e;
+    }
+  }
+
+  GestureDetector detector;
+  detector.begin(InputConfig(), 0);
+  bool level[INPUT_BUTTON_COUNT] = {};
+  int nextEdge = 0, nextStep = 0, matched = 0;
+  bool ok = true;
+  InputEvent ev;
+  for (uint32_t now = 0; now < INPUT_SIM_END_MS * 1000; now += INPUT_SIM_TICK_US) {
+    while (nextEdge < edgeCount && edges[nextEdge].timeUs <= now) detector.edge(edges[nextEdge++]);
+    while (nextStep < script.stepCount && script.steps[nextStep].atMs * 1000 <= now) {
+      level[script.steps[nextStep].button] = script.steps[nextStep].pressed;
+      nextStep++;
+    }
+    for (int b = 0; b < INPUT_BUTTON_COUNT; b++) {
+      if (level[b] != detector.rawPressed(b)) {
+        InputEdge e = {(uint8_t)b, level[b], now};
+        detector.edge(e);
+      }
+    }
+    detector.tick(now);
+    while (detector.next(ev)) {
+      char text[32];
+      snprintf(text, sizeof(text), "%s%s %s@%.0f", got.empty() ? "" : ", ", benchButtonNames[ev.button],
+               inputGestureNames[ev.gesture], ev.timeUs / 1000.0f);
+      got += text;
+      const InputExpect* want = matched < script.expectCount ? &script.expect[matched] : nullptr;
+      matched++;
+      if (!want || want->button != ev.button || want->gesture != ev.gesture ||
+          (want->atMs >= 0 && fabsf(want->atMs - ev.timeUs / 1000.0f) > 0.01f)) ok = false;
+    }
+  }
+  return ok && matched == script.expectCount;
+}
+
+// A frame as the device runs one, after the buttons
+static void benchInputFrame(int n) {
+  benchSensors(n);
+  checkButtons();
+  computeFrame(benchFrame);
+  renderFrame(benchFrame);
+}
+
+// Hold a button for the given frames, then release it; how many frames
+// the command took to show and the time from the edge to the push
+static bool benchInputPress(uint8_t pin, int holdFrames, uint32_t waitUs, int& n, uint32_t& latencyUs) {
+  nativeHal().pinLow[pin] = true;
+  latencyUs = 0;
+  bool seen = false;
+  for (int i = 0; i < holdFrames; i++, n++) {
+    benchInputFrame(n);
+    if (!seen && benchFrame.status.inputUs) {
+      seen = true;
+      latencyUs = pipelineMicros() - benchFrame.status.inputUs;
+    }
+  }
+  nativeHal().pinLow[pin] = false;
+  for (int i = 0; i < 3; i++, n++) {
+    if (i == 1 && waitUs) pipelineSleepMicros(waitUs);
+    benchInputFrame(n);
+    if (!seen && benchFrame.status.inputUs) {
+      seen = true;
+      latencyUs = pipelineMicros() - benchFrame.status.inputUs;
+    }
+  }
+  return seen;
+}
+
+static int benchInput() {
+  int failures = 0;
+  printf("%-20s %s\n", "script", "gestures (ms)");
+  for (size_t i = 0; i < sizeof(inputScript) / sizeof(inputScript[0]); i++) {
+    std::string got;
+    bool ok = benchInputScript(inputScript[i], got);
+    failures += !ok;
+    printf("%-20s %s%s\n", inputScript[i].what, got.c_str(), ok ? "" : "  FAIL");
+  }
+
+  // End to end on the host clock: stub GPIO levels, polled at each frame
+  benchSetup();
+  profiler.begin(PROF_STAGE_COUNT);
+  inputBegin();
+  benchSelect(SIN_WAVE, DISPLAY_GRID, 0);
+  int n = 0;
+  for (int i = 0; i < 3; i++, n++) benchInputFrame(n);
+
+  uint32_t latencyUs;
+  bool ok = benchInputPress(INPUT_PIN_A, 1, 0, n, latencyUs) && displayStyle == DISPLAY_SOLID &&
+            benchFrame.status.banner == BANNER_STYLE;
+  failures += !ok;
+  printf("button A press       style GRID -> %s, %lu us to the push%s\n", displayStyleNames[displayStyle],
+         (unsigned long)latencyUs, ok ? "" : "  FAIL");
+
+  ok = benchInputPress(INPUT_PIN_B, 1, 0, n, latencyUs) && waveStyle == DRIP_WAVE;
+  failures += !ok;
+  printf("button B press       wave SINE -> %s, %lu us to the push%s\n", waveStyleNames[waveStyle],
+         (unsigned long)latencyUs, ok ? "" : "  FAIL");
+
+  const PaletteId before = paletteId;
+  InputConfig config;
+  ok = benchInputPress(INPUT_PIN_PWR, 1, config.doubleClickUs + 20000, n, latencyUs) && paletteId != before;
+  failures += !ok;
+  printf("power click          palette %s -> %s, %lu us to the push (the double-click window)%s\n",
+         paletteSpecs[before].name, paletteSpecs[paletteId].name, (unsigned long)latencyUs, ok ? "" : "  FAIL");
+
+  printf("gestures dropped %lu, edges dropped %lu, commands dropped %lu: %s\n", (unsigned long)gestures.dropped(),
+         (unsigned long)inputEdges.dropped(), (unsigned long)commandQueue.dropped(), failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+#if HECTOR_HUD
+#define HUD_BENCH_FRAMES 600
+#define HUD_BENCH_PASSES 50
+#define HUD_BENCH_SURFACE 0x4208  // what the surface left under the text
+
+// What frame n of the --hud script shows: SOUND with the readouts moving
+// every frame, SPIRAL for a while, a banner now and then, the overlay in
+// the second half, FPS and the profiler figures once a second
+static void benchHudScript(int n, SceneKey& scene, FrameStatus& status) {
+  scene.style = (n / 150) % 4 == 2 ? SPIRAL_WAVE : SOUND_REACTIVE;
+  scene.palette = (n / 75) % PALETTE_COUNT;
+  status.display = (uint8_t)((n / 90) % DISPLAY_STYLE_COUNT);
+  status.overlay = n >= HUD_BENCH_FRAMES / 2;
+  status.autoMode = (n / 200) % 2;
+  static const uint8_t banners[] = {BANNER_NONE, BANNER_STYLE, BANNER_NONE, BANNER_WAVE,
+                                    BANNER_NONE, BANNER_PALETTE, BANNER_NONE, BANNER_AUTO};
+  status.banner = banners[(n / 40) % 8];
+  // The readouts are in the status, as beginCompute() snapshots them; the
+  // live values have moved on and must not show
+  status.soundLevel = scene.style == SOUND_REACTIVE ? 0.06f + 0.05f * sinf(n * 0.37f) : 0;
+  status.soundPower = scene.style == SOUND_REACTIVE ? 4000 + 3000 * sinf(n * 0.11f) + 50 : 0;
+  soundLevel = 0.9f;
+  soundPower = 99900;
+  waveStyle = scene.style == SOUND_REACTIVE ? SPIRAL_WAVE : SOUND_REACTIVE;
+  fps = 55 + (n / 60) % 6;
+  for (int i = 0; i < PROF_STAGE_COUNT; i++) {
+    profileSummary[i].avgUs = (uint32_t)((n / 60 + 1) * (i * 37 + 11) % 20000);
+    profileSummary[i].p99Us = profileSummary[i].avgUs * 2 + i;
+  }
+}
+
+// The text the printf path drew for frame n, each line with its place
+// and color
+struct HudBenchLine {
+  int x, y;
+  uint16_t color;
+  char text[32];
+};
+
+static int benchHudExpected(const SceneKey& scene, const FrameStatus& status, HudBenchLine* lines) {
+  int n = 0;
+  HudBenchLine* l = &lines[n++];
+  l->x = 5, l->y = 5, l->color = WHITE;
+  switch (status.banner) {
+    case BANNER_STYLE: snprintf(l->text, sizeof(l->text), "Style: %s", displayStyleNames[status.display]); break;
+    case BANNER_PALETTE: snprintf(l->text, sizeof(l->text), "Palette: %s", paletteSpecs[scene.palette].name); break;
+    case BANNER_AUTO: snprintf(l->text, sizeof(l->text), "Auto: %s", status.autoMode ? "ON" : "OFF"); break;
+    default: snprintf(l->text, sizeof(l->text), "FPS:%2d", fps); break;
+  }
+  l = &lines[n++];
+  l->y = 5, l->color = GREEN;
+  if (status.banner == BANNER_WAVE) {
+    l->x = 125;
+    snprintf(l->text, sizeof(l->text), "%s", waveStyleNames[scene.style]);
+  } else {
+    l->x = 180;
+    snprintf(l->text, sizeof(l->text), "%s", waveLabelNames[scene.style]);
+  }
+  if (scene.style == SOUND_REACTIVE) {
+    l = &lines[n++];
+    l->x = 180, l->y = 15, l->color = status.soundLevel > 0.05 ? RED : YELLOW;
+    snprintf(l->text, sizeof(l->text), "%.2f", lroundf(status.soundLevel * 100) / 100.0);
+    l = &lines[n++];
+    l->x = 180, l->y = 25, l->color = CYAN;
+    snprintf(l->text, sizeof(l->text), "%ld", lroundf(status.soundPower / 100));
+  }
+  for (int i = 0; status.overlay && i < PROF_STAGE_COUNT; i++) {
+    l = &lines[n++];
+    l->x = 2, l->y = 18 + 8 * i, l->color = CYAN;
+    snprintf(l->text, sizeof(l->text), "%-5s%5lu%6lu", profileStageNames[i], (unsigned long)profileSummary[i].avgUs,
+             (unsigned long)profileSummary[i].p99Us);
+  }
+  return n;
+}
+
+// Pixels that differ from the expected lines drawn glyph by glyph on
+// black boxes, with the surface everywhere else
+static int benchHudCompare(const FrameBuffer& fb, const HudBenchLine* lines, int count) {
+  static uint16_t want[135 * 240];
+  for (int i = 0; i < fb.width * fb.height; i++) want[i] = HUD_BENCH_SURFACE;
+  for (int j = 0; j < count; j++) {
+    const HudBenchLine& l = lines[j];
+    for (int c = 0; l.text[c]; c++) {
+      const uint8_t* g = hud.font.glyph(l.text[c]);
+      for (int y = 0; y < HUD_GLYPH_H; y++) {
+        for (int x = 0; x < HUD_GLYPH_W; x++) {
+          const int px = l.x + c * HUD_GLYPH_W + x, py = l.y + y;
+          if (px < fb.width && py < fb.height) want[py * fb.width + px] = (g[y] & (0x80 >> x)) ? l.color : BLACK;
+        }
+      }
+    }
+  }
+  int wrong = 0;
+  for (int i = 0; i < fb.width * fb.height; i++) wrong += fbSwap565(fb.pixels[i]) != want[i];
+  return wrong;
+}
+
+// Seconds for the whole script HUD_BENCH_PASSES times, and the lines
+// recomposed per frame
+static double benchHudTime(bool everyFrame, double& composites) {
+  SceneKey scene;
+  FrameStatus status;
+  const uint32_t before = hud.composites;
+  double total = 0;
+  for (int pass = 0; pass < HUD_BENCH_PASSES; pass++) {
+    for (int n = 0; n < HUD_BENCH_FRAMES; n++) {
+      benchHudScript(n, scene, status);
+      if (everyFrame) hud.invalidate();
+      double t0 = benchNow();
+      drawStatus(scene, status);
+      total += benchNow() - t0;
+    }
+  }
+  composites = (double)(hud.composites - before) / (HUD_BENCH_PASSES * HUD_BENCH_FRAMES);
+  return total;
+}
+
+static int benchHud() {
+  benchSetup();
+  profiler.begin(PROF_STAGE_COUNT);
+  for (int c = 1; c < HUD_CHAR_COUNT; c++) {
+    for (int y = 0; y < HUD_GLYPH_H - 1; y++) hud.font.rows[c][y] = (uint8_t)(((c + 3) * (y + 5) * 29) ^ c) & 0xF8;
+  }
+  hudRenderLabels();
+
+  FrameBuffer& fb = frameBuffers[backBuffer];
+  SceneKey scene;
+  FrameStatus status;
+  HudBenchLine lines[4 + PROF_STAGE_COUNT];
+  long checked = 0, wrong = 0;
+  for (int n = 0; n < HUD_BENCH_FRAMES; n++) {
+    benchHudScript(n, scene, status);
+    fbClear(fb, HUD_BENCH_SURFACE);
+    drawStatus(scene, status);
+    const int count = benchHudExpected(scene, status, lines);
+    wrong += benchHudCompare(fb, lines, count);
+    checked += count;
+  }
+  printf("%d frames, %ld lines checked against the printed text, %ld pixels wrong\n", HUD_BENCH_FRAMES, checked,
+         wrong);
+
+  double retainedComposites, everyComposites;
+  const double retained = benchHudTime(false, retainedComposites);
+  const double every = benchHudTime(true, everyComposites);
+  const double frames = HUD_BENCH_PASSES * HUD_BENCH_FRAMES;
+  printf("%-22s %8s %12s\n", "status text", "us/frame", "lines/frame");
+  printf("%-22s %8.2f %12.2f\n", "retained", retained * 1e6 / frames, retainedComposites);
+  printf("%-22s %8.2f %12.2f\n", "recomposed each frame", every * 1e6 / frames, everyComposites);
+  printf("%s\n", wrong ? "FAILED" : "ok");
+  return wrong ? 1 : 0;
+}
+#else
+static int benchHud() {
+  fprintf(stderr, "--hud needs HECTOR_HUD=1\n");
+  return 1;
+}
+#endif
+
+// --audio: native/fixtures/rms_tones.wav (tools/audio_fixture.py) through
+// AudioAnalyzer a DMA buffer at a time, as the capture task feeds it. Once
+// a stretch fills the window, power, peak and DC must match the signal the
+// fixture was written from, and the level must follow the noise gate.
+#define AUDIO_FIXTURE "native/fixtures/rms_tones.wav"
+#define AUDIO_FIXTURE_DC 1000.0f
+
+struct AudioStretch {
+  const char* what;
+  uint32_t samples;
+  float rms, peak;
+  bool gated;  // below AUDIO_NOISE_GATE: the level only falls
+};
+
+static const AudioStretch audioStretches[] = {
+  { "sine, amplitude 8000", 4096, 5656.85f, 8000, false },
+  { "square, +-3000", 4096, 3000, 3000, false },
+  { "sine, amplitude 200", 4096, 141.42f, 200, true },
+};
+
+// 16-bit mono PCM samples of a RIFF/WAVE file, or empty if it is not one
+static std::vector<int16_t> benchReadWav(const char* path, uint32_t& rate) {
+  std::vector<int16_t> pcm;
+  FILE* f = fopen(path, "rb");
+  if (!f) return pcm;
+  uint8_t riff[12];
+  bool ok = fread(riff, 1, 12, f) == 12 && !memcmp(riff, "RIFF", 4) && !memcmp(riff + 8, "WAVE", 4);
+  bool format = false;
+  uint8_t chunk[8];
+  while (ok && fread(chunk, 1, 8, f) == 8) {
+    uint32_t size = chunk[4] | chunk[5] << 8 | chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+    if (!memcmp(chunk, "fmt ", 4)) {
+      uint8_t fmt[16];
+      ok = size >= 16 && fread(fmt, 1, 16, f) == 16;
+      // PCM, one channel, 16 bits
+      format = ok && fmt[0] == 1 && fmt[2] == 1 && fmt[14] == 16;
+      rate = fmt[4] | fmt[5] << 8 | fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+      fseek(f, size - 16 + (size & 1), SEEK_CUR);
+    } else if (!memcmp(chunk, "data", 4) && format) {
+      pcm.resize(size / 2);
+      ok = fread(pcm.data(), 2, pcm.size(), f) == pcm.size();  // little-endian host
+      break;
+    } else {
+      fseek(f, size + (size & 1), SEEK_CUR);
+    }
+  }
+  fclose(f);
+  if (!ok || !format) pcm.clear();
+  return pcm;
+}
+
+static int benchAudio() {
+  uint32_t rate = 0;
+  std::vector<int16_t> pcm = benchReadWav(AUDIO_FIXTURE, rate);
+  uint32_t total = 0;
+  for (const AudioStretch& s : audioStretches) total += s.samples;
+  if (pcm.size() != total || rate != I2S_SAMPLE_RATE) {
+    fprintf(stderr, "cannot read %s as %u samples of 16-bit mono at %d Hz (run from the repository root)\n",
+            AUDIO_FIXTURE, total, I2S_SAMPLE_RATE);
+    return 1;
+  }
+
+  AudioAnalyzer analyzer;
+  analyzer.begin(I2S_SAMPLE_RATE, I2S_DMA_BUF_LEN);
+  printf("%-22s %9s %19s %9s %9s %13s\n", "stretch", "rms", "power min..max", "peak", "dc", "level");
+  int failures = 0;
+  uint32_t at = 0;
+  for (const AudioStretch& s : audioStretches) {
+    float powerMin = 1e9f, powerMax = 0, peakMax = 0, dcError = 0;
+    float levelStart = analyzer.levels().level, lastLevel = levelStart;
+    bool levelWrong = false;
+    for (uint32_t done = 0; done < s.samples; done += I2S_DMA_BUF_LEN) {
+      analyzer.process(&pcm[at + done], I2S_DMA_BUF_LEN);
+      const AudioLevels& l = analyzer.levels();
+      // Rising toward the gated target, or falling when gated
+      levelWrong |= s.gated ? l.level > lastLevel : l.level < lastLevel || l.level > AUDIO_LEVEL_MAX;
+      lastLevel = l.level;
+      if (done + I2S_DMA_BUF_LEN < AUDIO_WINDOW_LEN) continue;  // the window still holds the last stretch
+      powerMin = std::min(powerMin, l.power);
+      powerMax = std::max(powerMax, l.power);
+      peakMax = std::max(peakMax, l.peak);
+      dcError = std::max(dcError, fabsf(l.dcOffset - AUDIO_FIXTURE_DC));
+    }
+    at += s.samples;
+    bool failed = fabsf(powerMin - s.rms) > 0.01f * s.rms || fabsf(powerMax - s.rms) > 0.01f * s.rms ||
+                  fabsf(peakMax - s.peak) > 0.01f * s.peak + dcError || dcError > 50 || levelWrong;
+    failures += failed;
+    printf("%-22s %9.1f %9.1f..%-9.1f %9.1f %+9.1f %6.3f..%.3f%s\n", s.what, s.rms, powerMin, powerMax,
+           peakMax, dcError, levelStart, lastLevel, failed ? "  FAIL" : "");
+  }
+  printf("dc: largest distance from %.0f; tolerances 1%% power, 1%% peak + the dc error, 50 dc\n%s\n", AUDIO_FIXTURE_DC,
+         failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --fft: the band layout of the spectrum analyzer at the FFT sizes and
+// sample rates it may run at (every band at least one bin, contiguous up
+// to N / 2), a tone in each band lighting that band the most, and the
+// microseconds of the radix-2 transform and of a whole analyze() call.
+#define FFT_BENCH_CALLS 2000
+#define FFT_BENCH_AMPLITUDE 3000
+
+template <size_t N>
+static int benchFftBands(float rate) {
+  static SpectrumAnalyzer<N> analyzer;
+  analyzer.begin(rate, 1000.0f * N / 2 / rate);
+  int wrong = 0;
+  size_t expected = 1;
+  for (int b = 0; b < SPECTRUM_BANDS; b++) {
+    const size_t start = analyzer.bandFirstBin(b), end = analyzer.bandEndBin(b);
+    if (end <= start || (b ? start != expected : start < 1)) wrong++;
+    expected = end;
+  }
+  if (expected != N / 2) wrong++;
+  if (wrong) {
+    printf("  %4zu points at %5.0f Hz:", N, rate);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) printf(" %zu-%zu", analyzer.bandFirstBin(b), analyzer.bandEndBin(b));
+    printf("  FAIL\n");
+  }
+  return wrong;
+}
+
+// A tone on the middle bin of each band, held until the levels settle
+template <size_t N>
+static int benchFftTones(float rate) {
+  static SpectrumAnalyzer<N> analyzer;
+  static int16_t samples[N];
+  int misplaced = 0;
+  for (int b = 0; b < SPECTRUM_BANDS; b++) {
+    analyzer.begin(rate, 1000.0f * N / 2 / rate);
+    const size_t bin = (analyzer.bandFirstBin(b) + analyzer.bandEndBin(b) - 1) / 2;
+    for (size_t i = 0; i < N; i++) samples[i] = (int16_t)lrintf(FFT_BENCH_AMPLITUDE * sinf(2 * (float)M_PI * bin * i / N));
+    for (int n = 0; n < 30; n++) analyzer.analyze(samples);
+    int loudest = 0;
+    for (int i = 1; i < SPECTRUM_BANDS; i++) {
+      if (analyzer.levels().level[i] > analyzer.levels().level[loudest]) loudest = i;
+    }
+    if (loudest != b) {
+      printf("  %4zu points: tone on bin %zu (band %d) is loudest in band %d  FAIL\n", N, bin, b, loudest);
+      misplaced++;
+    }
+  }
+  return misplaced;
+}
+
+template <size_t N>
+static void benchFftTime(float rate) {
+  static FFT<N> fft;
+  static SpectrumAnalyzer<N> analyzer;
+  static int16_t samples[N];
+  static float re[N], im[N];
+  fft.begin();
+  analyzer.begin(rate, 1000.0f * N / 2 / rate);
+  for (size_t i = 0; i < N; i++) samples[i] = (int16_t)(rand() % 6001 - 3000);
+  double t0 = benchNow();
+  for (int n = 0; n < FFT_BENCH_CALLS; n++) fft.forward(samples, re, im);
+  double t1 = benchNow();
+  for (int n = 0; n < FFT_BENCH_CALLS; n++) analyzer.analyze(samples);
+  double t2 = benchNow();
+  printf("%4zu points: forward %7.1f us, analyze %7.1f us, %5.1f ms of audio at %.0f Hz\n", N,
+         (t1 - t0) * 1e6 / FFT_BENCH_CALLS, (t2 - t1) * 1e6 / FFT_BENCH_CALLS, 1000.0f * N / rate, rate);
+}
+
+static int benchFft() {
+  const float rates[] = { 8000, 16000, 22050, 44100, 48000 };
+  int bandFailures = 0, toneFailures = 0;
+  for (float rate : rates) {
+    bandFailures += benchFftBands<64>(rate) + benchFftBands<512>(rate) + benchFftBands<1024>(rate);
+  }
+  printf("band edges, 64/512/1024 points at 8-48 kHz: %s\n", bandFailures ? "FAILED" : "ok");
+  toneFailures = benchFftTones<512>(I2S_SAMPLE_RATE) + benchFftTones<1024>(I2S_SAMPLE_RATE);
+  printf("a tone in each band, 512/1024 points: %s\n", toneFailures ? "FAILED" : "ok");
+  benchFftTime<512>(I2S_SAMPLE_RATE);
+  benchFftTime<1024>(I2S_SAMPLE_RATE);
+  const bool failed = bandFailures || toneFailures;
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
+
+// --projection: FixedProjection against FloatProjection on every mode's
+// rows, with the camera swept across the whole tilt range (yaw +-2, pitch
+// +-1.5 radians, as far as the accelerometer can turn it). Every vertex
+// the float path puts on screen must be valid in both and within one
+// pixel; each policy is also timed on the same rows.
+#define PROJECTION_BENCH_FRAMES 120
+
+struct ProjectionResult {
+  long vertices = 0, onScreen = 0, beyond = 0, invalid = 0;
+  int maxDx = 0, maxDy = 0;
+  double floatNs = 0, fixedNs = 0;
+};
+
+static ProjectionResult benchProjectionMode(int wave) {
+  static FloatProjection<GRID_MAX_COLS> floatProjection;
+  static FixedProjection<GRID_MAX_COLS> fixedProjection;
+  static VertexArena<2 * GRID_MAX_COLS, 2> rows;
+  static float heights[GRID_MAX_ROWS][GRID_MAX_COLS];
+  benchSelect(wave, DISPLAY_GRID, 0);
+  nativeHal().audioSample = 0;
+  const SurfaceCache& c = surfaceCache;
+  const SurfaceMode& mode = surfaceModes[wave];
+
+  ProjectionResult r;
+  double floatTotal = 0, fixedTotal = 0;
+  for (int n = 0; n < PROJECTION_BENCH_FRAMES; n++) {
+    benchSensors(n);
+    simClock.begin(1000000 / HECTOR_SIM_HZ);
+    simK = n * speed;
+    beginCompute();
+    rows.layout(2, c.cols);
+    const VertexRow a = rows.row(0), b = rows.row(1);
+    for (int i = 0; i < c.rows; i++) {
+      mode.row(c, i, k, heights[i]);
+      for (int j = 0; j < c.cols; j++) heights[i][j] *= 1.2f;
+    }
+
+    const float t = (float)n / (PROJECTION_BENCH_FRAMES - 1);
+    const float ah = -2 + 4 * t, av = 1.5f * sinf(2 * (float)M_PI * 3 * t);
+    ProjectionSetup view;
+    view.cosAh = romcos(ah);
+    view.sinAh = romsin(ah);
+    view.cosAv = romcos(av);
+    view.sinAv = romsin(av);
+    view.size = size;
+    view.tsize = tsize;
+    view.zoom = zoom;
+    view.halfWidth = screenHalfWidth;
+    view.halfHeight = screenHalfHeight;
+    floatProjection.begin(view, c.y, c.cols);
+    fixedProjection.begin(view, c.y, c.cols);
+
+    for (int i = 0; i < c.rows; i++) {
+      a.clearValid();
+      b.clearValid();
+      double t0 = benchNow();
+      floatProjection.row(c.x[i], heights[i], a);
+      double t1 = benchNow();
+      fixedProjection.row(c.x[i], heights[i], b);
+      double t2 = benchNow();
+      floatTotal += t1 - t0;
+      fixedTotal += t2 - t1;
+      for (int j = 0; j < c.cols; j++) {
+        r.vertices++;
+        if (!a.isValid(j) || a.x[j] < 0 || a.x[j] >= screenWidth || a.y[j] < 0 || a.y[j] >= screenHeight) continue;
+        r.onScreen++;
+        if (!b.isValid(j)) {
+          r.invalid++;
+          continue;
+        }
+        const int dx = abs(a.x[j] - b.x[j]), dy = abs(a.y[j] - b.y[j]);
+        r.maxDx = std::max(r.maxDx, dx);
+        r.maxDy = std::max(r.maxDy, dy);
+        r.beyond += dx > 1 || dy > 1;
+      }
+    }
+  }
+  r.floatNs = floatTotal * 1e9 / r.vertices;
+  r.fixedNs = fixedTotal * 1e9 / r.vertices;
+  return r;
+}
+
+static int benchProjection(const BenchOptions& opt) {
+  printf("%-10s %9s %9s %7s %7s %8s %8s %9s %9s\n", "wave", "vertices", "on screen", "max dx", "max dy",
+         "> 1 px", "invalid", "float ns", "fixed ns");
+  int failures = 0;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    ProjectionResult r = benchProjectionMode(w);
+    const bool failed = r.beyond || r.invalid;
+    failures += failed;
+    printf("%-10s %9ld %9ld %7d %7d %8ld %8ld %9.2f %9.2f%s\n", benchWaveNames[w], r.vertices, r.onScreen, r.maxDx,
+           r.maxDy, r.beyond, r.invalid, r.floatNs, r.fixedNs, failed ? "  FAIL" : "");
+  }
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --fill: SOLID strips through drawSolidStrip() as the renderer draws them
+// (nearest row first, coverage on) against a painter's reference: the
+// same triangles in exactly the reverse order, without coverage, so the
+// last one drawn wins where the renderer's first one did. The two only
+// differ where the draw order is not the depth order (folds in a strip).
+// Every mode at three densities and 20 camera angles along the sensor
+// path; coverage must leave no hole where the reference drew. Writes and
+// time per frame give the fill rate of both.
+#define FILL_BENCH_ANGLES 20
+#define FILL_BENCH_FRAME_GAP 15  // frames between angles, half a simulated second
+static const int fillBenchCols[] = { 17, 31, 47 };
+
+struct FillResult {
+  long frames = 0, skipped = 0;  // skipped: yawed past 45 degrees, no coverage
+  double pixels = 0, coveredWrites = 0, painterWrites = 0;
+  double coveredSeconds = 0, painterSeconds = 0;
+  long differ = 0, holes = 0;
+};
+
+// drawSolidStrip() backwards: quads right to left, each quad's second
+// triangle first
+static void benchPaintStrip(const GridRow& prev, const GridRow& row) {
+  FrameBuffer& fb = frameBuffers[backBuffer];
+  for (int i = row.cols - 1; i >= 1; i--) {
+    if (!row.isValid(i) || !row.isValid(i - 1) || !prev.isValid(i) || !prev.isValid(i - 1)) continue;
+    const uint16_t color = row.color[i];
+    if (color == 0) continue;
+    fbFillTriangleClipped(fb, surfaceViewport, &solidCoverage, row.x[i - 1], row.y[i - 1] + 10, prev.x[i],
+                          prev.y[i] + 10, prev.x[i - 1], prev.y[i - 1] + 10, color);
+    fbFillTriangleClipped(fb, surfaceViewport, &solidCoverage, row.x[i - 1], row.y[i - 1] + 10, row.x[i],
+                          row.y[i] + 10, prev.x[i], prev.y[i] + 10, color);
+  }
+}
+
+static void benchFillFrame(bool covered, FillResult& r) {
+  beginFrame();
+  beginRaster(covered);
+  const int rows = benchFrame.grid.rows();
+  double t0 = benchNow();
+  if (covered) {
+    for (int i = 1; i < rows; i++) drawSolidStrip(benchFrame.grid.row(i - 1), benchFrame.grid.row(i));
+  } else {
+    for (int i = rows - 1; i >= 1; i--) benchPaintStrip(benchFrame.grid.row(i - 1), benchFrame.grid.row(i));
+  }
+  double t = benchNow() - t0;
+  (covered ? r.coveredSeconds : r.painterSeconds) += t;
+  (covered ? r.coveredWrites : r.painterWrites) += solidCoverage.written;
+}
+
+static FillResult benchFillMode(int wave) {
+  static std::vector<uint16_t> covered;
+  FillResult r;
+  for (int cols : fillBenchCols) {
+    if (cols > GRID_MAX_COLS) continue;
+    benchSelect(wave, DISPLAY_SOLID, cols);
+    nativeHal().audioSample = 0;
+    for (int n = 0; n < FILL_BENCH_ANGLES * FILL_BENCH_FRAME_GAP; n++) {
+      benchSensors(n);
+      if (n % FILL_BENCH_FRAME_GAP) continue;
+      simClock.begin(1000000 / HECTOR_SIM_HZ);
+      simK = n * speed;
+      computeFrame(benchFrame);
+      if (!benchFrame.frontToBack) {
+        r.skipped++;
+        continue;
+      }
+      const FrameBuffer& fb = frameBuffers[backBuffer];
+      const int count = fb.width * fb.height;
+      benchFillFrame(true, r);
+      covered.assign(fb.pixels, fb.pixels + count);
+      benchFillFrame(false, r);
+      for (int i = 0; i < count; i++) {
+        r.pixels += fb.pixels[i] != 0;
+        r.differ += covered[i] != fb.pixels[i];
+        r.holes += covered[i] == 0 && fb.pixels[i] != 0;
+      }
+      r.frames++;
+    }
+  }
+  return r;
+}
+
+static int benchFill(const BenchOptions& opt) {
+  printf("%-10s %7s %9s %10s %10s %8s %6s %9s %9s %9s %9s\n", "wave", "frames", "pixels", "cov writes",
+         "paint wr.", "differ", "holes", "cov us", "paint us", "cov Mpx/s", "paint Mpx/s");
+  int failures = 0;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    FillResult r = benchFillMode(w);
+    if (!r.frames) {
+      printf("%-10s %7d (every angle yawed past 45 degrees)\n", benchWaveNames[w], 0);
+      continue;
+    }
+    const double differ = r.pixels ? 100.0 * r.differ / r.pixels : 0;
+    const bool failed = r.holes || differ > 1.0;
+    failures += failed;
+    printf("%-10s %7ld %9.0f %10.0f %10.0f %7.2f%% %6ld %9.1f %9.1f %9.0f %9.0f%s\n", benchWaveNames[w], r.frames,
+           r.pixels / r.frames, r.coveredWrites / r.frames, r.painterWrites / r.frames, differ, r.holes,
+           r.coveredSeconds * 1e6 / r.frames, r.painterSeconds * 1e6 / r.frames,
+           r.coveredWrites / r.coveredSeconds * 1e-6, r.painterWrites / r.painterSeconds * 1e-6,
+           failed ? "  FAIL" : "");
+  }
+  printf("per frame; differ: of the reference's pixels, at most 1%%, with no holes\n%s\n",
+         failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --lines: GRID and ZEBRA at 31 columns over 40 frames per mode, through
+// drawLineStrip() and through a reference that clips every segment and
+// draws it whole with fbDrawLine(), vertex by vertex in the same order.
+// The pixels must match. The panel pass counts write transactions; the
+// per-vertex lines took one per line.
+#define LINE_BENCH_COLS 31
+#define LINE_BENCH_FRAMES 40
+
+struct LineResult {
+  double segments = 0, pixels = 0, transactions = 0;
+  double refSegments = 0, refPixels = 0;
+  long differ = 0;
+};
+
+static void benchLineSegment(FrameBuffer& fb, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t color,
+                             LineResult& r) {
+  if (!fbClipLine(surfaceViewport, x0, y0, x1, y1)) return;
+  fbDrawLine(fb, x0, y0, x1, y1, color);
+  const int32_t dx = x1 > x0 ? x1 - x0 : x0 - x1, dy = y1 > y0 ? y1 - y0 : y0 - y1;
+  r.refSegments++;
+  r.refPixels += (dx > dy ? dx : dy) + 1;
+}
+
+static void benchLineReference(const GridRow& prev, const GridRow& row, int scan_y, bool zebra, LineResult& r) {
+  FrameBuffer& fb = frameBuffers[backBuffer];
+  for (int i = 1; i < row.cols; i++) {
+    if (zebra && scan_y % 2 != i % 2) continue;
+    if (!row.isValid(i) || row.color[i] == 0) continue;
+    if (row.isValid(i - 1)) {
+      benchLineSegment(fb, row.x[i - 1], row.y[i - 1] + 10, row.x[i], row.y[i] + 10, row.color[i], r);
+    }
+    if (prev.isValid(i)) {
+      benchLineSegment(fb, prev.x[i], prev.y[i] + 10, row.x[i], row.y[i] + 10, row.color[i], r);
+    }
+  }
+}
+
+static LineResult benchLineMode(int wave, int display) {
+  static std::vector<uint16_t> drawn;
+  const bool zebra = display == DISPLAY_ZEBRA;
+  LineResult r;
+  benchSelect(wave, display, LINE_BENCH_COLS);
+  nativeHal().audioSample = 0;
+  for (int n = 0; n < LINE_BENCH_FRAMES; n++) {
+    benchSensors(n);
+    simClock.begin(1000000 / HECTOR_SIM_HZ);
+    simK = n * speed;
+    computeFrame(benchFrame);
+    const int rows = benchFrame.grid.rows();
+    const FrameBuffer& fb = frameBuffers[backBuffer];
+    const int count = fb.width * fb.height;
+
+    lineStats = LineStats();
+    beginFrame();
+    beginRaster(benchFrame.frontToBack);
+    for (int i = 1; i < rows; i++) drawLineStrip(benchFrame.grid.row(i - 1), benchFrame.grid.row(i), i, zebra);
+    r.segments += lineStats.segments;
+    r.pixels += lineStats.pixels;
+    drawn.assign(fb.pixels, fb.pixels + count);
+
+    beginFrame();
+    beginRaster(benchFrame.frontToBack);
+    for (int i = 1; i < rows; i++) benchLineReference(benchFrame.grid.row(i - 1), benchFrame.grid.row(i), i, zebra, r);
+    for (int i = 0; i < count; i++) r.differ += drawn[i] != fb.pixels[i];
+
+    // Straight to the panel (the stub draws nothing)
+    lineStats = LineStats();
+    useFramebuffer = false;
+    beginRaster(benchFrame.frontToBack);
+    for (int i = 1; i < rows; i++) drawLineStrip(benchFrame.grid.row(i - 1), benchFrame.grid.row(i), i, zebra);
+    useFramebuffer = true;
+    r.transactions += lineStats.transactions;
+  }
+  return r;
+}
+
+static int benchLines(const BenchOptions& opt) {
+  printf("%-16s %9s %9s %9s %9s %8s %9s %9s\n", "mode", "ref segs", "segments", "ref px", "pixels", "differ",
+         "ref txns", "txns");
+  int failures = 0;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    for (int d : { (int)DISPLAY_GRID, (int)DISPLAY_ZEBRA }) {
+      LineResult r = benchLineMode(w, d);
+      const double frames = LINE_BENCH_FRAMES;
+      const bool failed = r.differ != 0;
+      failures += failed;
+      std::string mode = std::string(benchWaveNames[w]) + "/" + benchDisplayNames[d];
+      printf("%-16s %9.0f %9.0f %9.0f %9.0f %8ld %9.0f %9.0f%s\n", mode.c_str(), r.refSegments / frames,
+             r.segments / frames, r.refPixels / frames, r.pixels / frames, r.differ, r.refSegments / frames,
+             r.transactions / frames, failed ? "  FAIL" : "");
+    }
+  }
+  printf("per frame at %d columns; differ: pixels over %d frames, must be 0\n%s\n", LINE_BENCH_COLS,
+         LINE_BENCH_FRAMES, failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --shading: every mode at 9, 16, 31 and 48 columns over 60 frames, each
+// row's heights shaded through PaletteTables::shadeRow() for every palette
+// and per vertex without the tables. CLASSIC is checked against the code
+// computeRow() ran before palette.h, kept here as it was; the others
+// against their PaletteSpec functions. Every color must match.
+#define SHADING_BENCH_FRAMES 60
+static const int shadingBenchCols[] = { 9, 16, 31, 48 };
+
+struct ShadingResult {
+  long vertices = 0;
+  long mismatches[PALETTE_COUNT] = {};
+  float zMin = 0, zMax = 0;
+  double oldNs = 0, tableNs = 0;  // CLASSIC, per vertex
+};
+
+// The per-vertex shading of the renderer before palette.h
+static void benchShadeOld(float x, const float* ys, const float* zs, int cols, float half, uint16_t* out) {
+  uint8_t maxrangecolor = 255, minrangecolor = 0;
+  uint8_t green, red, blue;
+  blue = map(x, -half, half, minrangecolor, maxrangecolor);
+  for (int j = 0; j < cols; j++) {
+    const float y = ys[j], z = zs[j];
+    green = map(y, -half, half, minrangecolor, maxrangecolor);
+    float brightnessfactor = float(map(int(z), -50, 50, 100, 20)) / 100.0;
+    red = maxrangecolor - (green - minrangecolor);
+    green *= brightnessfactor;
+    red *= brightnessfactor;
+    blue *= brightnessfactor;
+    out[j] = M5.Display.color565(red, green, blue);
+  }
+}
+
+// A non-compound palette evaluated per vertex
+static uint16_t benchShadeSpec(const PaletteSpec& spec, float x, float y, float z, float half) {
+  const PaletteRgb a = spec.row(x, half), b = spec.col(y, half);
+  const float f = spec.brightness((int)z);
+  const int r = std::min(a.r + b.r, 255), g = std::min(a.g + b.g, 255), bl = std::min(a.b + b.b, 255);
+  return M5.Display.color565((uint8_t)(int32_t)(r * f), (uint8_t)(int32_t)(g * f), (uint8_t)(int32_t)(bl * f));
+}
+
+static ShadingResult benchShadingMode(int wave) {
+  static float z[GRID_MAX_ROWS][GRID_MAX_COLS];
+  static uint16_t table[GRID_MAX_ROWS][GRID_MAX_COLS], ref[GRID_MAX_ROWS][GRID_MAX_COLS];
+  const SurfaceCache& c = surfaceCache;
+  const PaletteId selected = paletteId;
+  ShadingResult r;
+  r.zMin = FLT_MAX;
+  r.zMax = -FLT_MAX;
+  double oldTotal = 0, tableTotal = 0;
+  for (int cols : shadingBenchCols) {
+    if (cols > GRID_MAX_COLS) continue;
+    benchSelect(wave, DISPLAY_GRID, cols);
+    nativeHal().audioSample = 0;
+    for (int n = 0; n < SHADING_BENCH_FRAMES; n++) {
+      benchSensors(n);
+      simClock.begin(1000000 / HECTOR_SIM_HZ);
+      simK = n * speed;
+      for (int p = 0; p < PALETTE_COUNT; p++) {
+        paletteId = (PaletteId)p;
+        const ComputeState state = beginCompute();
+        const PaletteSpec& spec = paletteSpecs[p];
+        // Heights as computeRow() takes them
+        for (int i = 0; i < c.rows; i++) {
+          if (state.cached) {
+            state.mode->row(c, i, k, z[i]);
+          } else {
+            for (int j = 0; j < c.cols; j++) z[i][j] = state.surface(c.x[i], c.y[j], k);
+          }
+        }
+        double t0 = benchNow();
+        for (int i = 0; i < c.rows; i++) palette.shadeRow(i, z[i], table[i], c.cols);
+        double t1 = benchNow();
+        if (p == PALETTE_CLASSIC) {
+          for (int i = 0; i < c.rows; i++) benchShadeOld(c.x[i], c.y, z[i], c.cols, c.half, ref[i]);
+          oldTotal += benchNow() - t1;
+          tableTotal += t1 - t0;
+        } else {
+          for (int i = 0; i < c.rows; i++) {
+            for (int j = 0; j < c.cols; j++) ref[i][j] = benchShadeSpec(spec, c.x[i], c.y[j], z[i][j], c.half);
+          }
+        }
+        for (int i = 0; i < c.rows; i++) {
+          for (int j = 0; j < c.cols; j++) {
+            r.mismatches[p] += table[i][j] != ref[i][j];
+            if (p) continue;
+            r.vertices++;
+            r.zMin = std::min(r.zMin, z[i][j]);
+            r.zMax = std::max(r.zMax, z[i][j]);
+          }
+        }
+      }
+    }
+  }
+  paletteId = selected;
+  r.oldNs = oldTotal * 1e9 / r.vertices;
+  r.tableNs = tableTotal * 1e9 / r.vertices;
+  return r;
+}
+
+static int benchShading(const BenchOptions& opt) {
+  printf("%-10s %9s %8s %8s", "wave", "vertices", "z min", "z max");
+  for (int p = 0; p < PALETTE_COUNT; p++) printf(" %8s", paletteSpecs[p].name);
+  printf(" %8s %8s\n", "old ns", "table ns");
+  int failures = 0;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    ShadingResult r = benchShadingMode(w);
+    bool failed = false;
+    printf("%-10s %9ld %8.1f %8.1f", benchWaveNames[w], r.vertices, r.zMin, r.zMax);
+    for (int p = 0; p < PALETTE_COUNT; p++) {
+      printf(" %8ld", r.mismatches[p]);
+      failed |= r.mismatches[p] != 0;
+    }
+    failures += failed;
+    printf(" %8.2f %8.2f%s\n", r.oldNs, r.tableNs, failed ? "  FAIL" : "");
+  }
+  printf("colors differing per palette, must be 0; ns per vertex for CLASSIC\n%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --density: the vertex rows at grids of 30, 60 and 120 steps, kept for a
+// whole frame (the pipeline's HectorFrame) against streamed through the
+// two-row RowWindow (single core). Both run every frame from the same
+// sensors and must draw the same pixels; the bytes are the vertex
+// storage each needs.
+static const int densityBenchSizes[] = { 30, 60, 120 };
+
+static size_t benchRowBytes(int rows, int cols) {
+  return (size_t)rows * cols * (3 * sizeof(int16_t) + sizeof(uint16_t)) + (size_t)rows * ((cols + 31) >> 5) * sizeof(uint32_t);
+}
+
+static int benchDensity(const BenchOptions& opt) {
+  const int wave = opt.wave >= 0 ? opt.wave : RIPPLE_TANK;
+  static std::vector<uint16_t> kept;
+  if (opt.images && !benchMakeDir(opt.images)) {
+    fprintf(stderr, "cannot create %s: %s\n", opt.images, strerror(errno));
+    return 1;
+  }
+
+  if (opt.csv) printf("wave,display,cols,rows,frames,frame_ms,stream_ms,frame_bytes,window_bytes,frames_differ\n");
+  else printf("%-16s %7s %10s %10s %10s %10s %7s\n", "mode", "grid", "frame ms", "stream ms", "frame KB", "window KB", "differ");
+  int failures = 0;
+  for (int size : densityBenchSizes) {
+    if (size + 1 > GRID_MAX_COLS || !VertexArena<GRID_ARENA_VERTICES, GRID_MAX_ROWS>::fits(size + 1, size + 1)) {
+      printf("%d steps need GRID_MAX_COLS=%d GRID_ARENA_VERTICES=%d\n", size, size + 1, (size + 1) * (size + 1));
+      failures++;
+      continue;
+    }
+    for (int d = 0; d < BENCH_DISPLAY_COUNT; d++) {
+      if (opt.display >= 0 && d != opt.display) continue;
+      benchSelect(wave, d, size + 1);
+      nativeHal().audioSample = 0;
+      double frameTotal = 0, streamTotal = 0;
+      int differ = 0;
+      for (int n = 0; n < BENCH_WARMUP_FRAMES + opt.frames; n++) {
+        benchSensors(n);
+        simClock.begin(1000000 / HECTOR_SIM_HZ);
+        simK = n * speed;
+        const int keptBuffer = backBuffer;
+        double t0 = benchNow();
+        computeFrame(benchFrame);
+        renderFrame(benchFrame);
+        double t1 = benchNow();
+        const FrameBuffer& a = frameBuffers[keptBuffer];
+        kept.assign(a.pixels, a.pixels + a.width * a.height);
+
+        simClock.begin(1000000 / HECTOR_SIM_HZ);
+        simK = n * speed;
+        const int streamBuffer = backBuffer;
+        double t2 = benchNow();
+        streamFrame();
+        double t3 = benchNow();
+        const FrameBuffer& b = frameBuffers[streamBuffer];
+        differ += memcmp(kept.data(), b.pixels, kept.size() * sizeof(uint16_t)) != 0;
+        if (n < BENCH_WARMUP_FRAMES) continue;
+        frameTotal += t1 - t0;
+        streamTotal += t3 - t2;
+      }
+      const int rows = surfaceCache.rows, cols = surfaceCache.cols;
+      failures += differ > 0;
+      if (opt.csv) {
+        printf("%s,%s,%d,%d,%d,%.3f,%.3f,%zu,%zu,%d\n", benchWaveNames[wave], benchDisplayNames[d], cols, rows,
+               opt.frames, frameTotal * 1e3 / opt.frames, streamTotal * 1e3 / opt.frames, benchRowBytes(rows, cols),
+               benchRowBytes(2, cols), differ);
+      } else {
+        std::string mode = std::string(benchWaveNames[wave]) + "/" + benchDisplayNames[d];
+        printf("%-16s %3dx%-3d %10.3f %10.3f %10.1f %10.2f %7d%s\n", mode.c_str(), cols, rows,
+               frameTotal * 1e3 / opt.frames, streamTotal * 1e3 / opt.frames, benchRowBytes(rows, cols) / 1024.0,
+               benchRowBytes(2, cols) / 1024.0, differ, differ ? "  FAIL" : "");
+      }
+      fflush(stdout);
+    }
+  }
+  if (!opt.csv) printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --exchange: FrameExchange and SeqLock between two real threads. The
+// producer numbers its frames and fills each with a pattern derived from
+// the number; the consumer checks that the numbers arrive one by one with
+// none dropped, repeated or reordered, and that no frame is torn. A
+// SeqLock writer stores a struct whose fields all hold the same count
+// while a reader checks every load for mixed fields and going backwards.
+#define EXCHANGE_BENCH_FRAMES 200000
+#define EXCHANGE_BENCH_WORDS 64
+#define EXCHANGE_BENCH_STORES 200000
+#define EXCHANGE_BENCH_STORE_GAP_US 2  // a store every few us; back to back, no read gets between them
+
+struct ExchangeBenchFrame {
+  uint32_t seq;
+  uint32_t words[EXCHANGE_BENCH_WORDS];
+};
+
+struct SeqLockBenchValue {
+  uint32_t count;
+  uint32_t copies[15];
+};
+
+static int benchExchange() {
+  static FrameExchange<ExchangeBenchFrame> exchange;
+  std::thread producer([] {
+    for (uint32_t n = 1; n <= EXCHANGE_BENCH_FRAMES; n++) {
+      ExchangeBenchFrame* f;
+      while (!(f = exchange.acquireWrite())) std::this_thread::yield();
+      f->seq = n;
+      for (int i = 0; i < EXCHANGE_BENCH_WORDS; i++) f->words[i] = n * 2654435761u + i;
+      exchange.publish(f);
+    }
+  });
+  uint32_t expected = 1;
+  long reordered = 0, torn = 0, empty = 0;
+  double t0 = benchNow();
+  while (expected <= EXCHANGE_BENCH_FRAMES) {
+    ExchangeBenchFrame* f = exchange.acquireRead();
+    if (!f) {
+      empty++;
+      std::this_thread::yield();
+      continue;
+    }
+    if (f->seq != expected) reordered++;
+    for (int i = 0; i < EXCHANGE_BENCH_WORDS; i++) {
+      if (f->words[i] != f->seq * 2654435761u + i) {
+        torn++;
+        break;
+      }
+    }
+    expected = f->seq + 1;
+    exchange.release(f);
+  }
+  double frameSeconds = benchNow() - t0;
+  producer.join();
+  printf("FrameExchange: %d frames in %.2f s, %ld out of sequence, %ld torn, %ld polls found none\n",
+         EXCHANGE_BENCH_FRAMES, frameSeconds, reordered, torn, empty);
+
+  static SeqLock<SeqLockBenchValue> published;
+  static std::atomic<bool> writing{true};
+  std::thread writer([] {
+    SeqLockBenchValue v;
+    for (uint32_t n = 1; n <= EXCHANGE_BENCH_STORES; n++) {
+      v.count = n;
+      for (int i = 0; i < 15; i++) v.copies[i] = n;
+      published.store(v);
+      const double until = benchNow() + EXCHANGE_BENCH_STORE_GAP_US * 1e-6;
+      while (benchNow() < until) {
+      }
+    }
+    writing.store(false);
+  });
+  while (!published.version()) std::this_thread::yield();
+  long loads = 0, mixed = 0, backwards = 0, changes = 0;
+  uint32_t last = 0;
+  while (writing.load()) {
+    SeqLockBenchValue v = published.load();
+    loads++;
+    for (int i = 0; i < 15; i++) {
+      if (v.copies[i] != v.count) {
+        mixed++;
+        break;
+      }
+    }
+    if (v.count < last) backwards++;
+    changes += v.count != last;
+    last = v.count;
+  }
+  writer.join();
+  bool versionOk = published.version() == EXCHANGE_BENCH_STORES && published.load().count == EXCHANGE_BENCH_STORES;
+  printf("SeqLock: %d stores, %ld loads saw %ld values, %ld mixed, %ld going back, version %s\n",
+         EXCHANGE_BENCH_STORES, loads, changes, mixed, backwards, versionOk ? "ok" : "wrong");
+
+  bool failed = reordered || torn || mixed || backwards || !versionOk || changes < 2;
+  printf("%s\n", failed ? "FAILED" : "ok");
+  return failed ? 1 : 0;
+}
+
+// --raster: the framebuffer primitives on a small frame, against golden
+// frames ('#' drawn, '.' clear). Each case also draws past the edges, and
+// guard words around the frame must stay untouched.
+#define RASTER_BENCH_W 16
+#define RASTER_BENCH_H 10
+#define RASTER_BENCH_GUARD 64
+
+struct RasterGolden {
+  const char* what;
+  void (*draw)(FrameBuffer& fb);
+  const char* rows[RASTER_BENCH_H];
+};
+
+static const RasterGolden rasterGoldens[] = {
+  { "fbSpan: order, clipping, off rows",
+    [](FrameBuffer& fb) {
+      const uint16_t c = fbSwap565(0xF800);
+      fbSpan(fb, 2, 9, 1, c);
+      fbSpan(fb, 12, 5, 3, c);
+      fbSpan(fb, -4, 3, 5, c);
+      fbSpan(fb, 13, 40, 7, c);
+      fbSpan(fb, 0, 15, -1, c);
+      fbSpan(fb, 0, 15, 10, c);
+      fbSpan(fb, -9, -1, 9, c);
+      fbSpan(fb, 7, 7, 9, c);
+    },
+    {
+      "................",
+      "..########......",
+      "................",
+      ".....########...",
+      "................",
+      "####............",
+      "................",
+      ".............###",
+      "................",
+      ".......#........" } },
+  { "fbDrawLine: flat, shallow, steep, clipped",
+    [](FrameBuffer& fb) {
+      fbDrawLine(fb, 0, 0, 15, 0, 0xF800);
+      fbDrawLine(fb, 0, 2, 15, 9, 0xF800);
+      fbDrawLine(fb, 14, 1, 11, 9, 0xF800);
+      fbDrawLine(fb, -3, 9, 5, 1, 0xF800);
+    },
+    {
+      "################",
+      ".....#........#.",
+      "##..#.........#.",
+      "..##.........#..",
+      "..#.##.......#..",
+      ".#....##....#...",
+      "#.......##..#...",
+      "..........###...",
+      "...........###..",
+      "...........#..##" } },
+  { "fbDrawLine: point, through, off both ends",
+    [](FrameBuffer& fb) {
+      fbDrawLine(fb, 3, 3, 3, 3, 0xF800);
+      fbDrawLine(fb, 20, -5, -5, 20, 0xF800);
+      fbDrawLine(fb, 8, 12, 12, -2, 0xF800);
+    },
+    {
+      "...........#...#",
+      "...........#..#.",
+      "...........#.#..",
+      "...#.......##...",
+      "..........##....",
+      "..........#.....",
+      ".........##.....",
+      "........##......",
+      ".......#.#......",
+      "......#..#......" } },
+  { "fbFillTriangle: flat top, flat bottom",
+    [](FrameBuffer& fb) {
+      fbFillTriangle(fb, 1, 1, 7, 1, 4, 7, 0xF800);
+      fbFillTriangle(fb, 12, 2, 9, 8, 15, 8, 0xF800);
+    },
+    {
+      "................",
+      ".#######........",
+      ".#######....#...",
+      "..#####.....#...",
+      "..#####....###..",
+      "...###.....###..",
+      "...###....#####.",
+      "....#.....#####.",
+      ".........#######",
+      "................" } },
+  { "fbFillTriangle: general",
+    [](FrameBuffer& fb) { fbFillTriangle(fb, 2, 0, 14, 4, 5, 9, 0xF800); },
+    {
+      "..#.............",
+      "..####..........",
+      "..#######.......",
+      "...#########....",
+      "...############.",
+      "...###########..",
+      "....########....",
+      "....######......",
+      "....####........",
+      ".....#.........." } },
+  { "fbFillTriangle: clipped, degenerate",
+    [](FrameBuffer& fb) {
+      fbFillTriangle(fb, -6, -2, 10, 3, -2, 14, 0xF800);
+      fbFillTriangle(fb, 11, 5, 15, 5, 13, 5, 0xF800);
+      fbFillTriangle(fb, 14, 0, 14, 3, 14, 1, 0xF800);
+    },
+    {
+      "#.............#.",
+      "####..........#.",
+      "#######.......#.",
+      "###########...#.",
+      "##########......",
+      "#########..#####",
+      "########........",
+      "#######.........",
+      "######..........",
+      "#####..........." } },
+};
+
+static int benchRaster() {
+  static uint16_t memory[RASTER_BENCH_GUARD + RASTER_BENCH_W * RASTER_BENCH_H + RASTER_BENCH_GUARD];
+  const uint16_t guard = 0x5A5A, drawn = fbSwap565(0xF800);
+  int failures = 0;
+  for (size_t g = 0; g < sizeof(rasterGoldens) / sizeof(rasterGoldens[0]); g++) {
+    const RasterGolden& golden = rasterGoldens[g];
+    for (size_t i = 0; i < sizeof(memory) / sizeof(memory[0]); i++) memory[i] = guard;
+    FrameBuffer fb;
+    fb.pixels = memory + RASTER_BENCH_GUARD;
+    fb.width = RASTER_BENCH_W;
+    fb.height = RASTER_BENCH_H;
+    fbClear(fb, 0);
+    golden.draw(fb);
+
+    int wrong = 0, guards = 0;
+    for (int y = 0; y < RASTER_BENCH_H; y++) {
+      for (int x = 0; x < RASTER_BENCH_W; x++) {
+        wrong += fb.pixels[y * RASTER_BENCH_W + x] != (golden.rows[y][x] == '#' ? drawn : 0);
+      }
+    }
+    for (int i = 0; i < RASTER_BENCH_GUARD; i++) {
+      guards += memory[i] != guard;
+      guards += fb.pixels[RASTER_BENCH_W * RASTER_BENCH_H + i] != guard;
+    }
+    const bool failed = wrong || guards;
+    failures += failed;
+    printf("%-44s %3d pixels wrong, %d guard words hit%s\n", golden.what, wrong, guards, failed ? "  FAIL" : "");
+    if (!failed) continue;
+    for (int y = 0; y < RASTER_BENCH_H; y++) {
+      printf("  %s  ", golden.rows[y]);
+      for (int x = 0; x < RASTER_BENCH_W; x++) putchar(fb.pixels[y * RASTER_BENCH_W + x] ? '#' : '.');
+      putchar('\n');
+    }
+  }
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --rommath: each ROM function against libm double over the range the
+// surfaces call it with. A sweep of evenly spaced (or log spaced) inputs
+// gives the largest error, which must stay inside the bound rom_math.h
+// states; a fixed block of the same inputs times it against libm, and a
+// function slower than the libm float call fails.
+#define ROM_BENCH_POINTS (1 << 20)
+#define ROM_BENCH_BLOCK 4096
+#define ROM_BENCH_PASSES 128
+#define ROM_BENCH_ROUNDS 6
+// sqrtf and float division are one instruction on the host's FPU but
+// software on the ESP32's; the ROM versions of those may take up to this
+// many times the libm float call on the host, and fail beyond
+#define ROM_BENCH_FPU_SLACK 4.0
+
+// Every path is a lambda, so each is inlined into its own timing loop
+// rather than called through a shared function pointer
+#define ROM_BENCH_FN(In, f) [](In x) { return f(x); }
+
+struct RomBenchRange {
+  const char* what;
+  double lo, hi;
+  bool logSpaced;
+  double bound;
+  bool relative;
+  bool fpuOp;  // the libm float call is one host FPU instruction
+};
+
+template <typename In> static In benchRomInput(double v);
+template <> float benchRomInput<float>(double v) { return (float)v; }
+template <> q16_t benchRomInput<q16_t>(double v) { return (q16_t)llround(v * 65536.0); }
+template <> uint32_t benchRomInput<uint32_t>(double v) { return (uint32_t)llround(v); }
+
+static double benchRomValue(float v) { return v; }
+static double benchRomValue(q16_t v) { return v / 65536.0; }
+static double benchRomValue(uint32_t v) { return v; }
+
+static double benchRomPoint(const RomBenchRange& r, int i, int count) {
+  double t = (double)i / (count - 1);
+  return r.logSpaced ? r.lo * pow(r.hi / r.lo, t) : r.lo + (r.hi - r.lo) * t;
+}
+
+// ns per call of f over the block, results stored so none is dropped. The
+// barrier keeps the loop from being vectorized: one call at a time, as on
+// the device.
+template <typename In, typename F>
+static double benchRomTime(const In* in, F f) {
+  static double out[ROM_BENCH_BLOCK];
+  double t0 = benchNow();
+  for (int pass = 0; pass < ROM_BENCH_PASSES; pass++) {
+    for (int i = 0; i < ROM_BENCH_BLOCK; i++) {
+      out[i] = (double)f(in[i]);
+      __asm__ __volatile__("" ::: "memory");
+    }
+  }
+  double t = benchNow() - t0;
+  volatile double sink = out[ROM_BENCH_BLOCK / 2];
+  (void)sink;
+  return t * 1e9 / ((double)ROM_BENCH_PASSES * ROM_BENCH_BLOCK);
+}
+
+// rom and the libm calls take In; ref takes the input's exact value.
+// slack is allowed on top of the bound in result units (romRecipU32's LSB).
+template <typename In, typename Rom, typename LibF, typename LibD, typename Ref>
+static bool benchRomCase(const RomBenchRange& r, Rom rom, LibF libF, LibD libD, Ref ref, double slack = 0) {
+  double maxError = 0, worstX = 0;
+  for (int i = 0; i < ROM_BENCH_POINTS; i++) {
+    In x = benchRomInput<In>(benchRomPoint(r, i, ROM_BENCH_POINTS));
+    double exact = ref(x);
+    double err = fabs(benchRomValue(rom(x)) - exact) - slack;
+    if (r.relative) err /= fabs(exact);
+    if (err > maxError) {
+      maxError = err;
+      worstX = benchRomValue(x);
+    }
+  }
+  // Best of several rounds, the ROM and libm float calls taking turns to go first
+  static In block[ROM_BENCH_BLOCK];
+  for (int i = 0; i < ROM_BENCH_BLOCK; i++) block[i] = benchRomInput<In>(benchRomPoint(r, i, ROM_BENCH_BLOCK));
+  double romNs = 1e9, floatNs = 1e9, doubleNs = 1e9;
+  for (int round = 0; round < ROM_BENCH_ROUNDS; round++) {
+    if (round & 1) floatNs = std::min(floatNs, benchRomTime(block, libF));
+    romNs = std::min(romNs, benchRomTime(block, rom));
+    if (!(round & 1)) floatNs = std::min(floatNs, benchRomTime(block, libF));
+    doubleNs = std::min(doubleNs, benchRomTime(block, libD));
+  }
+
+  bool inaccurate = maxError > r.bound, slow = romNs > floatNs * (r.fpuOp ? ROM_BENCH_FPU_SLACK : 1);
+  printf("%-28s %4s %10.3g %10.3g %12.4g %8.2f %8.2f%s %8.2f%s\n", r.what, r.relative ? "rel" : "abs", maxError,
+         r.bound, worstX, romNs, floatNs, r.fpuOp ? "*" : " ", doubleNs,
+         inaccurate ? "  FAIL" : slow ? "  FAIL: slower than libm f" : "");
+  return !inaccurate && !slow;
+}
+
+static int benchRomMath() {
+  romMathInit();
+  printf("%-28s %4s %10s %10s %12s %8s %8s  %8s\n", "function (range)", "err", "max", "bound", "worst x",
+         "rom ns", "libm f", "libm d");
+  int failures = 0;
+  // Bounds as stated in the rom_math.h header
+  const RomBenchRange sin16 = { "romSinF (|x| < 16)", -16, 16, false, 5e-6, false, false };
+  const RomBenchRange sin128 = { "romSinF (|x| < 128)", -128, 128, false, 1.2e-5, false, false };
+  const RomBenchRange cos16 = { "romCosF (|x| < 16)", -16, 16, false, 5e-6, false, false };
+  const RomBenchRange cos128 = { "romCosF (|x| < 128)", -128, 128, false, 1.2e-5, false, false };
+  const RomBenchRange invSqrt = { "romInvSqrtF (1e-6..1e6)", 1e-6, 1e6, true, 5e-6, true, true };
+  const RomBenchRange sqrtF = { "romSqrtF (1e-6..1e6)", 1e-6, 1e6, true, 5e-6, true, true };
+  const RomBenchRange logF = { "romLogF (1e-6..1e6)", 1e-6, 1e6, true, 9e-6, false, false };
+  const RomBenchRange logWide = { "romLogF (normal floats)", FLT_MIN, FLT_MAX, true, 1.6e-5, false, false };
+  const RomBenchRange sinQ = { "romSinQ16 (|x| < 256)", -255.99, 255.99, false, 3.5e-5, false, false };
+  const RomBenchRange cosQ = { "romCosQ16 (|x| < 256)", -255.99, 255.99, false, 3.5e-5, false, false };
+  const RomBenchRange sqrtQ = { "romSqrtQ16 (0..32767)", 0, 32767, false, 1.0 / 65536, false, true };
+  const RomBenchRange invSqrtQ = { "romInvSqrtQ16 (2^-16..32767)", 1.0 / 65536, 32767, true, 1.0 / 65536, false, true };
+  const RomBenchRange logQ = { "romLogQ16 (2^-16..32767)", 1.0 / 65536, 32767, true, 6e-5, false, false };
+  const RomBenchRange recip = { "romRecipU32 (4..2^32-1)", 4, 4294967295.0, true, 4e-6, true, true };
+
+  auto sinRef = [](float x) { return sin((double)x); };
+  auto cosRef = [](float x) { return cos((double)x); };
+  auto sinQRef = [](q16_t x) { return sin(x / 65536.0); };
+  auto cosQRef = [](q16_t x) { return cos(x / 65536.0); };
+  auto sqrtQRef = [](q16_t x) { return sqrt(x / 65536.0); };
+  auto invSqrtQRef = [](q16_t x) { return 1.0 / sqrt(x / 65536.0); };
+  auto logQRef = [](q16_t x) { return log(x / 65536.0); };
+  failures += !benchRomCase<float>(sin16, ROM_BENCH_FN(float, romSinF), ROM_BENCH_FN(float, sinf), sinRef, sinRef);
+  failures += !benchRomCase<float>(sin128, ROM_BENCH_FN(float, romSinF), ROM_BENCH_FN(float, sinf), sinRef, sinRef);
+  failures += !benchRomCase<float>(cos16, ROM_BENCH_FN(float, romCosF), ROM_BENCH_FN(float, cosf), cosRef, cosRef);
+  failures += !benchRomCase<float>(cos128, ROM_BENCH_FN(float, romCosF), ROM_BENCH_FN(float, cosf), cosRef, cosRef);
+  failures += !benchRomCase<float>(invSqrt, ROM_BENCH_FN(float, romInvSqrtF), [](float x) { return 1.0f / sqrtf(x); },
+                                   [](float x) { return 1.0 / sqrt((double)x); },
+                                   [](float x) { return 1.0 / sqrt((double)x); });
+  failures += !benchRomCase<float>(sqrtF, ROM_BENCH_FN(float, romSqrtF), ROM_BENCH_FN(float, sqrtf),
+                                   [](float x) { return sqrt((double)x); },
+                                   [](float x) { return sqrt((double)x); });
+  failures += !benchRomCase<float>(logF, ROM_BENCH_FN(float, romLogF), ROM_BENCH_FN(float, logf),
+                                   [](float x) { return log((double)x); },
+                                   [](float x) { return log((double)x); });
+  failures += !benchRomCase<float>(logWide, ROM_BENCH_FN(float, romLogF), ROM_BENCH_FN(float, logf),
+                                   [](float x) { return log((double)x); },
+                                   [](float x) { return log((double)x); });
+  // The Q16 libm calls convert in and out, as a Q16 caller would have to
+  failures += !benchRomCase<q16_t>(sinQ, ROM_BENCH_FN(q16_t, romSinQ16),
+                                   [](q16_t x) { return Q16_FROM_FLOAT(sinf(Q16_TO_FLOAT(x))); }, sinQRef, sinQRef);
+  failures += !benchRomCase<q16_t>(cosQ, ROM_BENCH_FN(q16_t, romCosQ16),
+                                   [](q16_t x) { return Q16_FROM_FLOAT(cosf(Q16_TO_FLOAT(x))); }, cosQRef, cosQRef);
+  failures += !benchRomCase<q16_t>(sqrtQ, ROM_BENCH_FN(q16_t, romSqrtQ16),
+                                   [](q16_t x) { return Q16_FROM_FLOAT(sqrtf(Q16_TO_FLOAT(x))); }, sqrtQRef, sqrtQRef);
+  failures += !benchRomCase<q16_t>(invSqrtQ, ROM_BENCH_FN(q16_t, romInvSqrtQ16),
+                                   [](q16_t x) { return Q16_FROM_FLOAT(1.0f / sqrtf(Q16_TO_FLOAT(x))); },
+                                   invSqrtQRef, invSqrtQRef);
+  failures += !benchRomCase<q16_t>(logQ, ROM_BENCH_FN(q16_t, romLogQ16),
+                                   [](q16_t x) { return Q16_FROM_FLOAT(logf(Q16_TO_FLOAT(x))); }, logQRef, logQRef);
+  failures += !benchRomCase<uint32_t>(recip, ROM_BENCH_FN(uint32_t, romRecipU32),
+                                      [](uint32_t d) { return (uint32_t)(4294967296.0f / d); },
+                                      [](uint32_t d) { return (uint32_t)(4294967296.0 / d); },
+                                      [](uint32_t d) { return 4294967296.0 / d; }, 1.0);
+  printf("libm f/d: the float and double libm call on the same inputs, best of %d rounds\n"
+         "*: one host FPU instruction, software on the ESP32; up to %.0fx allowed\n%s\n",
+         ROM_BENCH_ROUNDS, ROM_BENCH_FPU_SLACK, failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+// --scheduler: the scheduler on a mock clock. Sleeping advances the clock
+// by exactly the time asked, so every count below is exact.
+static uint32_t schedBenchUs = 0;
+static uint32_t schedBenchSlept = 0;
+static uint32_t schedBenchFast = 0, schedBenchSlow = 0;
+
+static uint32_t schedBenchNow() { return schedBenchUs; }
+
+static void schedBenchSleep(uint32_t us) {
+  schedBenchUs += us;
+  schedBenchSlept += us;
+}
+
+static void schedBenchFastJob() { schedBenchFast++; }
+static void schedBenchSlowJob() { schedBenchSlow++; }
+
+static bool benchSchedulerCheck(const char* what, bool ok, const char* detail) {
+  printf("%-28s %s%s\n", what, detail, ok ? "" : "  FAIL");
+  return ok;
+}
+
+static int benchFixedStep() {
+  int failures = 0;
+  char detail[96];
+  FixedStepClock clock;
+
+  // Irregular gaps: every whole step is taken, the rest carries over
+  static const uint32_t gaps[] = { 10000, 25000, 40000, 33333, 1, 70000, 16666, 16667, 5000, 99999 };
+  clock.begin(33333);
+  uint32_t now = 1000;
+  bool ok = clock.advance(now) == 0;
+  uint64_t elapsed = 0;
+  for (uint32_t gap : gaps) {
+    now += gap;
+    elapsed += gap;
+    clock.advance(now);
+    ok &= clock.steps() == elapsed / 33333 && fabsf(clock.alpha() - (float)(elapsed % 33333) / 33333) < 1e-6f;
+  }
+  snprintf(detail, sizeof(detail), "%lu steps in %llu us, alpha %.4f", (unsigned long)clock.steps(),
+           (unsigned long long)elapsed, clock.alpha());
+  failures += !benchSchedulerCheck("step: irregular gaps", ok, detail);
+
+  // 60 fps frames on a 30 Hz step: one step every other frame, no drift
+  clock.begin(33333);
+  now = 0;
+  clock.advance(now);
+  int ones = 0, others = 0;
+  for (int i = 1; i <= 6000; i++) {
+    now = (uint32_t)((uint64_t)i * 1000000 / 60);
+    const int steps = clock.advance(now);
+    ones += steps == 1;
+    others += steps > 1;
+  }
+  ok = clock.steps() == (uint64_t)now / 33333 && others == 0;
+  snprintf(detail, sizeof(detail), "%lu steps over 6000 frames (%d of one, %d of more)",
+           (unsigned long)clock.steps(), ones, others);
+  failures += !benchSchedulerCheck("step: 60 fps on 30 Hz", ok, detail);
+
+  // A stall takes at most maxSteps and drops the rest; the clock goes on
+  clock.begin(33333, 8);
+  clock.advance(0);
+  const int stalled = clock.advance(1000000);
+  const int after = clock.advance(1000000 + 33333);
+  ok = stalled == 8 && after == 1 && clock.steps() == 9 && clock.alpha() < 0.001f;
+  snprintf(detail, sizeof(detail), "1 s stall: %d steps, then %d", stalled, after);
+  failures += !benchSchedulerCheck("step: stall", ok, detail);
+
+  // Across the 32-bit wrap of the microsecond counter
+  clock.begin(33333);
+  now = 0xFFFFFFFFu - 50000;
+  clock.advance(now);
+  int wrapSteps = 0;
+  for (int i = 0; i < 10; i++) wrapSteps += clock.advance(now += 20000);
+  ok = wrapSteps == 200000 / 33333;
+  snprintf(detail, sizeof(detail), "%d steps over 200 ms across the wrap", wrapSteps);
+  failures += !benchSchedulerCheck("step: counter wrap", ok, detail);
+  return failures;
+}
+
+static int benchPeriodicJob() {
+  int failures = 0;
+  char detail[96];
+  uint32_t runs, misses, lateUs;
+  PeriodicJob job;
+
+  // Polled every 3 ms on a 10 ms period: late by up to 2 ms, never behind
+  schedBenchFast = 0;
+  job.begin("fast", schedBenchFastJob, 10000, 0);
+  for (uint32_t t = 0; t < 1000000; t += 3000) job.poll(t);
+  job.takeStats(runs, misses, lateUs);
+  bool ok = runs == 100 && misses == 0 && lateUs < 3000 && schedBenchFast == 100;
+  snprintf(detail, sizeof(detail), "%lu runs, %lu missed, %lu us late at worst", (unsigned long)runs,
+           (unsigned long)misses, (unsigned long)lateUs);
+  failures += !benchSchedulerCheck("job: polled every 3 ms", ok, detail);
+
+  // Late by less than a period: the next run keeps its slot
+  job.begin("fast", schedBenchFastJob, 10000, 0);
+  job.poll(9000);
+  ok = job.nextDue() == 10000;
+  job.takeStats(runs, misses, lateUs);
+  ok &= runs == 1 && misses == 0 && lateUs == 9000;
+  snprintf(detail, sizeof(detail), "9 ms late: next due at %lu us, %lu missed", (unsigned long)job.nextDue(),
+           (unsigned long)misses);
+  failures += !benchSchedulerCheck("job: late within a period", ok, detail);
+
+  // A 35 ms stall: one run, one miss, and the skipped periods are dropped
+  job.begin("fast", schedBenchFastJob, 10000, 0);
+  job.poll(0);
+  int ranInStall = job.poll(45000);
+  for (uint32_t t = 46000; t < 55000; t += 1000) ranInStall += job.poll(t);
+  ok = job.nextDue() == 55000;
+  job.takeStats(runs, misses, lateUs);
+  ok &= ranInStall == 1 && runs == 2 && misses == 1 && lateUs == 35000;
+  snprintf(detail, sizeof(detail), "35 ms late: %lu runs, %lu missed, next due at 55000 us", (unsigned long)runs,
+           (unsigned long)misses);
+  failures += !benchSchedulerCheck("job: stall", ok, detail);
+  return failures;
+}
+
+// One simulated second of loop(): waitForFrame(), and a frame costing
+// frameUs whenever it says so
+static void benchSchedulerRun(Scheduler<2>& sched, uint32_t frameUs, uint32_t& frames, uint32_t& minGap) {
+  frames = 0;
+  minGap = UINT32_MAX;
+  uint32_t lastStart = 0;
+  const uint32_t end = schedBenchUs + 1000000;
+  while (schedulerElapsed(end, schedBenchUs) > 0) {
+    if (!sched.waitForFrame()) continue;
+    if (frames && schedBenchUs - lastStart < minGap) minGap = schedBenchUs - lastStart;
+    lastStart = schedBenchUs;
+    frames++;
+    schedBenchUs += frameUs;
+  }
+}
+
+static int benchSchedulerPacing() {
+  int failures = 0;
+  char detail[160];
+  SchedulerClock clock;
+  clock.now = schedBenchNow;
+  clock.sleep = schedBenchSleep;
+  Scheduler<2> sched;
+  uint32_t frames, minGap, runs[2], misses[2], lateUs[2];
+
+  // Frames of 10 ms at 30 fps: every slot is met on the 33.3 ms grid, the
+  // 20 ms job keeps its period, the 5 ms job misses once behind each
+  // frame (the last frame's miss falls after the second), and the rest
+  // of the time is spent asleep
+  schedBenchUs = 5000;
+  schedBenchSlept = schedBenchFast = schedBenchSlow = 0;
+  sched.begin(clock, 30);
+  sched.addJob("fast", schedBenchFastJob, 5000);
+  sched.addJob("slow", schedBenchSlowJob, 20000);
+  benchSchedulerRun(sched, 10000, frames, minGap);
+  for (int i = 0; i < 2; i++) sched.job(i).takeStats(runs[i], misses[i], lateUs[i]);
+  uint32_t overruns = sched.frames().takeOverruns();
+  bool ok = frames == 31 && overruns == 0 && minGap == 33333 && misses[0] + 1 >= frames && misses[0] <= frames && runs[1] == 50 &&
+            misses[1] == 0 && schedBenchSlept >= 1000000 - frames * 10000;
+  snprintf(detail, sizeof(detail), "%lu frames %lu us apart, %lu late; jobs %lu/%lu runs, %lu/%lu missed; %lu ms asleep",
+           (unsigned long)frames, (unsigned long)minGap, (unsigned long)overruns, (unsigned long)runs[0],
+           (unsigned long)runs[1], (unsigned long)misses[0], (unsigned long)misses[1],
+           (unsigned long)(schedBenchSlept / 1000));
+  failures += !benchSchedulerCheck("scheduler: 10 ms frames", ok, detail);
+
+  // Frames of 50 ms at 30 fps: each starts as soon as the last ends, with
+  // no burst to catch up. One and a half periods long, every other start
+  // is a whole period late and resyncs the grid. The 5 ms job runs and
+  // misses once per frame.
+  schedBenchSlept = schedBenchFast = schedBenchSlow = 0;
+  sched.setFrameRate(30);
+  benchSchedulerRun(sched, 50000, frames, minGap);
+  for (int i = 0; i < 2; i++) sched.job(i).takeStats(runs[i], misses[i], lateUs[i]);
+  overruns = sched.frames().takeOverruns();
+  ok = frames == 20 && overruns + 1 >= frames / 2 && overruns <= frames / 2 && minGap == 50000 &&
+       runs[0] == frames && misses[0] == frames && lateUs[0] <= 50000 && schedBenchSlept == 0;
+  snprintf(detail, sizeof(detail), "%lu frames, %lu late, %lu us apart at least; 5 ms job %lu missed",
+           (unsigned long)frames, (unsigned long)overruns, (unsigned long)minGap, (unsigned long)misses[0]);
+  failures += !benchSchedulerCheck("scheduler: 50 ms frames", ok, detail);
+  return failures;
+}
+
+static int benchScheduler() {
+  const int failures = benchFixedStep() + benchPeriodicJob() + benchSchedulerPacing();
+  printf("%s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
+
+static void benchUsage() {
+  printf("usage: program [--frames N] [--wave NAME] [--display NAME] [--cols N]\n"
+         "               [--palette NAME] [--images DIR [--ppm]] [--csv]\n"
+         "               [--record FILE | --replay FILE]\n"
+         "       program --surfaces [--frames N] [--wave NAME] [--cols N] [--csv]\n"
+         "       program --formula [--frames N] [--wave INTER|RIPPLE] [--cols N] [--csv]\n"
+         "       program --power\n"
+         "       program --projection [--wave NAME]\n"
+         "       program --fill [--wave NAME]\n"
+         "       program --lines [--wave NAME]\n"
+         "       program --shading [--wave NAME]\n"
+         "       program --density [--frames N] [--wave NAME] [--display NAME] [--csv]\n"
+         "       program --fusion\n"
+         "       program --input\n"
+         "       program --hud\n"
+         "       program --exchange\n"
+         "       program --audio\n"
+         "       program --fft\n"
+         "       program --raster\n"
+         "       program --rommath\n"
+         "       program --scheduler\n"
+         "waves:");
+  for (int i = 0; i < WAVE_STYLE_COUNT; i++) printf(" %s", benchWaveNames[i]);
+  printf("\ndisplays:");
+  for (int i = 0; i < BENCH_DISPLAY_COUNT; i++) printf(" %s", benchDisplayNames[i]);
+  printf("\npalettes:");
+  for (int i = 0; i < PALETTE_COUNT; i++) printf(" %s", paletteSpecs[i].name);
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  BenchOptions opt;
+  const char* paletteNames[PALETTE_COUNT];
+  for (int i = 0; i < PALETTE_COUNT; i++) paletteNames[i] = paletteSpecs[i].name;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(arg, "--frames") && value) { opt.frames = atoi(value); i++; }
+    else if (!strcmp(arg, "--wave") && value) { opt.wave = benchFind(benchWaveNames, WAVE_STYLE_COUNT, value); i++; }
+    else if (!strcmp(arg, "--display") && value) { opt.display = benchFind(benchDisplayNames, BENCH_DISPLAY_COUNT, value); i++; }
+    else if (!strcmp(arg, "--cols") && value) { opt.cols = atoi(value); i++; }
+    else if (!strcmp(arg, "--palette") && value) { paletteId = (PaletteId)benchFind(paletteNames, PALETTE_COUNT, value); i++; }
+    else if (!strcmp(arg, "--images") && value) { opt.images = value; i++; }
+    else if (!strcmp(arg, "--record") && value) { opt.record = value; i++; }
+    else if (!strcmp(arg, "--replay") && value) { opt.replay = value; i++; }
+    else if (!strcmp(arg, "--ppm")) opt.ppm = true;
+    else if (!strcmp(arg, "--csv")) opt.csv = true;
+    else if (!strcmp(arg, "--surfaces")) opt.surfaces = true;
+    else if (!strcmp(arg, "--formula")) opt.formula = true;
+    else if (!strcmp(arg, "--power")) opt.power = true;
+    else if (!strcmp(arg, "--fusion")) opt.fusion = true;
+    else if (!strcmp(arg, "--input")) opt.input = true;
+    else if (!strcmp(arg, "--hud")) opt.hud = true;
+    else if (!strcmp(arg, "--exchange")) opt.exchange = true;
+    else if (!strcmp(arg, "--audio")) opt.audio = true;
+    else if (!strcmp(arg, "--fft")) opt.fft = true;
+    else if (!strcmp(arg, "--density")) opt.density = true;
+    else if (!strcmp(arg, "--projection")) opt.projection = true;
+    else if (!strcmp(arg, "--fill")) opt.fill = true;
+    else if (!strcmp(arg, "--lines")) opt.lines = true;
+    else if (!strcmp(arg, "--shading")) opt.shading = true;
+    else if (!strcmp(arg, "--raster")) opt.raster = true;
+    else if (!strcmp(arg, "--rommath")) opt.rommath = true;
+    else if (!strcmp(arg, "--scheduler")) opt.scheduler = true;
+    else { benchUsage(); return strcmp(arg, "--help") ? 2 : 0; }
+  }
+  if (opt.frames < 1) opt.frames = 1;
+  if (opt.cols && (opt.cols < 2 || opt.cols > GRID_MAX_COLS)) {
+    fprintf(stderr, "--cols must be 2..%d\n", GRID_MAX_COLS);
+    return 2;
+  }
+
+  if (opt.power) return benchPower();
+  if (opt.fusion) return benchFusion();
+  if (opt.input) return benchInput();
+  if (opt.hud) return benchHud();
+  if (opt.exchange) return benchExchange();
+  if (opt.audio) return benchAudio();
+  if (opt.fft) return benchFft();
+  if (opt.raster) return benchRaster();
+  if (opt.rommath) return benchRomMath();
+  if (opt.scheduler) return benchScheduler();
+
+  benchSetup();
+  traceClock = benchTraceClock;
+  if (opt.record && opt.replay) {
+    fprintf(stderr, "--record and --replay cannot be combined\n");
+    return 2;
+  }
+  if (opt.record) benchTraceOpen(opt.record, true);
+  if (opt.surfaces) return benchSurfaces(opt);
+  if (opt.formula) return benchFormulaModes(opt);
+  if (opt.density) return benchDensity(opt);
+  if (opt.projection) return benchProjection(opt);
+  if (opt.fill) return benchFill(opt);
+  if (opt.lines) return benchLines(opt);
+  if (opt.shading) return benchShading(opt);
+
+  if (opt.images && !benchMakeDir(opt.images)) {
+    fprintf(stderr, "cannot create %s: %s\n", opt.images, strerror(errno));
+    return 1;
+  }
+
+  if (opt.csv) printf("wave,display,cols,rows,frames,fps,vertices_per_s,compute_us,render_us,push_bytes\n");
+  else printf("%-16s %6s %8s %12s %11s %10s %8s\n", "mode", "grid", "fps", "vertices/s", "compute us", "render us", "push KB");
+
+  double totalSeconds = 0;
+  long totalFrames = 0;
+  bool imagesOk = true;
+  for (int w = 0; w < WAVE_STYLE_COUNT; w++) {
+    if (opt.wave >= 0 && w != opt.wave) continue;
+    for (int d = 0; d < BENCH_DISPLAY_COUNT; d++) {
+      if (opt.display >= 0 && d != opt.display) continue;
+
+      BenchResult r = benchRun(opt, w, d);
+      double fps = opt.frames / r.seconds;
+      double vps = r.vertices / r.seconds;
+      if (opt.csv) {
+        printf("%s,%s,%d,%d,%d,%.1f,%.0f,%.1f,%.1f,%.0f\n", benchWaveNames[w], benchDisplayNames[d],
+               r.cols, r.rows, opt.frames, fps, vps, r.computeUs, r.renderUs, r.pushBytes);
+      } else {
+        std::string mode = std::string(benchWaveNames[w]) + "/" + benchDisplayNames[d];
+        printf("%-16s %3dx%-2d %8.0f %12.0f %11.1f %10.1f %8.1f\n", mode.c_str(), r.cols, r.rows,
+               fps, vps, r.computeUs, r.renderUs, r.pushBytes / 1024);
+      }
+      fflush(stdout);
+      if (opt.images) imagesOk &= benchImage(opt, w, d);
+      totalSeconds += r.seconds;
+      totalFrames += opt.frames;
+    }
+  }
+
+  if (!opt.csv) printf("%ld frames in %.2f s\n", totalFrames, totalSeconds);
+  return imagesOk ? 0 : 1;
+}
@@ -0,0 +1,10 @@
+/*
+  Hardware globals of the native build
+*/
+
+#include <M5StickCPlus2.h>
+#include <LittleFS.h>
+
+SerialT Serial;
+M5Native M5;
+LittleFSFS LittleFS;
@@ -0,0 +1,34 @@
+/*
+  Native stand-in for LittleFS.h
+
+  The host has no flash partition: begin() fails, so a build with
+  HECTOR_TRACE falls back to live sensors and the formula mode keeps its
+  built-in formula. The native bench records and replays traces through
+  host files instead (see --record/--replay).
+*/
+
+#ifndef HECTOR_NATIVE_LITTLEFS_H
+#define HECTOR_NATIVE_LITTLEFS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class File {
+public:
+  size_t write(const uint8_t*, size_t) { return 0; }
+  size_t read(uint8_t*, size_t) { return 0; }
+  void flush() {}
+  void close() {}
+  explicit operator bool() const { return false; }
+};
+
+class LittleFSFS {
+public:
+  bool begin(bool formatOnFail = false) { return false; }
+  bool exists(const char*) { return false; }
+  File open(const char*, const char*) { return File(); }
+};
+
+extern LittleFSFS LittleFS;
+
+#endif // HECTOR_NATIVE_LITTLEFS_H
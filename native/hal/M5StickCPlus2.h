@@ -0,0 +1,203 @@
+/*
+  Native stand-in for M5StickCPlus2.h
+
+  Just enough of Arduino, M5Unified and LovyanGFX for main.cpp to compile
+  and run on the host. The display and canvas accept every call and draw
+  nothing: frames are rasterized into the framebuffer by raster.h, which
+  the headless renderer reads directly. With no font to read glyphs from,
+  the status lines are blank boxes in those frames. Buttons are GPIO levels the bench
+  sets in nativeHal(), read without interrupts; the IMU reports nativeHal().
+  Serial goes to stdout and never has input.
+*/
+
+#ifndef HECTOR_NATIVE_M5STICKCPLUS2_H
+#define HECTOR_NATIVE_M5STICKCPLUS2_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include "native_hal.h"
+
+using std::min;
+using std::max;
+
+// ---------------------------------------------------------------------------
+// Arduino core
+// ---------------------------------------------------------------------------
+
+inline unsigned long micros() {
+  using namespace std::chrono;
+  return (unsigned long)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+inline unsigned long millis() { return micros() / 1000; }
+
+inline void delay(unsigned long ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void delayMicroseconds(unsigned int us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+template <class T, class L, class H>
+T constrain(T x, L lo, H hi) { return x < lo ? lo : (x > hi ? hi : x); }
+
+inline bool psramFound() { return false; }
+
+inline bool setCpuFrequencyMhz(uint32_t mhz) {
+  nativeHal().cpuMhz = mhz;
+  return true;
+}
+
+inline uint32_t getCpuFrequencyMhz() { return nativeHal().cpuMhz; }
+
+// GPIO: levels come from nativeHal().pinLow; interrupts never fire, so
+// the button job sees every change by polling
+#define LOW    0
+#define HIGH   1
+#define INPUT  0x01
+#define CHANGE 0x03
+#define IRAM_ATTR
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t pin) { return pin < 40 && nativeHal().pinLow[pin] ? LOW : HIGH; }
+inline void attachInterruptArg(uint8_t, void (*)(void*), void*, int) {}
+
+#define BLACK  0x0000
+#define WHITE  0xFFFF
+#define RED    0xF800
+#define GREEN  0x07E0
+#define YELLOW 0xFFE0
+#define CYAN   0x07FF
+
+struct SerialT {
+  void begin(unsigned long) {}
+  void print(const char* s) {
+    if (!nativeHal().serialQuiet) fputs(s, stdout);
+  }
+  void println(const char* s) {
+    if (!nativeHal().serialQuiet) puts(s);
+  }
+  void printf(const char* format, ...) {
+    if (nativeHal().serialQuiet) return;
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+  }
+  int available() { return 0; }  // nothing is typed on the host
+  int read() { return -1; }
+};
+
+extern SerialT Serial;
+
+// ---------------------------------------------------------------------------
+// LovyanGFX / M5GFX
+// ---------------------------------------------------------------------------
+
+namespace lgfx {
+
+enum color_depth_t { rgb565_2Byte = 16 };
+struct swap565_t { uint16_t raw; };
+
+class LovyanGFX {
+public:
+  void startWrite() {}
+  void endWrite() {}
+  void waitDMA() {}
+  template <typename T>
+  void pushImageDMA(int32_t, int32_t, int32_t, int32_t, const T*) {}
+  void setAddrWindow(int32_t, int32_t, int32_t, int32_t) {}
+  template <typename T>
+  void writePixelsDMA(const T*, int32_t) {}
+  void drawLine(int32_t, int32_t, int32_t, int32_t, uint32_t) {}
+  void fillTriangle(int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, uint32_t) {}
+  void fillRect(int32_t, int32_t, int32_t, int32_t, uint32_t) {}
+  void fillScreen(uint32_t) {}
+  void drawBitmap(int32_t, int32_t, const uint8_t*, int32_t, int32_t, uint32_t, uint32_t) {}
+  void setCursor(int32_t, int32_t) {}
+  void setTextColor(uint32_t) {}
+  void setTextColor(uint32_t, uint32_t) {}
+  void setTextSize(float) {}
+  void setRotation(uint8_t) {}
+  void setBrightness(uint8_t) {}
+  size_t printf(const char*, ...) { return 0; }
+  size_t println(const char*) { return 0; }
+  size_t print(char) { return 0; }
+
+  static uint16_t color565(uint8_t r, uint8_t g, uint8_t b) {
+    return (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+  }
+};
+
+} // namespace lgfx
+
+class M5Canvas : public lgfx::LovyanGFX {
+public:
+  explicit M5Canvas(lgfx::LovyanGFX*) {}
+  void setBuffer(void*, int32_t, int32_t, lgfx::color_depth_t) {}
+  // No font on the host: sprites are never allocated
+  void setColorDepth(int) {}
+  void* createSprite(int32_t, int32_t) { return nullptr; }
+  void deleteSprite() {}
+  void fillSprite(uint32_t) {}
+  uint16_t readPixel(int32_t, int32_t) { return 0; }
+};
+
+// ---------------------------------------------------------------------------
+// M5Unified
+// ---------------------------------------------------------------------------
+
+class Button_Class {
+public:
+  bool isPressed() const { return false; }
+  bool wasPressed() const { return false; }
+  bool wasClicked() const { return false; }
+  bool wasSingleClicked() const { return false; }
+  bool wasDoubleClicked() const { return false; }
+};
+
+class IMU_Class {
+public:
+  bool init() { return true; }
+  bool getAccelData(float* x, float* y, float* z) {
+    *x = nativeHal().accX;
+    *y = nativeHal().accY;
+    *z = nativeHal().accZ;
+    return true;
+  }
+  bool getGyroData(float* x, float* y, float* z) {
+    *x = nativeHal().gyroX;
+    *y = nativeHal().gyroY;
+    *z = nativeHal().gyroZ;
+    return true;
+  }
+};
+
+// The internal I2C bus: nothing answers on the host, so the IMU FIFO
+// is never set up
+class I2C_Class {
+public:
+  bool writeRegister8(uint8_t, uint8_t, uint8_t, uint32_t) const { return false; }
+  bool readRegister(uint8_t, uint8_t, uint8_t*, size_t, uint32_t) const { return false; }
+};
+
+class M5Native {
+public:
+  void begin() {}
+  void update() {}
+
+  lgfx::LovyanGFX Display;
+  IMU_Class Imu;
+  I2C_Class In_I2C;
+  Button_Class BtnA, BtnB, BtnPWR;
+};
+
+extern M5Native M5;
+
+#endif // HECTOR_NATIVE_M5STICKCPLUS2_H
@@ -0,0 +1,82 @@
+/*
+  Native stand-in for the ESP-IDF I2S driver
+
+  i2s_read() returns a generated microphone signal: two tones that drift
+  in and out plus a little noise, the same on every run. A blocking read
+  always gets a full buffer; a non-blocking one only gets the buffers
+  nativeHal().audioBlocks says have arrived.
+*/
+
+#ifndef HECTOR_NATIVE_I2S_H
+#define HECTOR_NATIVE_I2S_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+#include "../native_hal.h"
+
+typedef int esp_err_t;
+typedef int i2s_port_t;
+typedef int i2s_mode_t;
+
+#define ESP_OK   0
+#define ESP_FAIL -1
+#define portMAX_DELAY 0xffffffffu
+
+#define I2S_NUM_0 0
+#define I2S_MODE_MASTER 1
+#define I2S_MODE_RX 4
+#define I2S_MODE_PDM 64
+#define I2S_BITS_PER_SAMPLE_16BIT 16
+#define I2S_CHANNEL_FMT_ONLY_RIGHT 3
+#define I2S_COMM_FORMAT_I2S 1
+#define I2S_CHANNEL_MONO 1
+#define I2S_PIN_NO_CHANGE -1
+#define ESP_INTR_FLAG_LEVEL1 2
+
+struct i2s_config_t {
+  int mode;
+  int sample_rate;
+  int bits_per_sample;
+  int channel_format;
+  int communication_format;
+  int intr_alloc_flags;
+  int dma_buf_count;
+  int dma_buf_len;
+};
+
+struct i2s_pin_config_t {
+  int bck_io_num;
+  int ws_io_num;
+  int data_out_num;
+  int data_in_num;
+};
+
+inline esp_err_t i2s_driver_install(i2s_port_t, const i2s_config_t*, int, void*) { return ESP_OK; }
+inline esp_err_t i2s_set_pin(i2s_port_t, const i2s_pin_config_t*) { return ESP_OK; }
+inline esp_err_t i2s_set_clk(i2s_port_t, uint32_t, uint32_t, uint32_t) { return ESP_OK; }
+
+inline esp_err_t i2s_read(i2s_port_t, void* dest, size_t size, size_t* bytes_read, uint32_t ticks) {
+  NativeHal& hal = nativeHal();
+  *bytes_read = 0;
+  if (ticks == 0) {
+    if (hal.audioBlocks <= 0) return ESP_OK;
+    hal.audioBlocks--;
+  }
+
+  int16_t* out = (int16_t*)dest;
+  const size_t samples = size / sizeof(int16_t);
+  static uint32_t noise = 12345;
+  for (size_t i = 0; i < samples; i++) {
+    float t = (hal.audioSample++) / 44100.0f;
+    float swell = 0.5f + 0.5f * sinf(6.2831853f * 0.5f * t);
+    float v = 3000 * swell * sinf(6.2831853f * 220 * t) + 1500 * (1 - swell) * sinf(6.2831853f * 1760 * t);
+    noise = noise * 1664525u + 1013904223u;
+    v += (int16_t)(noise >> 16) / 64;
+    out[i] = (int16_t)v;
+  }
+  *bytes_read = samples * sizeof(int16_t);
+  return ESP_OK;
+}
+
+#endif // HECTOR_NATIVE_I2S_H
@@ -0,0 +1,19 @@
+/*
+  Native stand-in for esp_heap_caps.h: every capability is plain heap
+*/
+
+#ifndef HECTOR_NATIVE_ESP_HEAP_CAPS_H
+#define HECTOR_NATIVE_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_DMA      (1 << 3)
+#define MALLOC_CAP_8BIT     (1 << 2)
+#define MALLOC_CAP_SPIRAM   (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+inline void* heap_caps_malloc(size_t size, uint32_t) { return malloc(size); }
+inline void heap_caps_free(void* p) { free(p); }
+
+#endif // HECTOR_NATIVE_ESP_HEAP_CAPS_H
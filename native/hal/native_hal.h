@@ -0,0 +1,30 @@
+/*
+  Native HAL state for Hector
+
+  What the stubbed M5StickC Plus2 hardware reports on the host: the IMU
+  reading, how many microphone DMA buffers are waiting, the CPU clock last
+  set, the GPIO levels and whether Serial output is shown. The benchmark
+  sets these between frames.
+*/
+
+#ifndef HECTOR_NATIVE_HAL_H
+#define HECTOR_NATIVE_HAL_H
+
+#include <stdint.h>
+
+struct NativeHal {
+  float accX = 0, accY = 0, accZ = 1;     // g
+  float gyroX = 0, gyroY = 0, gyroZ = 0;  // dps
+  int audioBlocks = 0;                    // DMA buffers a non-blocking i2s_read() returns
+  uint32_t audioSample = 0;               // position in the generated microphone signal
+  uint32_t cpuMhz = 240;                  // setCpuFrequencyMhz()
+  bool pinLow[40] = {};                   // GPIO levels held low: a pressed button
+  bool serialQuiet = false;
+};
+
+inline NativeHal& nativeHal() {
+  static NativeHal hal;
+  return hal;
+}
+
+#endif // HECTOR_NATIVE_HAL_H
@@ -0,0 +1,123 @@
+/*
+  Headless frame output for the native build
+
+  Writes a FrameBuffer (byte-swapped RGB565, see raster.h) as a binary PPM
+  or as a PNG. The PNG uses stored deflate blocks, so no zlib is needed;
+  the files are uncompressed but open in any viewer.
+*/
+
+#ifndef HECTOR_HEADLESS_H
+#define HECTOR_HEADLESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include "raster.h"
+
+// RGB888 rows of the framebuffer, with the 5/6-bit channels widened
+inline std::vector<uint8_t> headlessRgb(const FrameBuffer& fb) {
+  std::vector<uint8_t> rgb((size_t)fb.width * fb.height * 3);
+  for (int i = 0; i < fb.width * fb.height; i++) {
+    uint16_t v = fb.pixels[i];
+    uint16_t c = (uint16_t)((v >> 8) | (v << 8));
+    uint8_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    rgb[i * 3 + 0] = (uint8_t)((r << 3) | (r >> 2));
+    rgb[i * 3 + 1] = (uint8_t)((g << 2) | (g >> 4));
+    rgb[i * 3 + 2] = (uint8_t)((b << 3) | (b >> 2));
+  }
+  return rgb;
+}
+
+inline bool writeFramePpm(const char* path, const FrameBuffer& fb) {
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  std::vector<uint8_t> rgb = headlessRgb(fb);
+  fprintf(f, "P6\n%d %d\n255\n", fb.width, fb.height);
+  bool ok = fwrite(rgb.data(), 1, rgb.size(), f) == rgb.size();
+  return fclose(f) == 0 && ok;
+}
+
+inline uint32_t headlessCrc32(const uint8_t* data, size_t n, uint32_t crc = 0) {
+  static uint32_t table[256];
+  if (!table[1]) {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+  }
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+inline void headlessPut32(std::vector<uint8_t>& out, uint32_t v) {
+  out.push_back((uint8_t)(v >> 24));
+  out.push_back((uint8_t)(v >> 16));
+  out.push_back((uint8_t)(v >> 8));
+  out.push_back((uint8_t)v);
+}
+
+inline void headlessChunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& body) {
+  headlessPut32(out, (uint32_t)body.size());
+  std::vector<uint8_t> typed(type, type + 4);
+  typed.insert(typed.end(), body.begin(), body.end());
+  out.insert(out.end(), typed.begin(), typed.end());
+  headlessPut32(out, headlessCrc32(typed.data(), typed.size()));
+}
+
+inline bool writeFramePng(const char* path, const FrameBuffer& fb) {
+  std::vector<uint8_t> rgb = headlessRgb(fb);
+
+  // Scanlines with filter type 0 in front of each row
+  const size_t stride = (size_t)fb.width * 3;
+  std::vector<uint8_t> raw;
+  raw.reserve((stride + 1) * fb.height);
+  for (int y = 0; y < fb.height; y++) {
+    raw.push_back(0);
+    raw.insert(raw.end(), rgb.begin() + y * stride, rgb.begin() + (y + 1) * stride);
+  }
+
+  // zlib stream of stored blocks
+  std::vector<uint8_t> z;
+  z.push_back(0x78);
+  z.push_back(0x01);
+  uint32_t a = 1, b = 0;
+  for (size_t pos = 0; pos < raw.size() || pos == 0;) {
+    size_t n = raw.size() - pos < 65535 ? raw.size() - pos : 65535;
+    bool last = pos + n == raw.size();
+    z.push_back(last ? 1 : 0);
+    z.push_back((uint8_t)n);
+    z.push_back((uint8_t)(n >> 8));
+    z.push_back((uint8_t)~n);
+    z.push_back((uint8_t)(~n >> 8));
+    for (size_t i = 0; i < n; i++) {
+      uint8_t v = raw[pos + i];
+      z.push_back(v);
+      a = (a + v) % 65521;
+      b = (b + a) % 65521;
+    }
+    pos += n;
+    if (last) break;
+  }
+  headlessPut32(z, (b << 16) | a);
+
+  std::vector<uint8_t> ihdr;
+  headlessPut32(ihdr, (uint32_t)fb.width);
+  headlessPut32(ihdr, (uint32_t)fb.height);
+  const uint8_t format[5] = {8, 2, 0, 0, 0};  // 8-bit RGB, no interlace
+  ihdr.insert(ihdr.end(), format, format + 5);
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  std::vector<uint8_t> png(signature, signature + 8);
+  headlessChunk(png, "IHDR", ihdr);
+  headlessChunk(png, "IDAT", z);
+  headlessChunk(png, "IEND", std::vector<uint8_t>());
+
+  FILE* f = fopen(path, "wb");
+  if (!f) return false;
+  bool ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+  return fclose(f) == 0 && ok;
+}
+
+#endif // HECTOR_HEADLESS_H
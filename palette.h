@@ -0,0 +1,182 @@
+/*
+  Surface palettes for Hector
+
+  The color of a vertex only depends on its grid row, its grid column and
+  its truncated height. A palette is turned into per-row and per-column
+  base colors and a brightness table indexed by height once, whenever the
+  palette or the grid layout changes, so shading a vertex is a table
+  lookup, three multiplies and the RGB565 pack.
+
+  PALETTE_CLASSIC reproduces the original map()/color565() math bit for
+  bit over the heights the surfaces produce, including blue being dimmed
+  again by every vertex along a row.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_PALETTE_H
+#define HECTOR_PALETTE_H
+
+#include <stdint.h>
+
+// Brightness table range; heights outside it (a steep TILT) call the
+// palette's brightness function instead
+#define PALETTE_Z_MIN -256
+#define PALETTE_Z_MAX 255
+
+enum PaletteId {
+  PALETTE_CLASSIC,  // red/green across the columns, blue down the rows
+  PALETTE_HEAT,     // dark red valleys, orange peaks
+  PALETTE_OCEAN,    // deep blue to cyan crests
+  PALETTE_MONO,     // grey, shaded by height
+  PALETTE_COUNT
+};
+
+struct PaletteRgb {
+  uint8_t r, g, b;
+};
+
+struct PaletteSpec {
+  const char* name;
+  bool compound;                           // row colors are dimmed cumulatively along the row
+  PaletteRgb (*row)(float x, float half);  // base color of the scan row at x
+  PaletteRgb (*col)(float y, float half);  // base color of the column at y
+  float (*brightness)(int z);              // factor at truncated height z
+};
+
+// Arduino map() on longs, with its truncation
+inline long paletteMap(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+inline float paletteRamp(float v, float lo, float hi) {
+  float t = (v - lo) / (hi - lo);
+  return t < 0 ? 0 : (t > 1 ? 1 : t);
+}
+
+inline PaletteRgb paletteRgb(float r, float g, float b) {
+  PaletteRgb c;
+  c.r = (uint8_t)(r + 0.5f);
+  c.g = (uint8_t)(g + 0.5f);
+  c.b = (uint8_t)(b + 0.5f);
+  return c;
+}
+
+// Classic: the arithmetic sinLoop() has always used
+inline PaletteRgb classicRow(float x, float half) {
+  PaletteRgb c = {0, 0, (uint8_t)paletteMap((long)x, (long)-half, (long)half, 0, 255)};
+  return c;
+}
+
+inline PaletteRgb classicCol(float y, float half) {
+  uint8_t green = (uint8_t)paletteMap((long)y, (long)-half, (long)half, 0, 255);
+  PaletteRgb c = {(uint8_t)(255 - green), green, 0};
+  return c;
+}
+
+inline float classicBrightness(int z) {
+  return float(paletteMap(z, -50, 50, 100, 20)) / 100.0;
+}
+
+inline PaletteRgb heatRow(float x, float half) { return paletteRgb(0, 0, 0); }
+
+inline PaletteRgb heatCol(float y, float half) {
+  return paletteRgb(255, 60 + 110 * paletteRamp(y, -half, half), 10);
+}
+
+inline float heatBrightness(int z) { return 0.2f + 0.8f * paletteRamp(z, -60, 60); }
+
+inline PaletteRgb oceanRow(float x, float half) {
+  return paletteRgb(0, 0, 140 + 115 * paletteRamp(x, -half, half));
+}
+
+inline PaletteRgb oceanCol(float y, float half) {
+  return paletteRgb(10, 60 + 130 * paletteRamp(y, -half, half), 0);
+}
+
+inline float oceanBrightness(int z) { return 0.35f + 0.65f * paletteRamp(z, -50, 50); }
+
+inline PaletteRgb monoRow(float x, float half) { return paletteRgb(0, 0, 0); }
+
+inline PaletteRgb monoCol(float y, float half) { return paletteRgb(230, 230, 230); }
+
+inline float monoBrightness(int z) { return 1.0f - 0.8f * paletteRamp(z, -50, 50); }
+
+// Indexed by PaletteId
+static const PaletteSpec paletteSpecs[PALETTE_COUNT] = {
+  { "CLASSIC", true,  classicRow, classicCol, classicBrightness },
+  { "HEAT",    false, heatRow,    heatCol,    heatBrightness },
+  { "OCEAN",   false, oceanRow,   oceanCol,   oceanBrightness },
+  { "MONO",    false, monoRow,    monoCol,    monoBrightness },
+};
+
+template <int MAX_ROWS, int MAX_COLS>
+class PaletteTables {
+public:
+  // Rebuild every table for palette id on the grid xs[rows] x ys[cols]
+  void build(PaletteId id, const float* xs, int rows, const float* ys, int cols, float half) {
+    const PaletteSpec& spec = paletteSpecs[id];
+    compound = spec.compound;
+    brightnessAt = spec.brightness;
+    rowCount = rows < MAX_ROWS ? rows : MAX_ROWS;
+    colCount = cols < MAX_COLS ? cols : MAX_COLS;
+    for (int i = 0; i < rowCount; i++) rowBase[i] = spec.row(xs[i], half);
+    for (int j = 0; j < colCount; j++) colBase[j] = spec.col(ys[j], half);
+    for (int z = PALETTE_Z_MIN; z <= PALETTE_Z_MAX; z++) {
+      brightness[z - PALETTE_Z_MIN] = spec.brightness(z);
+    }
+  }
+
+  // RGB565 colors of scan row i with heights zs[]
+  void shadeRow(int i, const float* zs, uint16_t* out, int cols) const {
+    const int n = cols < colCount ? cols : colCount;
+    PaletteRgb acc = rowBase[i];
+    for (int j = 0; j < n; j++) {
+      const float f = factor(zs[j]);
+      const PaletteRgb& c = colBase[j];
+      uint8_t r, g, b;
+      if (compound) {
+        acc.r = scale(acc.r, f);
+        acc.g = scale(acc.g, f);
+        acc.b = scale(acc.b, f);
+        r = scale(c.r, f) + acc.r;
+        g = scale(c.g, f) + acc.g;
+        b = scale(c.b, f) + acc.b;
+      } else {
+        r = scale(sum(c.r, acc.r), f);
+        g = scale(sum(c.g, acc.g), f);
+        b = scale(sum(c.b, acc.b), f);
+      }
+      out[j] = (uint16_t)(((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3));
+    }
+  }
+
+private:
+  // The factor stays a float: a Q16 multiply truncates differently from
+  // the float product in about 0.1% of the classic colors. Out of range
+  // products wrap to 8 bits like the old uint8_t assignment did.
+  static uint8_t scale(uint8_t c, float f) { return (uint8_t)(int32_t)(c * f); }
+
+  static uint8_t sum(uint8_t a, uint8_t b) {
+    int s = a + b;
+    return s > 255 ? 255 : (uint8_t)s;
+  }
+
+  // Brightness at int(z)
+  float factor(float z) const {
+    if (z > PALETTE_Z_MIN - 1 && z < PALETTE_Z_MAX + 1) return brightness[(int)z - PALETTE_Z_MIN];
+    if (!(z > -1e6f)) z = -1e6f;  // also NaN
+    if (z > 1e6f) z = 1e6f;
+    return brightnessAt((int)z);
+  }
+
+  bool compound = true;
+  float (*brightnessAt)(int z) = nullptr;
+  int rowCount = 0;
+  int colCount = 0;
+  PaletteRgb rowBase[MAX_ROWS];
+  PaletteRgb colBase[MAX_COLS];
+  float brightness[PALETTE_Z_MAX - PALETTE_Z_MIN + 1];
+};
+
+#endif // HECTOR_PALETTE_H
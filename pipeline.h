@@ -0,0 +1,246 @@
+/*
+  Frame pipeline for Hector
+
+  Splits a frame into two stages that run on different cores:
+    - compute (core 0): sensors, surface evaluation and projection
+    - render  (core 1): rasterization and display push
+
+  Frames are handed over through FrameExchange, two slots guarded by
+  atomic state flags (no mutexes). The producer may only start frame N+1
+  once the consumer has picked up frame N, so frames are never dropped or
+  reordered and a slot is never written while it is being read. Sensor
+  readings are published through a SeqLock, and button edges and commands
+  travel through an SpscQueue.
+
+  On the ESP32 the compute stage is a pinned FreeRTOS task; on the host
+  the same code runs on a std::thread so ordering can be checked off-device.
+*/
+
+#ifndef HECTOR_PIPELINE_H
+#define HECTOR_PIPELINE_H
+
+#include <stdint.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+// ---------------------------------------------------------------------------
+// Platform shim
+// ---------------------------------------------------------------------------
+
+typedef void (*PipelineTaskFn)(void* arg);
+
+inline uint32_t pipelineMicros() {
+#ifdef ARDUINO
+  return (uint32_t)micros();
+#else
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Give the other stage a chance to run while waiting for a slot
+inline void pipelineYield() {
+#ifdef ARDUINO
+  vTaskDelay(1);
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// Sleep until the next scheduled event; waits under a tick busy-wait
+inline void pipelineSleepMicros(uint32_t us) {
+#ifdef ARDUINO
+  if (us >= 1000) vTaskDelay(pdMS_TO_TICKS(us / 1000));
+  else delayMicroseconds(us);
+#else
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+#endif
+}
+
+// Start fn(arg) as a long-running task pinned to the given core
+inline bool pipelineStartTask(PipelineTaskFn fn, void* arg, const char* name,
+                              int core, uint32_t stackBytes, int priority) {
+#ifdef ARDUINO
+  return xTaskCreatePinnedToCore(fn, name, stackBytes, arg, priority, nullptr, core) == pdPASS;
+#else
+  (void)name; (void)core; (void)stackBytes; (void)priority;
+  std::thread(fn, arg).detach();
+  return true;
+#endif
+}
+
+// ---------------------------------------------------------------------------
+// Lock-free double-buffered frame hand-off
+// ---------------------------------------------------------------------------
+
+template <typename Frame>
+class FrameExchange {
+public:
+  FrameExchange() {
+    for (int i = 0; i < 2; i++) state[i].store(SLOT_FREE);
+  }
+
+  // Producer: a free slot to fill, or nullptr while the last published
+  // frame has not been picked up yet (or both slots are busy)
+  Frame* acquireWrite() {
+    for (int i = 0; i < 2; i++) {
+      if (state[i].load(std::memory_order_acquire) == SLOT_READY) return nullptr;
+    }
+    for (int i = 0; i < 2; i++) {
+      uint8_t expected = SLOT_FREE;
+      if (state[i].compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acq_rel)) {
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void publish(Frame* frame) {
+    state[indexOf(frame)].store(SLOT_READY, std::memory_order_release);
+  }
+
+  // Consumer: the published frame, or nullptr if none is ready
+  Frame* acquireRead() {
+    for (int i = 0; i < 2; i++) {
+      uint8_t expected = SLOT_READY;
+      if (state[i].compare_exchange_strong(expected, SLOT_READING, std::memory_order_acq_rel)) {
+        return &slots[i];
+      }
+    }
+    return nullptr;
+  }
+
+  void release(Frame* frame) {
+    state[indexOf(frame)].store(SLOT_FREE, std::memory_order_release);
+  }
+
+private:
+  enum : uint8_t { SLOT_FREE, SLOT_WRITING, SLOT_READY, SLOT_READING };
+
+  int indexOf(const Frame* frame) const { return frame == &slots[0] ? 0 : 1; }
+
+  Frame slots[2];
+  std::atomic<uint8_t> state[2];
+};
+
+// ---------------------------------------------------------------------------
+// Single-writer published value
+// ---------------------------------------------------------------------------
+
+// Sequence lock: the writer never waits, readers retry if they raced a
+// store. Used to publish small structs (sensor readings) from a producer
+// task to the frame loop without tearing.
+template <typename T>
+class SeqLock {
+public:
+  void store(const T& v) {
+    uint32_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    value = v;
+    std::atomic_thread_fence(std::memory_order_release);
+    seq.store(s + 2, std::memory_order_relaxed);
+  }
+
+  T load() const {
+    for (;;) {
+      uint32_t s1 = seq.load(std::memory_order_acquire);
+      if (s1 & 1) continue;
+      T v = value;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq.load(std::memory_order_relaxed) == s1) return v;
+    }
+  }
+
+  // Number of stores so far
+  uint32_t version() const { return seq.load(std::memory_order_acquire) >> 1; }
+
+private:
+  std::atomic<uint32_t> seq{0};
+  T value = T();
+};
+
+// ---------------------------------------------------------------------------
+// Single-producer queue
+// ---------------------------------------------------------------------------
+
+// Ring of N - 1 items (N a power of two) between one producer and one
+// consumer, which may be an interrupt and a task or two cores. Neither
+// side waits: a push to a full queue drops the item and counts it.
+template <typename T, uint32_t N>
+class SpscQueue {
+  static_assert((N & (N - 1)) == 0, "N must be a power of two");
+
+public:
+  bool push(const T& v) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N - 1) {
+      drops.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    items[h & (N - 1)] = v;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T& v) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return false;
+    v = items[t & (N - 1)];
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Items dropped on a full queue so far
+  uint32_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0}, tail{0};
+  std::atomic<uint32_t> drops{0};
+};
+
+// ---------------------------------------------------------------------------
+// Per-stage timing
+// ---------------------------------------------------------------------------
+
+// Accumulated from one core, drained once a second from the other
+struct StageTiming {
+  std::atomic<uint32_t> totalUs{0};
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> maxUs{0};
+
+  void add(uint32_t us) {
+    totalUs.fetch_add(us, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    uint32_t m = maxUs.load(std::memory_order_relaxed);
+    while (us > m && !maxUs.compare_exchange_weak(m, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  // Average and maximum since the last call, then reset
+  void take(uint32_t& avgUs, uint32_t& peakUs) {
+    uint32_t n = count.exchange(0, std::memory_order_relaxed);
+    uint32_t total = totalUs.exchange(0, std::memory_order_relaxed);
+    peakUs = maxUs.exchange(0, std::memory_order_relaxed);
+    avgUs = n ? total / n : 0;
+  }
+};
+
+struct PipelineStats {
+  StageTiming compute;     // surface evaluation + projection (core 0)
+  StageTiming render;      // rasterization + push (core 1)
+  StageTiming computeWait; // producer blocked on the consumer
+  StageTiming renderWait;  // consumer starved by the producer
+  StageTiming frame;       // render start to render start
+};
+
+#endif // HECTOR_PIPELINE_H
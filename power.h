@@ -0,0 +1,164 @@
+/*
+  Power governor for Hector
+
+  Watches for a device left alone: the variance of the accelerometer and
+  gyro magnitudes (so a constant tilt or gyro bias reads as still), the
+  sound level and the buttons. After dimAfterMs without any of them the
+  governor steps down to DIM, after dozeAfterMs to DOZE; each level has
+  its own frame rate, CPU clock and backlight. Any activity goes straight
+  back to ACTIVE on the update that sees it.
+
+  The caller applies the settings of the level (scheduler rate, CPU clock,
+  backlight), and feeds update() at a fixed period, a few times the rate
+  of the motion it should notice.
+
+  powerEstimateMw() turns a CPU clock, the busy time of the cores and the
+  backlight into an estimate of the draw of the whole stick, from the
+  ESP32 datasheet figures (radios off) and nominal figures for the rest.
+  It is a model for comparing settings, not a measurement.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_POWER_H
+#define HECTOR_POWER_H
+
+#include <stdint.h>
+#include <math.h>
+
+enum PowerLevel : uint8_t {
+  POWER_ACTIVE,
+  POWER_DIM,
+  POWER_DOZE,
+  POWER_LEVEL_COUNT
+};
+
+static const char* const powerLevelNames[POWER_LEVEL_COUNT] = { "ACTIVE", "DIM", "DOZE" };
+
+struct PowerSettings {
+  uint16_t fps;
+  uint16_t cpuMhz;     // 80, 160 or 240
+  uint8_t backlight;   // 0..255
+  bool lightSleep;     // let the idle task light sleep between frames
+};
+
+struct PowerConfig {
+  PowerSettings level[POWER_LEVEL_COUNT] = {
+    {60, 240, 128, false},
+    {20, 160, 48, false},
+    {5, 80, 12, true},
+  };
+  uint32_t dimAfterMs = 15000;
+  uint32_t dozeAfterMs = 60000;
+  float accelStd = 0.02f;  // g, standard deviation of |acc| that counts as motion
+  float gyroStd = 5.0f;    // dps, the same for |gyro|
+  float sound = 0.05f;     // sound level
+  float smoothing = 0.25f; // weight of a new sample in the running mean and variance
+};
+
+struct PowerInputs {
+  float accX, accY, accZ;     // g
+  float gyroX, gyroY, gyroZ;  // dps
+  float sound;
+  bool button;
+};
+
+// Exponentially weighted mean and variance of one signal
+struct PowerVariance {
+  float mean = 0, var = 0;
+  bool primed = false;
+
+  float add(float v, float a) {
+    if (!primed) {
+      primed = true;
+      mean = v;
+      return var = 0;
+    }
+    float d = v - mean;
+    mean += a * d;
+    return var = (1 - a) * (var + a * d * d);
+  }
+};
+
+class PowerGovernor {
+public:
+  void begin(const PowerConfig& c, uint32_t nowMs) {
+    config = c;
+    accelLimit = c.accelStd * c.accelStd;
+    gyroLimit = c.gyroStd * c.gyroStd;
+    accel = PowerVariance();
+    gyro = PowerVariance();
+    current = POWER_ACTIVE;
+    lastActiveMs = nowMs;
+  }
+
+  // One sample of the sensors; true when the level changed
+  bool update(uint32_t nowMs, const PowerInputs& in) {
+    float a = accel.add(sqrtf(in.accX * in.accX + in.accY * in.accY + in.accZ * in.accZ), config.smoothing);
+    float g = gyro.add(sqrtf(in.gyroX * in.gyroX + in.gyroY * in.gyroY + in.gyroZ * in.gyroZ), config.smoothing);
+    if (in.button || a > accelLimit || g > gyroLimit || in.sound > config.sound) return wake(nowMs);
+
+    uint32_t idle = nowMs - lastActiveMs;
+    PowerLevel next = idle >= config.dozeAfterMs ? POWER_DOZE
+                    : idle >= config.dimAfterMs ? POWER_DIM : POWER_ACTIVE;
+    return set(next);
+  }
+
+  // Activity seen outside update() (a button): back to ACTIVE now
+  bool wake(uint32_t nowMs) {
+    lastActiveMs = nowMs;
+    return set(POWER_ACTIVE);
+  }
+
+  PowerLevel level() const { return current; }
+  const PowerSettings& settings() const { return config.level[current]; }
+  const PowerConfig& configuration() const { return config; }
+  uint32_t idleMs(uint32_t nowMs) const { return nowMs - lastActiveMs; }
+
+  // Standard deviations as last seen, for tuning the limits
+  float accelDeviation() const { return sqrtf(accel.var); }
+  float gyroDeviation() const { return sqrtf(gyro.var); }
+
+private:
+  bool set(PowerLevel next) {
+    if (next == current) return false;
+    current = next;
+    return true;
+  }
+
+  PowerConfig config;
+  PowerVariance accel, gyro;
+  float accelLimit = 0, gyroLimit = 0;
+  PowerLevel current = POWER_ACTIVE;
+  uint32_t lastActiveMs = 0;
+};
+
+// Energy model: ESP32 datasheet, modem sleep (CPU on, radios off), mA with
+// both cores idle and both cores busy at 80 / 160 / 240 MHz, plus nominal
+// draws for the backlight at full brightness and for the rest of the stick
+// (panel controller, IMU, microphone, PMIC), all from the battery.
+#define POWER_BATTERY_V 3.7f
+#define POWER_BACKLIGHT_MA 25.0f
+#define POWER_BOARD_MA 8.0f
+
+inline float powerCpuMa(int cpuMhz, float busyCores) {
+  static const float mhz[3] = {80, 160, 240};
+  static const float idleMa[3] = {20, 27, 30};
+  static const float busyMa[3] = {31, 44, 68};
+
+  int i = cpuMhz <= 160 ? 0 : 1;
+  float t = (cpuMhz - mhz[i]) / (mhz[i + 1] - mhz[i]);
+  t = t < 0 ? 0 : (t > 1 ? 1 : t);
+  float idle = idleMa[i] + t * (idleMa[i + 1] - idleMa[i]);
+  float busy = busyMa[i] + t * (busyMa[i + 1] - busyMa[i]);
+  busyCores = busyCores < 0 ? 0 : (busyCores > 2 ? 2 : busyCores);
+  return idle + (busy - idle) * busyCores / 2;
+}
+
+// busyCores: seconds of CPU work per second over both cores, 0..2
+inline float powerEstimateMw(int cpuMhz, float busyCores, uint8_t backlight) {
+  float ma = powerCpuMa(cpuMhz, busyCores) + POWER_BACKLIGHT_MA * backlight / 255 + POWER_BOARD_MA;
+  return ma * POWER_BATTERY_V;
+}
+
+#endif // HECTOR_POWER_H
@@ -0,0 +1,192 @@
+/*
+  Frame profiler for Hector
+
+  Per-stage timings from the CPU cycle counter, kept as one-second windows
+  of min / avg / p99 / max. Each stage has a histogram with four bins per
+  octave of microseconds, so p99 is the upper edge of a bin: at most a
+  quarter octave above the true value, and never above the maximum.
+
+  Stages that run once per event (a button poll, a display flush) are
+  timed with ProfileScope. Stages that run once per scan row (surface,
+  projection, drawing) add their cycles up with accumulate() and become
+  one sample per frame with commit().
+
+  Every stage must have a single writer at a time; take() may run on the
+  other core. It swaps the window being written, so at most a sample
+  landing mid-swap is counted in the wrong second.
+
+  Pure C++ with no Arduino dependencies apart from the cycle counter.
+*/
+
+#ifndef HECTOR_PROFILER_H
+#define HECTOR_PROFILER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+#define PROFILE_MAX_STAGES 12
+#define PROFILE_BINS 80  // up to 2^20 us
+
+inline uint32_t profilerCycles() {
+#ifdef ARDUINO
+  return ESP.getCycleCount();
+#else
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline uint32_t profilerCyclesPerMicro() {
+#ifdef ARDUINO
+  return ESP.getCpuFreqMHz();
+#else
+  return 1000;
+#endif
+}
+
+struct ProfileSummary {
+  uint32_t count;
+  uint32_t minUs, avgUs, p99Us, maxUs;
+};
+
+class ProfileHistogram {
+public:
+  void add(uint32_t us) {
+    int b = bin(us);
+    if (bins[b] != 0xFFFF) bins[b]++;
+    count++;
+    totalUs += us;
+    if (us < minUs) minUs = us;
+    if (us > maxUs) maxUs = us;
+  }
+
+  ProfileSummary summarize() const {
+    ProfileSummary s = {count, 0, 0, 0, 0};
+    if (!count) return s;
+    s.minUs = minUs;
+    s.maxUs = maxUs;
+    s.avgUs = (uint32_t)(totalUs / count);
+
+    // First bin where the running count reaches 99%
+    uint32_t target = count - count / 100;
+    uint32_t seen = 0;
+    s.p99Us = maxUs;
+    for (int b = 0; b < PROFILE_BINS; b++) {
+      seen += bins[b];
+      if (seen >= target) {
+        uint32_t edge = upperEdge(b);
+        if (edge < s.p99Us) s.p99Us = edge;
+        break;
+      }
+    }
+    return s;
+  }
+
+  void clear() {
+    memset(bins, 0, sizeof(bins));
+    count = 0;
+    totalUs = 0;
+    minUs = UINT32_MAX;
+    maxUs = 0;
+  }
+
+  // 0..7 us exact, then four bins per octave
+  static int bin(uint32_t us) {
+    if (us < 8) return (int)us;
+    int octave = 31 - __builtin_clz(us);
+    int b = 8 + (octave - 3) * 4 + (int)((us >> (octave - 2)) & 3);
+    return b < PROFILE_BINS ? b : PROFILE_BINS - 1;
+  }
+
+  // Largest value that falls in bin b
+  static uint32_t upperEdge(int b) {
+    if (b < 8) return (uint32_t)b;
+    int octave = (b - 8) / 4 + 3;
+    uint32_t sub = (uint32_t)((b - 8) % 4);
+    return ((4 + sub + 1) << (octave - 2)) - 1;
+  }
+
+private:
+  uint16_t bins[PROFILE_BINS] = {};
+  uint32_t count = 0;
+  uint64_t totalUs = 0;
+  uint32_t minUs = UINT32_MAX;
+  uint32_t maxUs = 0;
+};
+
+class Profiler {
+public:
+  void begin(int stageCount, uint32_t cyclesPerMicro = profilerCyclesPerMicro()) {
+    stages = stageCount < PROFILE_MAX_STAGES ? stageCount : PROFILE_MAX_STAGES;
+    setCyclesPerMicro(cyclesPerMicro);
+    for (int i = 0; i < 2; i++) {
+      for (int s = 0; s < PROFILE_MAX_STAGES; s++) windows[i][s].clear();
+    }
+    memset(pending, 0, sizeof(pending));
+    active.store(0);
+  }
+
+  // After a CPU clock change; a scope spanning the change is misread once
+  void setCyclesPerMicro(uint32_t cyclesPerMicro) {
+    cyclesPerUs.store(cyclesPerMicro ? cyclesPerMicro : 1, std::memory_order_relaxed);
+  }
+
+  void record(int stage, uint32_t cycles) {
+    recordMicros(stage, cycles / cyclesPerUs.load(std::memory_order_relaxed));
+  }
+
+  void recordMicros(int stage, uint32_t us) {
+    if (stage < stages) windows[active.load(std::memory_order_relaxed)][stage].add(us);
+  }
+
+  // Add up a stage over a frame; commit() turns the sum into one sample
+  void accumulate(int stage, uint32_t cycles) {
+    if (stage < stages) pending[stage] += cycles;
+  }
+
+  void commit(int stage) {
+    if (stage >= stages) return;
+    record(stage, pending[stage]);
+    pending[stage] = 0;
+  }
+
+  // Summaries of the window since the last call, then start a new one
+  void take(ProfileSummary* out) {
+    int old = active.load();
+    active.store(old ^ 1);
+    for (int s = 0; s < stages; s++) {
+      out[s] = windows[old][s].summarize();
+      windows[old][s].clear();
+    }
+  }
+
+  int count() const { return stages; }
+
+private:
+  int stages = 0;
+  std::atomic<uint32_t> cyclesPerUs{1};
+  std::atomic<int> active{0};
+  ProfileHistogram windows[2][PROFILE_MAX_STAGES];
+  uint32_t pending[PROFILE_MAX_STAGES];
+};
+
+// Times its enclosing block as one sample of a stage
+class ProfileScope {
+public:
+  ProfileScope(Profiler& p, int s) : profiler(p), stage(s), start(profilerCycles()) {}
+  ~ProfileScope() { profiler.record(stage, profilerCycles() - start); }
+
+private:
+  Profiler& profiler;
+  int stage;
+  uint32_t start;
+};
+
+#endif // HECTOR_PROFILER_H
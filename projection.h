@@ -0,0 +1,146 @@
+/*
+  Row projection for Hector
+
+  Rotates the surface vertices by the camera angles and applies the
+  perspective divide, one scan row at a time, writing screen coordinates
+  straight into a VertexRow. Two interchangeable policies:
+
+    - FloatProjection: the float math project() has always used, kept as
+      the reference
+    - FixedProjection: coordinates in Q8, rotation in Q14 and the divide
+      replaced by romRecipU32(), with the column terms of the rotation
+      computed once per frame; agrees with FloatProjection to +-1 pixel
+
+  Both are templates on the widest row they accept and expose the same
+  begin()/row() interface, so the renderer picks one with a typedef.
+  A vertex is marked valid whenever it could be projected, on screen or
+  not: the clipping rasterizer needs the off-screen corners too.
+*/
+
+#ifndef HECTOR_PROJECTION_H
+#define HECTOR_PROJECTION_H
+
+#include <stdint.h>
+#include "rom_math.h"
+#include "vertex_buffer.h"
+
+struct ProjectionSetup {
+  float cosAh = 1, sinAh = 0;  // camera yaw (tilt around the vertical axis)
+  float cosAv = 1, sinAv = 0;  // camera pitch
+  float size = 0;              // perspective numerator
+  float tsize = 0;             // camera distance
+  float zoom = 1;
+  int16_t halfWidth = 0;
+  int16_t halfHeight = 0;
+};
+
+template <int MAX_COLS>
+class FloatProjection {
+public:
+  // Once per frame, with the y of every column in the rows to come
+  void begin(const ProjectionSetup& s, const float* ys, int cols) {
+    setup = s;
+    colY = ys;
+    count = cols < MAX_COLS ? cols : MAX_COLS;
+  }
+
+  // Project the row at x with heights zs[] into out
+  void row(float x, const float* zs, const VertexRow& out) const {
+    const int n = count < out.cols ? count : out.cols;
+    for (int j = 0; j < n; j++) {
+      float y = colY[j];
+      float z = zs[j];
+      float x1 = x * setup.cosAh - y * setup.sinAh;
+      float y1 = x * setup.sinAh + y * setup.cosAh;
+      float z2 = z * setup.cosAv - x1 * setup.sinAv;
+      if ((setup.tsize - x1) == 0) continue;
+      float s = setup.size / (setup.tsize - x1);
+      int16_t px = setup.halfWidth - (setup.zoom * (y1 * s));
+      int16_t py = setup.halfHeight - (setup.zoom * (z2 * s));
+      out.x[j] = px;
+      out.y[j] = py;
+      out.z[j] = z;
+      out.setValid(j);
+    }
+  }
+
+private:
+  ProjectionSetup setup;
+  const float* colY = nullptr;
+  int count = 0;
+};
+
+template <int MAX_COLS>
+class FixedProjection {
+public:
+  void begin(const ProjectionSetup& s, const float* ys, int cols) {
+    count = cols < MAX_COLS ? cols : MAX_COLS;
+    cosH = toQ14(s.cosAh);
+    sinH = toQ14(s.sinAh);
+    cosV = toQ14(s.cosAv);
+    sinV = toQ14(s.sinAv);
+    tsizeQ8 = toQ8(s.tsize);
+    scaleQ16 = (uint32_t)(s.zoom * s.size * 65536.0f + 0.5f);
+    halfWidth = s.halfWidth;
+    halfHeight = s.halfHeight;
+
+    // y only changes per column, so its share of the rotation is per frame
+    for (int j = 0; j < count; j++) {
+      int32_t y = toQ8(ys[j]);
+      ySin[j] = y * sinH;
+      yCos[j] = y * cosH;
+    }
+  }
+
+  void row(float x, const float* zs, const VertexRow& out) const {
+    const int n = count < out.cols ? count : out.cols;
+    const int32_t xq = toQ8(x);
+    const int32_t xCos = xq * cosH;  // Q22
+    const int32_t xSin = xq * sinH;
+
+    for (int j = 0; j < n; j++) {
+      int32_t x1 = (xCos - ySin[j]) >> 14;  // Q8
+      int32_t y1 = (xSin + yCos[j]) >> 14;
+      float zf = zs[j];
+      if (zf > Z_LIMIT) zf = Z_LIMIT;
+      if (zf < -Z_LIMIT) zf = -Z_LIMIT;
+      int32_t z = toQ8(zf);
+      int32_t z2 = (int32_t)(((int64_t)z * cosV - (int64_t)x1 * sinV) >> 14);
+
+      // Behind or at the camera: leave the vertex invalid
+      int32_t d = tsizeQ8 - x1;
+      if (d < 4) continue;
+
+      // zoom * size / (tsize - x1) in Q12
+      int32_t f = (int32_t)(((uint64_t)scaleQ16 * romRecipU32((uint32_t)d)) >> 28);
+
+      // floor(half - v), which is what the float path's truncation gives
+      // for every on-screen vertex
+      int32_t px = halfWidth + (int32_t)((-(int64_t)y1 * f) >> 20);
+      int32_t py = halfHeight + (int32_t)((-(int64_t)z2 * f) >> 20);
+      out.x[j] = clamp16(px);
+      out.y[j] = clamp16(py);
+      out.z[j] = zs[j];
+      out.setValid(j);
+    }
+  }
+
+private:
+  // Keeps a height in Q8 inside 32 bits; z * cosV is taken in 64 bits, as
+  // a tall height can still land on screen when the camera pitches down
+  static constexpr float Z_LIMIT = 32767.0f;
+
+  static int32_t toQ8(float v) { return (int32_t)(v * 256.0f + (v >= 0 ? 0.5f : -0.5f)); }
+  static int32_t toQ14(float v) { return (int32_t)(v * 16384.0f + (v >= 0 ? 0.5f : -0.5f)); }
+  static int16_t clamp16(int32_t v) { return v < -32768 ? -32768 : (v > 32767 ? 32767 : (int16_t)v); }
+
+  int count = 0;
+  int32_t cosH = 0, sinH = 0, cosV = 0, sinV = 0;  // Q14
+  int32_t tsizeQ8 = 0;
+  uint32_t scaleQ16 = 0;
+  int16_t halfWidth = 0, halfHeight = 0;
+  int32_t ySin[MAX_COLS];  // Q22
+  int32_t yCos[MAX_COLS];
+};
+
+#endif // HECTOR_PROJECTION_H
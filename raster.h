@@ -0,0 +1,377 @@
+/*
+  Software rasterizer for Hector
+
+  Draws the surface primitives (lines, triangles, rectangles) into an
+  in-RAM RGB565 frame that is later pushed to the panel in one burst.
+  Pure C++ with no Arduino dependencies so it can be built on the host.
+
+  Pixels are stored byte-swapped (big-endian RGB565), which is the order
+  the ST7789 expects on the wire and the order M5Canvas/LGFX_Sprite use
+  for 16-bit buffers, so text can be drawn into the same memory.
+  Colors are passed in native RGB565 like M5.Display.color565() returns.
+*/
+
+#ifndef HECTOR_RASTER_H
+#define HECTOR_RASTER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+struct FrameBuffer {
+  uint16_t* pixels = nullptr;
+  int16_t width = 0;
+  int16_t height = 0;
+};
+
+inline uint16_t fbSwap565(uint16_t c) { return (uint16_t)((c >> 8) | (c << 8)); }
+
+inline uint32_t fbBytes(const FrameBuffer& fb) {
+  return (uint32_t)fb.width * fb.height * sizeof(uint16_t);
+}
+
+inline void fbClear(FrameBuffer& fb, uint16_t color) {
+  uint16_t c = fbSwap565(color);
+  uint32_t n = (uint32_t)fb.width * fb.height;
+  uint16_t* p = fb.pixels;
+  if ((c >> 8) == (c & 0xFF)) {
+    memset(p, c & 0xFF, n * sizeof(uint16_t));
+    return;
+  }
+  for (uint32_t i = 0; i < n; i++) p[i] = c;
+}
+
+// Clipped horizontal span, x0..x1 inclusive in either order
+inline void fbSpan(FrameBuffer& fb, int32_t x0, int32_t x1, int32_t y, uint16_t swapped) {
+  if (y < 0 || y >= fb.height) return;
+  if (x0 > x1) { int32_t t = x0; x0 = x1; x1 = t; }
+  if (x1 < 0 || x0 >= fb.width) return;
+  if (x0 < 0) x0 = 0;
+  if (x1 >= fb.width) x1 = fb.width - 1;
+  uint16_t* p = fb.pixels + (int32_t)y * fb.width + x0;
+  for (int32_t x = x0; x <= x1; x++) *p++ = swapped;
+}
+
+inline void fbPixel(FrameBuffer& fb, int32_t x, int32_t y, uint16_t color) {
+  if ((uint32_t)x >= (uint32_t)fb.width || (uint32_t)y >= (uint32_t)fb.height) return;
+  fb.pixels[y * fb.width + x] = fbSwap565(color);
+}
+
+// Bresenham line; pixels outside the frame are dropped
+inline void fbDrawLine(FrameBuffer& fb, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t color) {
+  uint16_t c = fbSwap565(color);
+  int32_t dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int32_t dy = y1 > y0 ? y0 - y1 : y1 - y0;
+  int32_t sx = x0 < x1 ? 1 : -1;
+  int32_t sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  const uint32_t w = fb.width, h = fb.height;
+  for (;;) {
+    if ((uint32_t)x0 < w && (uint32_t)y0 < h) fb.pixels[y0 * fb.width + x0] = c;
+    if (x0 == x1 && y0 == y1) break;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+inline void fbFillRect(FrameBuffer& fb, int32_t x, int32_t y, int32_t w, int32_t h, uint16_t color) {
+  uint16_t c = fbSwap565(color);
+  for (int32_t row = y; row < y + h; row++) fbSpan(fb, x, x + w - 1, row, c);
+}
+
+// Flat-top/flat-bottom split scanline fill with the same edge stepping as
+// the Adafruit/LovyanGFX fillTriangle, so frames match the direct path
+inline void fbFillTriangle(FrameBuffer& fb, int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                           int32_t x2, int32_t y2, uint16_t color) {
+  int32_t t;
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+  if (y1 > y2) { t = y2; y2 = y1; y1 = t; t = x2; x2 = x1; x1 = t; }
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+
+  uint16_t c = fbSwap565(color);
+
+  if (y0 == y2) { // degenerate: single span
+    int32_t a = x0, b = x0;
+    if (x1 < a) a = x1; else if (x1 > b) b = x1;
+    if (x2 < a) a = x2; else if (x2 > b) b = x2;
+    fbSpan(fb, a, b, y0, c);
+    return;
+  }
+
+  int32_t dx01 = x1 - x0, dy01 = y1 - y0;
+  int32_t dx02 = x2 - x0, dy02 = y2 - y0;
+  int32_t dx12 = x2 - x1, dy12 = y2 - y1;
+  int32_t sa = 0, sb = 0;
+
+  // Upper part includes y1 only when the lower part is flat
+  int32_t last = (y1 == y2) ? y1 : y1 - 1;
+  int32_t y = y0;
+  for (; y <= last; y++) {
+    int32_t a = x0 + sa / dy01;
+    int32_t b = x0 + sb / dy02;
+    sa += dx01;
+    sb += dx02;
+    fbSpan(fb, a, b, y, c);
+  }
+
+  sa = dx12 * (y - y1);
+  sb = dx02 * (y - y0);
+  for (; y <= y2; y++) {
+    int32_t a = x1 + sa / dy12;
+    int32_t b = x0 + sb / dy02;
+    sa += dx12;
+    sb += dx02;
+    fbSpan(fb, a, b, y, c);
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Solid surface fill
+// ---------------------------------------------------------------------------
+
+// Clip rectangle, inclusive on all sides
+struct FbClip {
+  int32_t left = 0;
+  int32_t top = 0;
+  int32_t right = -1;
+  int32_t bottom = -1;
+};
+
+#define FB_MAX_WIDTH  320
+#define FB_MAX_HEIGHT 240
+#define FB_COVERAGE_WORDS (FB_MAX_WIDTH / 32)
+
+// Per-scanline coverage, one bit per pixel. When strips arrive nearest
+// first, a covered pixel is hidden behind what has been drawn, so every
+// pixel is written at most once and fully covered 32-pixel runs of a span
+// are skipped with a single test.
+struct FbCoverage {
+  uint32_t bits[FB_MAX_HEIGHT][FB_COVERAGE_WORDS];
+  bool enabled = false;
+  uint32_t written = 0;  // pixels written since reset(), enabled or not
+
+  void reset(int32_t width, int32_t height, bool frontToBack) {
+    enabled = frontToBack && width <= FB_MAX_WIDTH && height <= FB_MAX_HEIGHT;
+    written = 0;
+    if (enabled) memset(bits, 0, height * sizeof(bits[0]));
+  }
+};
+
+// Pre-clipped span; with coverage enabled only uncovered pixels are
+// written, and they become covered
+inline void fbCoveredSpan(FrameBuffer& fb, FbCoverage* coverage, int32_t x0, int32_t x1, int32_t y,
+                          uint16_t swapped) {
+  uint16_t* p = fb.pixels + y * fb.width;
+  if (!coverage || !coverage->enabled) {
+    for (int32_t x = x0; x <= x1; x++) p[x] = swapped;
+    if (coverage && x1 >= x0) coverage->written += x1 - x0 + 1;
+    return;
+  }
+  uint32_t* row = coverage->bits[y];
+  for (int32_t w = x0 >> 5; w <= x1 >> 5; w++) {
+    const int32_t base = w << 5;
+    uint32_t mask = 0xFFFFFFFFu;
+    if (base < x0) mask &= 0xFFFFFFFFu << (x0 - base);
+    if (base + 31 > x1) mask &= 0xFFFFFFFFu >> (base + 31 - x1);
+
+    uint32_t open = mask & ~row[w];
+    if (!open) continue;
+    row[w] |= open;
+    coverage->written += __builtin_popcount(open);
+    if (open == mask) {
+      const int32_t end = base + 31 < x1 ? base + 31 : x1;
+      for (int32_t x = base > x0 ? base : x0; x <= end; x++) p[x] = swapped;
+    } else {
+      do {
+        p[base + __builtin_ctz(open)] = swapped;
+        open &= open - 1;
+      } while (open);
+    }
+  }
+}
+
+// Scanline triangle fill clipped to clip: only scanlines and columns
+// inside the rectangle are visited, so vertices far off screen cost
+// nothing and keep their true slopes. Spans cover the rounded edge
+// positions, inclusive.
+inline void fbFillTriangleClipped(FrameBuffer& fb, const FbClip& clip, FbCoverage* coverage,
+                                  int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                                  int32_t x2, int32_t y2, uint16_t color) {
+  int32_t t;
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+  if (y1 > y2) { t = y2; y2 = y1; y1 = t; t = x2; x2 = x1; x1 = t; }
+  if (y0 > y1) { t = y0; y0 = y1; y1 = t; t = x0; x0 = x1; x1 = t; }
+
+  if (y2 < clip.top || y0 > clip.bottom) return;
+  int32_t minX = x0 < x1 ? (x0 < x2 ? x0 : x2) : (x1 < x2 ? x1 : x2);
+  int32_t maxX = x0 > x1 ? (x0 > x2 ? x0 : x2) : (x1 > x2 ? x1 : x2);
+  if (maxX < clip.left || minX > clip.right) return;
+
+  uint16_t c = fbSwap565(color);
+  int32_t yStart = y0 > clip.top ? y0 : clip.top;
+  int32_t yEnd = y2 < clip.bottom ? y2 : clip.bottom;
+
+  if (y0 == y2) { // degenerate: single span
+    int32_t a = minX < clip.left ? clip.left : minX;
+    int32_t b = maxX > clip.right ? clip.right : maxX;
+    fbCoveredSpan(fb, coverage, a, b, y0, c);
+    return;
+  }
+
+  const float longSlope = (float)(x2 - x0) / (y2 - y0);
+  const float upperSlope = y1 != y0 ? (float)(x1 - x0) / (y1 - y0) : 0;
+  const float lowerSlope = y2 != y1 ? (float)(x2 - x1) / (y2 - y1) : 0;
+
+  for (int32_t y = yStart; y <= yEnd; y++) {
+    float xa = x0 + (y - y0) * longSlope;
+    float xb = y < y1 ? x0 + (y - y0) * upperSlope
+                      : (y2 != y1 ? x1 + (y - y1) * lowerSlope : (float)x1);
+    if (xa > xb) { float f = xa; xa = xb; xb = f; }
+    int32_t a = (int32_t)floorf(xa + 0.5f);
+    int32_t b = (int32_t)floorf(xb + 0.5f);
+    if (b < clip.left || a > clip.right) continue;
+    if (a < clip.left) a = clip.left;
+    if (b > clip.right) b = clip.right;
+    fbCoveredSpan(fb, coverage, a, b, y, c);
+  }
+}
+
+// One quad of a strip, split along the p0-p2 diagonal like the direct path
+inline void fbFillQuadClipped(FrameBuffer& fb, const FbClip& clip, FbCoverage* coverage,
+                              int32_t x0, int32_t y0, int32_t x1, int32_t y1,
+                              int32_t x2, int32_t y2, int32_t x3, int32_t y3, uint16_t color) {
+  fbFillTriangleClipped(fb, clip, coverage, x0, y0, x1, y1, x2, y2, color);
+  fbFillTriangleClipped(fb, clip, coverage, x0, y0, x2, y2, x3, y3, color);
+}
+
+// ---------------------------------------------------------------------------
+// Clipped polylines
+// ---------------------------------------------------------------------------
+
+// Cohen-Sutherland outcodes against an FbClip
+#define FB_OUT_LEFT   1
+#define FB_OUT_RIGHT  2
+#define FB_OUT_TOP    4
+#define FB_OUT_BOTTOM 8
+
+inline uint8_t fbOutcode(const FbClip& clip, int32_t x, int32_t y) {
+  uint8_t code = 0;
+  if (x < clip.left) code |= FB_OUT_LEFT;
+  else if (x > clip.right) code |= FB_OUT_RIGHT;
+  if (y < clip.top) code |= FB_OUT_TOP;
+  else if (y > clip.bottom) code |= FB_OUT_BOTTOM;
+  return code;
+}
+
+// Rounded a + b * n / d, d != 0
+inline int32_t fbLerpRound(int32_t a, int32_t b, int64_t n, int64_t d) {
+  int64_t num = (int64_t)b * n;
+  if (d < 0) { num = -num; d = -d; }
+  return a + (int32_t)(num >= 0 ? (num + d / 2) / d : -((-num + d / 2) / d));
+}
+
+// Clip the segment to clip in place; false if nothing of it is inside.
+// Endpoints moved onto the edge are rounded to the nearest pixel.
+inline bool fbClipLine(const FbClip& clip, int32_t& x0, int32_t& y0, int32_t& x1, int32_t& y1) {
+  uint8_t code0 = fbOutcode(clip, x0, y0);
+  uint8_t code1 = fbOutcode(clip, x1, y1);
+  for (;;) {
+    if (!(code0 | code1)) return true;
+    if (code0 & code1) return false;
+
+    const uint8_t out = code0 ? code0 : code1;
+    const int32_t dx = x1 - x0, dy = y1 - y0;
+    int32_t x, y;
+    if (out & FB_OUT_TOP) {
+      y = clip.top;
+      x = fbLerpRound(x0, dx, y - y0, dy);
+    } else if (out & FB_OUT_BOTTOM) {
+      y = clip.bottom;
+      x = fbLerpRound(x0, dx, y - y0, dy);
+    } else if (out & FB_OUT_LEFT) {
+      x = clip.left;
+      y = fbLerpRound(y0, dy, x - x0, dx);
+    } else {
+      x = clip.right;
+      y = fbLerpRound(y0, dy, x - x0, dx);
+    }
+    if (out == code0) {
+      x0 = x; y0 = y;
+      code0 = fbOutcode(clip, x0, y0);
+    } else {
+      x1 = x; y1 = y;
+      code1 = fbOutcode(clip, x1, y1);
+    }
+  }
+}
+
+// Bresenham between two points inside the frame, without bounds tests;
+// the first and last pixel can be left to the segments that share them.
+// Returns the pixels written.
+inline uint32_t fbSegment(FrameBuffer& fb, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t swapped,
+                          bool skipFirst, bool skipLast) {
+  int32_t dx = x1 > x0 ? x1 - x0 : x0 - x1;
+  int32_t dy = y1 > y0 ? y0 - y1 : y1 - y0;
+  int32_t sx = x0 < x1 ? 1 : -1;
+  int32_t sy = y0 < y1 ? 1 : -1;
+  int32_t err = dx + dy;
+  bool first = true;
+  uint32_t written = 0;
+  for (;;) {
+    const bool last = (x0 == x1 && y0 == y1);
+    if (!(first && skipFirst) && !(last && skipLast)) {
+      fb.pixels[y0 * fb.width + x0] = swapped;
+      written++;
+    }
+    if (last) return written;
+    first = false;
+    int32_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+// End of the polyline drawn so far: a segment that starts on the pixel
+// the previous one ended on does not draw it again if it already has the
+// segment's color. One of another color is drawn, so the later segment
+// wins the joint as it would drawn whole.
+struct FbPen {
+  bool down = false;
+  int32_t x = 0;
+  int32_t y = 0;
+  uint32_t written = 0;  // pixels written through this pen
+};
+
+// fbPolylineTo() result: which endpoints are now on screen
+#define FB_SEG_START 1
+#define FB_SEG_END   2
+
+// Extend the pen's polyline with one segment clipped to clip (which must
+// lie inside the frame). skipLast leaves the end pixel to another line
+// known to have drawn it in this color. A segment that is clipped away
+// lifts the pen.
+inline uint8_t fbPolylineTo(FrameBuffer& fb, const FbClip& clip, FbPen& pen,
+                            int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint16_t color,
+                            bool skipLast = false) {
+  int32_t cx0 = x0, cy0 = y0, cx1 = x1, cy1 = y1;
+  if (!fbClipLine(clip, cx0, cy0, cx1, cy1)) {
+    pen.down = false;
+    return 0;
+  }
+  const uint16_t swapped = fbSwap565(color);
+  const bool startKept = (cx0 == x0 && cy0 == y0);
+  const bool endKept = (cx1 == x1 && cy1 == y1);
+  const bool joined = pen.down && pen.x == cx0 && pen.y == cy0 && fb.pixels[cy0 * fb.width + cx0] == swapped;
+  const bool single = (cx0 == cx1 && cy0 == cy1);
+
+  if (!(single && (joined || (skipLast && endKept)))) {
+    pen.written += fbSegment(fb, cx0, cy0, cx1, cy1, swapped, joined, skipLast && endKept && !single);
+  }
+  pen.down = true;
+  pen.x = cx1;
+  pen.y = cy1;
+  return (startKept ? FB_SEG_START : 0) | (endKept ? FB_SEG_END : 0);
+}
+
+#endif // HECTOR_RASTER_H
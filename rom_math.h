@@ -0,0 +1,296 @@
+/*
+  ROM math engine for Hector
+
+  Table-driven replacements for the libm calls made by the surface
+  functions. The ESP32 FPU only does single precision, and the double
+  precision sin/cos/sqrt/log used so far run in software on every vertex.
+
+  Every function comes in two flavours:
+    - float : romSinF, romCosF, romSqrtF, romInvSqrtF, romLogF
+    - Q16.16: romSinQ16, romCosQ16, romSqrtQ16, romInvSqrtQ16, romLogQ16
+  plus romRecipU32, the integer reciprocal used by the fixed-point
+  projection.
+
+  Call romMathInit() once at boot before using any of them.
+
+  Error bounds (measured against libm double over the ranges used by the
+  surface functions, see each function for details):
+    romSinF / romCosF     |err| <= 5e-6            (|x| < 16)
+                          |err| <= 1.2e-5          (|x| < 128)
+                          |err| <= 9e-8 * |x|      (beyond)
+    romInvSqrtF           rel err <= 5e-6          (x > 0)
+    romSqrtF              rel err <= 5e-6          (x >= 0)
+    romLogF               |err| <= 9e-6            (1e-6 < x < 1e6)
+                          |err| <= 1.6e-5          (x > 0, normal floats)
+    romSinQ16 / romCosQ16 |err| <= 3.5e-5 (~2 LSB) (|x| < 256.0)
+    romSqrtQ16            |err| < 1 LSB            (x >= 0, exact floor)
+    romInvSqrtQ16         |err| <= 1 LSB           (x > 0)
+    romLogQ16             |err| <= 6e-5 (~4 LSB)   (x > 0)
+    romRecipU32           rel err <= 4e-6 + 1 LSB  (d >= 4)
+*/
+
+#ifndef HECTOR_ROM_MATH_H
+#define HECTOR_ROM_MATH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+typedef int32_t q16_t;
+
+#define Q16_ONE         65536
+#define Q16_FROM_FLOAT(f) ((q16_t)((f) * 65536.0f + ((f) >= 0 ? 0.5f : -0.5f)))
+#define Q16_TO_FLOAT(q) ((float)(q) * (1.0f / 65536.0f))
+
+// Quarter-wave sine table: 256 steps over [0, pi/2] plus a guard entry
+#define ROM_SIN_BITS    8
+#define ROM_SIN_QUARTER (1 << ROM_SIN_BITS)
+#define ROM_SIN_PERIOD  (4 * ROM_SIN_QUARTER)
+
+// log2(1 + m) over the mantissa, 128 steps plus a guard entry
+#define ROM_LOG_BITS    7
+#define ROM_LOG_SIZE    (1 << ROM_LOG_BITS)
+
+// 1/m for m in [0.5, 1), 256 steps, in Q30
+#define ROM_RECIP_BITS  8
+#define ROM_RECIP_SIZE  (1 << ROM_RECIP_BITS)
+
+// 1/sqrt(m) for m in [0.25, 1), in Q30: the top 8 bits of m run 64..255
+#define ROM_RSQRT_BITS  8
+#define ROM_RSQRT_FIRST (1 << (ROM_RSQRT_BITS - 2))
+#define ROM_RSQRT_SIZE  ((1 << ROM_RSQRT_BITS) - ROM_RSQRT_FIRST)
+
+// Table phase units per radian: ROM_SIN_PERIOD / (2 * pi)
+#define ROM_PHASE_PER_RAD      162.97466172610083f
+#define ROM_PHASE_PER_RAD_Q16  10680707  // round(162.9746617 * 65536)
+#define ROM_LN2_F              0.69314718055994531f
+#define ROM_LN2_Q16            45426     // round(ln(2) * 65536)
+
+// Templated so the tables are shared by every translation unit that
+// includes this header without needing a separate .cpp file
+template <typename T = void>
+struct RomMathTables {
+  static float sinF[ROM_SIN_QUARTER + 1];
+  static q16_t sinQ16[ROM_SIN_QUARTER + 1];
+  static float log2F[ROM_LOG_SIZE + 1];
+  static q16_t log2Q16[ROM_LOG_SIZE + 1];
+  static uint32_t recipQ30[ROM_RECIP_SIZE];
+  static uint32_t rsqrtQ30[ROM_RSQRT_SIZE];
+};
+
+template <typename T> float RomMathTables<T>::sinF[ROM_SIN_QUARTER + 1];
+template <typename T> q16_t RomMathTables<T>::sinQ16[ROM_SIN_QUARTER + 1];
+template <typename T> float RomMathTables<T>::log2F[ROM_LOG_SIZE + 1];
+template <typename T> q16_t RomMathTables<T>::log2Q16[ROM_LOG_SIZE + 1];
+template <typename T> uint32_t RomMathTables<T>::recipQ30[ROM_RECIP_SIZE];
+template <typename T> uint32_t RomMathTables<T>::rsqrtQ30[ROM_RSQRT_SIZE];
+
+typedef RomMathTables<> RomTables;
+
+inline void romMathInit() {
+  for (int i = 0; i <= ROM_SIN_QUARTER; i++) {
+    double s = sin(i * (M_PI / 2) / ROM_SIN_QUARTER);
+    RomTables::sinF[i] = (float)s;
+    RomTables::sinQ16[i] = (q16_t)lround(s * 65536.0);
+  }
+  for (int i = 0; i <= ROM_LOG_SIZE; i++) {
+    double l = log2(1.0 + (double)i / ROM_LOG_SIZE);
+    RomTables::log2F[i] = (float)l;
+    RomTables::log2Q16[i] = (q16_t)lround(l * 65536.0);
+  }
+  for (int i = 0; i < ROM_RECIP_SIZE; i++) {
+    // Midpoint of each interval, so the seed error is at most half a step
+    double m = (ROM_RECIP_SIZE + i + 0.5) / (2.0 * ROM_RECIP_SIZE);
+    RomTables::recipQ30[i] = (uint32_t)lround(1073741824.0 / m);
+  }
+  for (int i = 0; i < ROM_RSQRT_SIZE; i++) {
+    double m = (ROM_RSQRT_FIRST + i + 0.5) / (1 << ROM_RSQRT_BITS);
+    RomTables::rsqrtQ30[i] = (uint32_t)lround(1073741824.0 / sqrt(m));
+  }
+}
+
+// ---------------------------------------------------------------------------
+// Sine / cosine
+// ---------------------------------------------------------------------------
+
+// Look up sin() for a phase given as an integer table index (any value,
+// wraps every ROM_SIN_PERIOD) plus a [0, 1) fraction towards the next index
+inline float romSinPhaseF(int32_t phase, float frac) {
+  uint32_t i = (uint32_t)phase & (ROM_SIN_PERIOD - 1);
+  uint32_t j = i & (ROM_SIN_QUARTER - 1);
+  const float* t = RomTables::sinF;
+  float a, b;
+  if (i & ROM_SIN_QUARTER) { // falling quarter mirrors the rising one
+    a = t[ROM_SIN_QUARTER - j];
+    b = t[ROM_SIN_QUARTER - j - 1];
+  } else {
+    a = t[j];
+    b = t[j + 1];
+  }
+  float v = a + (b - a) * frac;
+  return (i & (2 * ROM_SIN_QUARTER)) ? -v : v;
+}
+
+inline q16_t romSinPhaseQ16(int32_t phase, uint32_t frac16) {
+  uint32_t i = (uint32_t)phase & (ROM_SIN_PERIOD - 1);
+  uint32_t j = i & (ROM_SIN_QUARTER - 1);
+  const q16_t* t = RomTables::sinQ16;
+  q16_t a, b;
+  if (i & ROM_SIN_QUARTER) {
+    a = t[ROM_SIN_QUARTER - j];
+    b = t[ROM_SIN_QUARTER - j - 1];
+  } else {
+    a = t[j];
+    b = t[j + 1];
+  }
+  // |b - a| <= 403 so the product stays well inside 32 bits
+  q16_t v = a + (((b - a) * (int32_t)frac16) >> 16);
+  return (i & (2 * ROM_SIN_QUARTER)) ? -v : v;
+}
+
+// Linear interpolation error is h^2/8 with h = pi/512, i.e. 4.7e-6.
+// For larger |x| the rounding of the float phase product dominates and
+// the error grows to roughly 9e-8 * |x|.
+inline float romSinF(float x) {
+  float p = x * ROM_PHASE_PER_RAD;
+  int32_t i = (int32_t)p;
+  if (p < (float)i) i--; // floor for negative phases
+  return romSinPhaseF(i, p - (float)i);
+}
+
+inline float romCosF(float x) {
+  float p = x * ROM_PHASE_PER_RAD;
+  int32_t i = (int32_t)p;
+  if (p < (float)i) i--;
+  return romSinPhaseF(i + ROM_SIN_QUARTER, p - (float)i);
+}
+
+// x in Q16.16 radians, result in Q16.16. The 64-bit phase product keeps
+// the full input range; error is interpolation + 1 LSB table rounding.
+inline q16_t romSinQ16(q16_t x) {
+  int64_t p = ((int64_t)x * ROM_PHASE_PER_RAD_Q16) >> 16;
+  return romSinPhaseQ16((int32_t)(p >> 16), (uint32_t)p & 0xFFFF);
+}
+
+inline q16_t romCosQ16(q16_t x) {
+  int64_t p = ((int64_t)x * ROM_PHASE_PER_RAD_Q16) >> 16;
+  return romSinPhaseQ16((int32_t)(p >> 16) + ROM_SIN_QUARTER, (uint32_t)p & 0xFFFF);
+}
+
+// ---------------------------------------------------------------------------
+// Square root
+// ---------------------------------------------------------------------------
+
+// Bit-trick seed refined by two Newton steps (relative error ~4.7e-6)
+inline float romInvSqrtF(float x) {
+  uint32_t i;
+  memcpy(&i, &x, sizeof(i));
+  i = 0x5F375A86 - (i >> 1);
+  float y;
+  memcpy(&y, &i, sizeof(y));
+  float hx = 0.5f * x;
+  y = y * (1.5f - hx * y * y);
+  y = y * (1.5f - hx * y * y);
+  return y;
+}
+
+// Returns 0 for x <= 0 instead of NaN
+inline float romSqrtF(float x) {
+  if (x <= 0) return 0;
+  return x * romInvSqrtF(x);
+}
+
+// One Newton step r = r * (3 - m * r^2) / 2 towards 1/sqrt(m), r in Q30
+// and m = n / 2^32 in [0.25, 1); it squares the relative error
+inline uint32_t romInvSqrtStep(uint32_t n, uint32_t r) {
+  uint32_t r2 = (uint32_t)(((uint64_t)r * r) >> 32);          // r^2 in Q28
+  uint32_t mr2 = (uint32_t)(((uint64_t)n * r2) >> 32);        // m * r^2 in Q28
+  return (uint32_t)(((uint64_t)r * ((3u << 28) - mr2)) >> 29);
+}
+
+// 1/sqrt(m) in Q30 after one step from the table seed picked by the top 8
+// bits of n: error <= 4e-3, then ~2.3e-5
+inline uint32_t romInvSqrtSeed(uint32_t n) {
+  return romInvSqrtStep(n, RomTables::rsqrtQ30[(n >> (32 - ROM_RSQRT_BITS)) - ROM_RSQRT_FIRST]);
+}
+
+// Exact floor(sqrt(x)) in Q16.16. The leading one is normalised to an even
+// shift, s = m * r estimates sqrt(m), and a Newton step on the root,
+// s + r * (m - s^2) / 2, squares its error again. The root is then within
+// one of the floor either way; a square against x * 2^16 settles it.
+inline q16_t romSqrtQ16(q16_t x) {
+  if (x <= 0) return 0;
+  int shift = __builtin_clz((uint32_t)x) & ~1;
+  uint32_t n = (uint32_t)x << shift;                               // m in [0.25, 1)
+  uint32_t r = romInvSqrtSeed(n);
+  uint32_t s = (uint32_t)(((uint64_t)n * r) >> 32);                // sqrt(m) in Q30
+  int32_t d = (int32_t)(n - (uint32_t)(((uint64_t)s * s) >> 28));  // m - s^2 in Q32
+  s += (int32_t)(((int64_t)r * d) >> 33);                          // Q30
+  uint32_t res = s >> (6 + shift / 2);
+  uint64_t v = (uint64_t)x << 16;
+  res -= (uint64_t)res * res > v;  // no branches: either way is as likely
+  res += (uint64_t)(res + 1) * (res + 1) <= v;
+  return (q16_t)res;
+}
+
+// x in Q16.16, result in Q16.16. x <= 0 returns INT32_MAX.
+inline q16_t romInvSqrtQ16(q16_t x) {
+  if (x <= 0) return INT32_MAX;
+  int shift = __builtin_clz((uint32_t)x) & ~1;
+  uint32_t n = (uint32_t)x << shift;
+  return (q16_t)(romInvSqrtStep(n, romInvSqrtSeed(n)) >> (22 - shift / 2));
+}
+
+// ---------------------------------------------------------------------------
+// Natural logarithm
+// ---------------------------------------------------------------------------
+
+// Exponent from the float bits, mantissa from the interpolated log2 table.
+// Interpolation error h^2/8 / ln(2) in log2 units = 1.1e-5, times ln(2),
+// plus the float rounding of exponent + mantissa, which grows with |e|.
+// Domain x > 0 and normal; x <= 0 returns -HUGE_VALF.
+inline float romLogF(float x) {
+  if (x <= 0) return -HUGE_VALF;
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int32_t e = (int32_t)((bits >> 23) & 0xFF) - 127;
+  uint32_t m = bits & 0x7FFFFF;
+  uint32_t j = m >> (23 - ROM_LOG_BITS);
+  float frac = (float)(m & ((1 << (23 - ROM_LOG_BITS)) - 1)) * (1.0f / (1 << (23 - ROM_LOG_BITS)));
+  const float* t = RomTables::log2F;
+  float l2 = (float)e + t[j] + (t[j + 1] - t[j]) * frac;
+  return l2 * ROM_LN2_F;
+}
+
+// x in Q16.16, result in Q16.16. x <= 0 returns INT32_MIN.
+inline q16_t romLogQ16(q16_t x) {
+  if (x <= 0) return INT32_MIN;
+  int msb = 31 - __builtin_clz((uint32_t)x);
+  // Normalise to a 23-bit mantissa below the leading one, as in a float
+  uint32_t m = msb >= 23 ? ((uint32_t)x >> (msb - 23)) : ((uint32_t)x << (23 - msb));
+  m &= 0x7FFFFF;
+  uint32_t j = m >> (23 - ROM_LOG_BITS);
+  uint32_t frac16 = m & 0xFFFF; // 23 - ROM_LOG_BITS == 16
+  const q16_t* t = RomTables::log2Q16;
+  int32_t l2 = (int32_t)(msb - 16) * 65536 + t[j] + (((t[j + 1] - t[j]) * (int32_t)frac16) >> 16);
+  return (q16_t)(((int64_t)l2 * ROM_LN2_Q16) >> 16);
+}
+
+// ---------------------------------------------------------------------------
+// Reciprocal
+// ---------------------------------------------------------------------------
+
+// Approximately 2^32 / d for d >= 4. The leading one is normalised away,
+// the next 8 bits pick a table seed (error <= 2e-3) and one Newton step
+// r = r * (2 - m * r) squares the error. No divide instruction needed.
+inline uint32_t romRecipU32(uint32_t d) {
+  if (d < 4) return 0xFFFFFFFFu;
+  int shift = __builtin_clz(d);
+  uint32_t n = d << shift;  // m = n / 2^32 in [0.5, 1)
+  uint32_t r = RomTables::recipQ30[(n >> (31 - ROM_RECIP_BITS)) & (ROM_RECIP_SIZE - 1)];
+  uint32_t e = (uint32_t)(((uint64_t)n * r) >> 32);          // m * r in Q30
+  r = (uint32_t)(((uint64_t)r * ((1u << 31) - e)) >> 30);    // Q30
+  return r >> (30 - shift);
+}
+
+#endif // HECTOR_ROM_MATH_H
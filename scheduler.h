@@ -0,0 +1,224 @@
+/*
+  Frame scheduler for Hector
+
+  Replaces the fixed delay at the end of loop() and the millis() checks
+  inside the sensor reads:
+
+    - FixedStepClock: advances the animation in fixed steps of simulated
+      time, so the surfaces move at the same speed at any frame rate
+    - PeriodicJob: a function run every period (buttons, IMU, audio),
+      independent of the frame rate, with its lateness and missed
+      deadlines measured
+    - FramePacer: starts frames on a fixed grid of slots at the target
+      rate, vsync style; a late frame starts at once and the grid
+      resyncs instead of bursting to catch up
+    - Scheduler: runs the due jobs and sleeps until the next job or frame
+
+  All times are 32-bit microseconds compared with wrapping arithmetic.
+  The clock is a pair of function pointers, so the host can drive the
+  scheduler from a fake clock. Pure C++ with no Arduino dependencies.
+*/
+
+#ifndef HECTOR_SCHEDULER_H
+#define HECTOR_SCHEDULER_H
+
+#include <stdint.h>
+
+typedef uint32_t (*SchedulerNowFn)();
+typedef void (*SchedulerSleepFn)(uint32_t us);
+typedef void (*SchedulerJobFn)();
+
+struct SchedulerClock {
+  SchedulerNowFn now = nullptr;
+  SchedulerSleepFn sleep = nullptr;
+};
+
+// a - b for timestamps less than 2^31 us apart
+inline int32_t schedulerElapsed(uint32_t a, uint32_t b) { return (int32_t)(a - b); }
+
+class FixedStepClock {
+public:
+  // maxSteps bounds the catch-up after a stall (pause, slow frame)
+  void begin(uint32_t stepMicros, int maxSteps = 8) {
+    stepUs = stepMicros;
+    stepLimit = maxSteps;
+    started = false;
+    total = 0;
+    carryUs = 0;
+  }
+
+  // Steps due since the last call; the first call only starts the clock
+  int advance(uint32_t nowUs) {
+    if (!started) {
+      started = true;
+      lastUs = nowUs;
+      return 0;
+    }
+    carryUs += (uint32_t)schedulerElapsed(nowUs, lastUs);
+    lastUs = nowUs;
+
+    uint32_t steps = carryUs / stepUs;
+    carryUs -= steps * stepUs;
+    if (steps > (uint32_t)stepLimit) steps = stepLimit;  // drop the rest of a stall
+    total += steps;
+    return (int)steps;
+  }
+
+  // Fraction of the next step already elapsed, for interpolation
+  float alpha() const { return stepUs ? (float)carryUs / stepUs : 0; }
+
+  uint32_t steps() const { return total; }
+  uint32_t stepMicros() const { return stepUs; }
+
+private:
+  uint32_t stepUs = 33333;
+  int stepLimit = 8;
+  bool started = false;
+  uint32_t lastUs = 0;
+  uint32_t carryUs = 0;
+  uint32_t total = 0;
+};
+
+class PeriodicJob {
+public:
+  void begin(const char* jobName, SchedulerJobFn jobFn, uint32_t periodMicros, uint32_t nowUs) {
+    name = jobName;
+    fn = jobFn;
+    periodUs = periodMicros;
+    dueUs = nowUs;
+    clearStats();
+  }
+
+  // Run the job if it is due. A run more than a period after its due time
+  // has missed its deadline; the periods it skipped are not made up.
+  bool poll(uint32_t nowUs) {
+    int32_t late = schedulerElapsed(nowUs, dueUs);
+    if (late < 0) return false;
+
+    fn();
+    runs++;
+    if ((uint32_t)late > maxLateUs) maxLateUs = late;
+    if ((uint32_t)late >= periodUs) {
+      misses++;
+      dueUs = nowUs + periodUs;
+    } else {
+      dueUs += periodUs;
+    }
+    return true;
+  }
+
+  uint32_t nextDue() const { return dueUs; }
+
+  // Runs, misses and worst lateness since the last call, then reset
+  void takeStats(uint32_t& runCount, uint32_t& missCount, uint32_t& lateUs) {
+    runCount = runs;
+    missCount = misses;
+    lateUs = maxLateUs;
+    clearStats();
+  }
+
+  const char* name = "";
+
+private:
+  void clearStats() {
+    runs = 0;
+    misses = 0;
+    maxLateUs = 0;
+  }
+
+  SchedulerJobFn fn = nullptr;
+  uint32_t periodUs = 0;
+  uint32_t dueUs = 0;
+  uint32_t runs = 0;
+  uint32_t misses = 0;
+  uint32_t maxLateUs = 0;
+};
+
+class FramePacer {
+public:
+  void begin(uint32_t periodMicros, uint32_t nowUs) {
+    periodUs = periodMicros;
+    slotUs = nowUs;
+    overruns = 0;
+  }
+
+  bool due(uint32_t nowUs) const { return schedulerElapsed(nowUs, slotUs) >= 0; }
+
+  // A frame starts now: book the next slot
+  void start(uint32_t nowUs) {
+    if (schedulerElapsed(nowUs, slotUs) >= (int32_t)periodUs) {
+      overruns++;
+      slotUs = nowUs + periodUs;
+    } else {
+      slotUs += periodUs;
+    }
+  }
+
+  uint32_t nextDue() const { return slotUs; }
+  uint32_t period() const { return periodUs; }
+
+  // Frames that started a whole period late, since the last call
+  uint32_t takeOverruns() {
+    uint32_t n = overruns;
+    overruns = 0;
+    return n;
+  }
+
+private:
+  uint32_t periodUs = 33333;
+  uint32_t slotUs = 0;
+  uint32_t overruns = 0;
+};
+
+template <int MAX_JOBS>
+class Scheduler {
+public:
+  void begin(const SchedulerClock& c, uint32_t targetFps) {
+    clock = c;
+    jobCount = 0;
+    pacer.begin(1000000 / targetFps, clock.now());
+  }
+
+  bool addJob(const char* name, SchedulerJobFn fn, uint32_t periodUs) {
+    if (jobCount >= MAX_JOBS) return false;
+    jobs[jobCount++].begin(name, fn, periodUs, clock.now());
+    return true;
+  }
+
+  // New target rate; the next frame is due at once
+  void setFrameRate(uint32_t targetFps) { pacer.begin(1000000 / targetFps, clock.now()); }
+
+  // Run every due job, then return true if a frame should start now.
+  // Otherwise sleep until the next job or frame slot and return false.
+  bool waitForFrame() {
+    uint32_t now = clock.now();
+    for (int i = 0; i < jobCount; i++) jobs[i].poll(now);
+
+    now = clock.now();
+    if (pacer.due(now)) {
+      pacer.start(now);
+      return true;
+    }
+
+    uint32_t next = pacer.nextDue();
+    for (int i = 0; i < jobCount; i++) {
+      if (schedulerElapsed(jobs[i].nextDue(), next) < 0) next = jobs[i].nextDue();
+    }
+    int32_t wait = schedulerElapsed(next, now);
+    if (wait > 0 && clock.sleep) clock.sleep((uint32_t)wait);
+    return false;
+  }
+
+  int count() const { return jobCount; }
+  PeriodicJob& job(int i) { return jobs[i]; }
+  FramePacer& frames() { return pacer; }
+  uint32_t now() const { return clock.now(); }
+
+private:
+  SchedulerClock clock;
+  PeriodicJob jobs[MAX_JOBS];
+  int jobCount = 0;
+  FramePacer pacer;
+};
+
+#endif // HECTOR_SCHEDULER_H
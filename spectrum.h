@@ -0,0 +1,163 @@
+/*
+  Spectrum analysis for Hector
+
+  Fixed-size radix-2 FFT with precomputed twiddle, bit-reversal and Hann
+  window tables, followed by log-frequency band binning with per-band
+  attack/decay smoothing. Everything lives in fixed arrays sized by the
+  template parameter: nothing is allocated after begin().
+
+  Pure C++ with no Arduino dependencies, like audio_analysis.h.
+*/
+
+#ifndef HECTOR_SPECTRUM_H
+#define HECTOR_SPECTRUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#define SPECTRUM_BANDS      16
+#define SPECTRUM_MIN_HZ     60.0f
+#define SPECTRUM_FLOOR_DB   -70.0f  // maps to band level 0
+#define SPECTRUM_RANGE_DB   60.0f   // floor + range maps to band level 1
+
+struct SpectrumBands {
+  float level[SPECTRUM_BANDS] = {};  // smoothed, 0..1, lowest band first
+};
+
+template <size_t N>
+class FFT {
+public:
+  static_assert(N >= 8 && (N & (N - 1)) == 0, "FFT size must be a power of two");
+
+  void begin() {
+    int bits = 0;
+    while ((1u << bits) < N) bits++;
+    for (size_t i = 0; i < N; i++) {
+      uint32_t r = 0;
+      for (int b = 0; b < bits; b++) r |= ((i >> b) & 1u) << (bits - 1 - b);
+      bitrev[i] = (uint16_t)r;
+    }
+    for (size_t i = 0; i < N / 2; i++) {
+      double a = -2.0 * M_PI * i / N;
+      twiddleRe[i] = (float)cos(a);
+      twiddleIm[i] = (float)sin(a);
+    }
+    for (size_t i = 0; i < N; i++) {
+      window[i] = (float)(0.5 - 0.5 * cos(2.0 * M_PI * i / (N - 1)));
+    }
+  }
+
+  // Window the samples and transform them into re/im (N entries each)
+  void forward(const int16_t* samples, float* re, float* im) const {
+    for (size_t i = 0; i < N; i++) {
+      size_t j = bitrev[i];
+      re[j] = samples[i] * window[i];
+      im[j] = 0;
+    }
+
+    for (size_t len = 2; len <= N; len <<= 1) {
+      size_t half = len >> 1;
+      size_t stride = N / len;
+      for (size_t start = 0; start < N; start += len) {
+        for (size_t j = 0; j < half; j++) {
+          float wr = twiddleRe[j * stride];
+          float wi = twiddleIm[j * stride];
+          size_t a = start + j;
+          size_t b = a + half;
+          float tr = re[b] * wr - im[b] * wi;
+          float ti = re[b] * wi + im[b] * wr;
+          re[b] = re[a] - tr;
+          im[b] = im[a] - ti;
+          re[a] += tr;
+          im[a] += ti;
+        }
+      }
+    }
+  }
+
+  // Sum of the window, to normalise magnitudes back to sample units
+  float windowGain() const { return N / 2.0f; }
+
+private:
+  uint16_t bitrev[N];
+  float twiddleRe[N / 2];
+  float twiddleIm[N / 2];
+  float window[N];
+};
+
+template <size_t N>
+class SpectrumAnalyzer {
+public:
+  static_assert(N / 2 > SPECTRUM_BANDS, "FFT size must give every band a bin");
+
+  // attackMs/decayMs are the smoothing time constants for rising and
+  // falling band levels, at one analyze() call every hopMs
+  void begin(float sampleRate, float hopMs, float attackMs = 15.0f, float decayMs = 250.0f) {
+    fft.begin();
+
+    // Log-spaced band edges from SPECTRUM_MIN_HZ up to Nyquist, at least
+    // one FFT bin wide each: every edge leaves a bin for each band above
+    // it, and the last band always ends at N / 2
+    float nyquist = sampleRate / 2;
+    float ratio = powf(nyquist / SPECTRUM_MIN_HZ, 1.0f / SPECTRUM_BANDS);
+    float binHz = sampleRate / N;
+    size_t prev = (size_t)(SPECTRUM_MIN_HZ / binHz);
+    if (prev < 1) prev = 1;
+    if (prev > N / 2 - SPECTRUM_BANDS) prev = N / 2 - SPECTRUM_BANDS;
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+      size_t edge = (size_t)(SPECTRUM_MIN_HZ * powf(ratio, b + 1) / binHz);
+      size_t last = N / 2 - (SPECTRUM_BANDS - 1 - b);
+      if (edge <= prev) edge = prev + 1;
+      if (edge > last || b == SPECTRUM_BANDS - 1) edge = last;
+      bandStart[b] = (uint16_t)prev;
+      bandEnd[b] = (uint16_t)edge;
+      prev = edge;
+    }
+
+    attack = 1.0f - expf(-hopMs / attackMs);
+    decay = 1.0f - expf(-hopMs / decayMs);
+    bands = SpectrumBands();
+  }
+
+  // Analyse the newest N samples and update the smoothed band levels
+  const SpectrumBands& analyze(const int16_t* samples) {
+    fft.forward(samples, re, im);
+
+    const float norm = 1.0f / (fft.windowGain() * 32768.0f);
+    for (int b = 0; b < SPECTRUM_BANDS; b++) {
+      float sum = 0;
+      size_t count = 0;
+      for (size_t i = bandStart[b]; i < bandEnd[b]; i++, count++) {
+        sum += re[i] * re[i] + im[i] * im[i];
+      }
+      float mag = count ? sqrtf(sum / count) * norm : 0;
+      float db = 20.0f * log10f(mag + 1e-9f);
+      float target = (db - SPECTRUM_FLOOR_DB) / SPECTRUM_RANGE_DB;
+      if (target < 0) target = 0;
+      if (target > 1) target = 1;
+
+      float& level = bands.level[b];
+      level += (target - level) * (target > level ? attack : decay);
+    }
+    return bands;
+  }
+
+  const SpectrumBands& levels() const { return bands; }
+
+  // FFT bins [start, end) summed into band b
+  size_t bandFirstBin(int b) const { return bandStart[b]; }
+  size_t bandEndBin(int b) const { return bandEnd[b]; }
+
+private:
+  FFT<N> fft;
+  float re[N];
+  float im[N];
+  uint16_t bandStart[SPECTRUM_BANDS];
+  uint16_t bandEnd[SPECTRUM_BANDS];
+  float attack = 0.5f;
+  float decay = 0.1f;
+  SpectrumBands bands;
+};
+
+#endif // HECTOR_SPECTRUM_H
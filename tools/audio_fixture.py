@@ -0,0 +1,50 @@
+#!/usr/bin/env python3
+"""Write the known-RMS microphone fixture for the native bench.
+
+native/fixtures/rms_tones.wav is 44.1 kHz mono 16-bit PCM, three stretches
+of 4096 samples on a DC offset of 1000, as the microphone shows one:
+
+    a sine of amplitude 8000, 8 periods per 512 samples  RMS 5656.9
+    a square wave of +-3000, period 100 samples          RMS 3000
+    a sine of amplitude 200, below the noise gate        RMS 141.4
+
+The sines fit the analyzer's 512-sample window exactly and the square is
++-3000 at every sample, so the window RMS is the same wherever it falls.
+"program --audio" feeds the file through AudioAnalyzer in DMA buffers and
+checks power, peak, DC offset and level against these numbers.
+
+    python3 tools/audio_fixture.py [-o native/fixtures/rms_tones.wav]
+"""
+
+import argparse
+import math
+import struct
+import wave
+
+RATE = 44100
+DC = 1000
+STRETCH = 4096
+
+
+def samples():
+    for i in range(STRETCH):
+        yield DC + round(8000 * math.sin(2 * math.pi * 8 * i / 512))
+    for i in range(STRETCH):
+        yield DC + (3000 if (i // 50) % 2 == 0 else -3000)
+    for i in range(STRETCH):
+        yield DC + round(200 * math.sin(2 * math.pi * 8 * i / 512))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("-o", "--output", default="native/fixtures/rms_tones.wav")
+    args = parser.parse_args()
+    with wave.open(args.output, "wb") as w:
+        w.setnchannels(1)
+        w.setsampwidth(2)
+        w.setframerate(RATE)
+        w.writeframes(b"".join(struct.pack("<h", s) for s in samples()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Compare Hector's specialized kernels with the generic loops.
+
+Builds the native bench twice, with -DHECTOR_KERNELS=0 (a display switch
+per vertex) and =1 (the strip kernels), runs both on every mode and prints
+the compute and render time per frame side by side; the surfaces are row
+functions in both builds, so compute only differs by noise. The runs alternate between the two builds and
+the fastest of --runs is kept, which is what survives a noisy host.
+
+The code size cost is the difference in .text, plus the size of every
+kernel instantiation. --device builds the esp32dev firmware both ways with
+PlatformIO and compares the firmware the same way.
+
+    python3 tools/kernel_bench.py [--frames 500] [--runs 3] [--wave SINE]
+    python3 tools/kernel_bench.py --device
+"""
+
+import argparse
+import csv
+import io
+import os
+import re
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+# The same flags as [env:native] in platformio.ini
+NATIVE_FLAGS = ["-std=gnu++11", "-O2", "-ftree-vectorize", "-I.", "-Inative/hal", "-DHECTOR_LOD=0", "-pthread"]
+KERNEL_SYMBOL = re.compile(r"drawStrip<")
+
+
+def build_native(args, kernels):
+    out = os.path.join(args.build, "bench%d" % kernels)
+    cmd = [args.cxx] + NATIVE_FLAGS + ["-DHECTOR_KERNELS=%d" % kernels,
+                                       "native/bench.cpp", "native/hal.cpp", "-o", out]
+    subprocess.check_call(cmd, cwd=ROOT)
+    return out
+
+
+def run_bench(program, args):
+    cmd = [program, "--frames", str(args.frames), "--csv"]
+    if args.wave:
+        cmd += ["--wave", args.wave]
+    if args.display:
+        cmd += ["--display", args.display]
+    text = subprocess.check_output(cmd, cwd=ROOT, universal_newlines=True)
+    return {(r["wave"], r["display"]): r for r in csv.DictReader(io.StringIO(text))}
+
+
+def fastest(runs):
+    best = {}
+    for run in runs:
+        for mode, r in run.items():
+            c, d = float(r["compute_us"]), float(r["render_us"])
+            old = best.get(mode, (c, d))
+            best[mode] = (min(old[0], c), min(old[1], d))
+    return best
+
+
+def text_size(binary, size_tool):
+    out = subprocess.check_output([size_tool, binary], universal_newlines=True)
+    return int(out.splitlines()[1].split()[0])
+
+
+def kernel_symbols(binary, nm_tool):
+    out = subprocess.check_output([nm_tool, "-C", "--size-sort", binary], universal_newlines=True)
+    sizes = []
+    for line in out.splitlines():
+        parts = line.split(None, 2)  # size, type, name
+        if len(parts) == 3 and parts[1] in "tTwW" and KERNEL_SYMBOL.search(parts[2]):
+            sizes.append((int(parts[0], 16), parts[2]))
+    return sizes
+
+
+def report_size(label, generic, kernels, nm_tool, size_tool):
+    g, k = text_size(generic, size_tool), text_size(kernels, size_tool)
+    print("\n%s .text: generic %d bytes, kernels %d bytes (%+d)" % (label, g, k, k - g))
+    symbols = kernel_symbols(kernels, nm_tool)
+    for size, name in sorted(symbols, key=lambda s: s[1]):
+        print("  %6d  %s" % (size, name))
+    print("  %6d  total in %d kernels" % (sum(s for s, _ in symbols), len(symbols)))
+
+
+def device(args):
+    elf = os.path.join(ROOT, ".pio", "build", args.env, "firmware.elf")
+    images = []
+    for kernels in (0, 1):
+        env = dict(os.environ, PLATFORMIO_BUILD_FLAGS="-DHECTOR_KERNELS=%d" % kernels)
+        subprocess.check_call(["pio", "run", "-e", args.env], cwd=ROOT, env=env)
+        saved = os.path.join(args.build, "firmware%d.elf" % kernels)
+        with open(elf, "rb") as src, open(saved, "wb") as dst:
+            dst.write(src.read())
+        images.append(saved)
+    report_size(args.env, images[0], images[1], args.device_nm, args.device_size)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("--frames", type=int, default=500)
+    ap.add_argument("--runs", type=int, default=3, help="runs per build, the fastest is kept")
+    ap.add_argument("--wave")
+    ap.add_argument("--display")
+    ap.add_argument("--cxx", default="g++")
+    ap.add_argument("--build", default=os.path.join(ROOT, ".pio", "kernel_bench"))
+    ap.add_argument("--device", action="store_true", help="also compare the esp32dev firmware")
+    ap.add_argument("--env", default="esp32dev")
+    ap.add_argument("--device-nm", default="xtensa-esp32-elf-nm")
+    ap.add_argument("--device-size", default="xtensa-esp32-elf-size")
+    args = ap.parse_args()
+
+    os.makedirs(args.build, exist_ok=True)
+    programs = [build_native(args, kernels) for kernels in (0, 1)]
+    runs = ([], [])
+    for _ in range(args.runs):
+        for kernels in (0, 1):
+            runs[kernels].append(run_bench(programs[kernels], args))
+    generic, kernels = fastest(runs[0]), fastest(runs[1])
+
+    print("%-16s %20s %20s %8s" % ("mode", "compute us", "render us", "frame"))
+    print("%-16s %9s %10s %9s %10s %8s" % ("", "generic", "kernel", "generic", "kernel", "speedup"))
+    total = [0.0, 0.0]
+    for mode in generic:
+        (c0, r0), (c1, r1) = generic[mode], kernels[mode]
+        total[0] += c0 + r0
+        total[1] += c1 + r1
+        print("%-16s %9.1f %10.1f %9.1f %10.1f %7.2fx" % ("/".join(mode), c0, c1, r0, r1,
+                                                        (c0 + r0) / (c1 + r1)))
+    print("%-16s %41s %7.2fx" % ("all modes", "", total[0] / total[1]))
+
+    report_size("native", programs[0], programs[1], "nm", "size")
+    if args.device:
+        device(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
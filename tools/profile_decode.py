@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Decode Hector profiler telemetry.
+
+The firmware prints a "#PROF" header at boot and one "PROF" record a second
+on Serial (115200 baud); every other line is ignored. For each stage a record
+holds count,min,avg,p99,max in microseconds, except "push", which is in
+bytes sent to the panel; "input" is from a button edge to the push of the
+frame that shows it.
+
+    pio device monitor | tee hector.log
+    python3 tools/profile_decode.py hector.log            # summary per mode
+    python3 tools/profile_decode.py --follow < /dev/ttyUSB0
+    python3 tools/profile_decode.py --csv hector.log > stages.csv
+"""
+
+import argparse
+import sys
+from collections import defaultdict
+
+WAVES = ["DRIP", "SINE", "FLAT", "TILT", "SOUND", "SPIRAL",
+         "INTER", "MOUNT", "RIPPLE", "PLASMA", "SPECTRUM"]
+DISPLAYS = ["GRID", "SOLID", "ZEBRA", "CHECK"]
+FIELDS = ["count", "min", "avg", "p99", "max"]
+
+# Used until a "#PROF" header is seen (the firmware's stage order)
+DEFAULT_STAGES = ["btn", "imu", "audio", "surf", "shade", "proj", "draw", "hud", "flush", "push", "frame", "input"]
+HEAD = ["ms", "fps", "wave", "display", "cols", "rows"]
+
+
+def name(table, i):
+    return table[i] if 0 <= i < len(table) else str(i)
+
+
+def parse(lines):
+    """Yield one dict per PROF record."""
+    stages = DEFAULT_STAGES
+    for line in lines:
+        line = line.strip()
+        if line.startswith("#PROF,"):
+            stages = line.split(",")[1 + len(HEAD):]
+            continue
+        if not line.startswith("PROF,"):
+            continue
+        try:
+            values = [int(v) for v in line.split(",")[1:]]
+        except ValueError:
+            continue  # a line cut by a reset
+        if len(values) != len(HEAD) + len(FIELDS) * len(stages):
+            continue
+        record = dict(zip(HEAD, values))
+        record["stages"] = {}
+        for i, stage in enumerate(stages):
+            base = len(HEAD) + len(FIELDS) * i
+            record["stages"][stage] = dict(zip(FIELDS, values[base:base + len(FIELDS)]))
+        yield record
+
+
+def mode(record):
+    return "%s/%s" % (name(WAVES, record["wave"]), name(DISPLAYS, record["display"]))
+
+
+def print_record(r):
+    parts = ["%7.1fs %3d fps %-15s %2dx%-2d" % (r["ms"] / 1000.0, r["fps"], mode(r), r["cols"], r["rows"])]
+    for stage, s in r["stages"].items():
+        if s["count"]:
+            parts.append("%s %d/%d" % (stage, s["avg"], s["p99"]))
+    print("  ".join(parts))
+    sys.stdout.flush()
+
+
+def summarize(records):
+    """Per mode: mean fps, and per stage the mean of the averages and the
+    worst p99 and max over all seconds spent in that mode."""
+    groups = defaultdict(list)
+    for r in records:
+        groups[mode(r)].append(r)
+
+    for key in sorted(groups):
+        rs = groups[key]
+        fps = sum(r["fps"] for r in rs) / float(len(rs))
+        print("%s: %d s, %.1f fps, grid %dx%d" % (key, len(rs), fps, rs[-1]["cols"], rs[-1]["rows"]))
+        print("  %-6s %8s %8s %8s %8s %8s" % ("stage", "runs/s", "min", "avg", "p99", "max"))
+        for stage in rs[0]["stages"]:
+            seen = [r["stages"][stage] for r in rs if r["stages"][stage]["count"]]
+            if not seen:
+                continue
+            runs = sum(s["count"] for s in seen) / float(len(rs))
+            avg = sum(s["avg"] * s["count"] for s in seen) / float(sum(s["count"] for s in seen))
+            print("  %-6s %8.1f %8d %8.0f %8d %8d" % (
+                stage, runs, min(s["min"] for s in seen), avg,
+                max(s["p99"] for s in seen), max(s["max"] for s in seen)))
+        print()
+
+
+def write_csv(records):
+    print("ms,fps,wave,display,cols,rows,stage," + ",".join(FIELDS))
+    for r in records:
+        for stage, s in r["stages"].items():
+            print("%d,%d,%s,%s,%d,%d,%s,%s" % (
+                r["ms"], r["fps"], name(WAVES, r["wave"]), name(DISPLAYS, r["display"]),
+                r["cols"], r["rows"], stage, ",".join(str(s[f]) for f in FIELDS)))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", help="captured Serial output (default: stdin)")
+    ap.add_argument("--follow", action="store_true", help="print every record as it arrives")
+    ap.add_argument("--csv", action="store_true", help="one CSV row per record and stage")
+    args = ap.parse_args()
+
+    source = open(args.log, errors="replace") if args.log else sys.stdin
+    if args.follow:
+        for r in parse(source):
+            print_record(r)
+        return
+    records = list(parse(source))
+    if not records:
+        sys.exit("no PROF records found")
+    if args.csv:
+        write_csv(records)
+    else:
+        summarize(records)
+
+
+if __name__ == "__main__":
+    main()
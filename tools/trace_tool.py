@@ -0,0 +1,109 @@
+#!/usr/bin/env python3
+"""Extract and inspect Hector sensor traces.
+
+A build with -DHECTOR_TRACE=1 -DHECTOR_TRACE_SERIAL=1 prints the trace as
+"TRC,<base64>" lines between the other Serial output; "extract" joins them
+back into a trace file that the native bench (--replay) or a device
+(copied to /hector.trc on LittleFS) can replay. "dump" summarizes a trace.
+
+    pio device monitor | tee hector.log
+    python3 tools/trace_tool.py extract hector.log -o hector.trc
+    python3 tools/trace_tool.py dump hector.trc [--records]
+"""
+
+import argparse
+import base64
+import struct
+import sys
+from collections import Counter
+
+TYPES = {1: "imu", 2: "levels", 3: "bands", 4: "pcm"}
+
+
+def extract(args):
+    data = bytearray()
+    bad = 0
+    with open(args.log, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("TRC,"):
+                continue
+            try:
+                data += base64.b64decode(line[4:], validate=True)
+            except ValueError:
+                bad += 1  # a line cut by a reset or a dropped byte
+    if not data.startswith(b"HTRC"):
+        sys.exit("no trace header in %s" % args.log)
+    with open(args.output, "wb") as f:
+        f.write(data)
+    print("%s: %d bytes%s" % (args.output, len(data), ", %d damaged lines skipped" % bad if bad else ""))
+
+
+def records(data):
+    pos = 16
+    while pos + 8 <= len(data):
+        kind, _, size, time_us = struct.unpack_from("<BBHI", data, pos)
+        payload = data[pos + 8:pos + 8 + size]
+        if len(payload) < size:
+            break
+        yield kind, time_us, payload
+        pos += 8 + size
+
+
+def describe(kind, payload):
+    if kind == 1:
+        q = struct.unpack("<6h", payload)
+        return "acc %.3f %.3f %.3f g  gyro %.1f %.1f %.1f dps" % (
+            q[0] / 4096.0, q[1] / 4096.0, q[2] / 4096.0, q[3] / 16.0, q[4] / 16.0, q[5] / 16.0)
+    if kind == 2:
+        return "level %.3f  power %.1f" % struct.unpack("<2f", payload)
+    if kind == 3:
+        bands = struct.unpack("<%dH" % (len(payload) // 2), payload)
+        return " ".join("%.2f" % (b / 65535.0) for b in bands)
+    if kind == 4:
+        return "%d samples" % (len(payload) // 2)
+    return "%d bytes" % len(payload)
+
+
+def dump(args):
+    data = open(args.trace, "rb").read()
+    if data[:4] != b"HTRC":
+        sys.exit("%s is not a trace" % args.trace)
+    version, flags, rate = struct.unpack_from("<HHI", data, 4)
+    print("version %d, %d Hz, %s" % (version, rate, "with PCM" if flags & 1 else "levels only"))
+
+    counts = Counter()
+    last = 0
+    for kind, time_us, payload in records(data):
+        counts[kind] += 1
+        last = time_us
+        if args.records:
+            print("%10.3f s  %-6s %s" % (time_us / 1e6, TYPES.get(kind, kind), describe(kind, payload)))
+    seconds = last / 1e6
+    print("%.1f s, %d bytes (%.0f B/s)" % (seconds, len(data), len(data) / seconds if seconds else 0))
+    for kind in sorted(counts):
+        rate = counts[kind] / seconds if seconds else 0
+        print("  %-6s %7d records  %6.1f /s" % (TYPES.get(kind, kind), counts[kind], rate))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    sub = ap.add_subparsers(dest="command")
+    p = sub.add_parser("extract", help="TRC lines of a Serial log to a trace file")
+    p.add_argument("log")
+    p.add_argument("-o", "--output", default="hector.trc")
+    p = sub.add_parser("dump", help="summarize a trace")
+    p.add_argument("trace")
+    p.add_argument("--records", action="store_true", help="print every record")
+    args = ap.parse_args()
+
+    if args.command == "extract":
+        extract(args)
+    elif args.command == "dump":
+        dump(args)
+    else:
+        ap.print_help()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,248 @@
+/*
+  Sensor traces for Hector
+
+  A trace is a 16-byte header followed by timestamped records, all little
+  endian (ESP32 and x86 alike):
+
+    header  "HTRC", uint16 version, uint16 flags, uint32 sample rate,
+            uint32 reserved
+    record  uint8 type, uint8 reserved, uint16 payload bytes,
+            uint32 microseconds since the start of the trace, payload
+
+    TRACE_IMU     raw accelerometer (1/4096 g) and gyro (1/16 dps), 6 x int16
+    TRACE_LEVELS  sound level and RMS power, 2 x float
+    TRACE_BANDS   spectrum bands, SPECTRUM_BANDS x uint16 (0..1 in Q16)
+    TRACE_PCM     raw microphone samples, n x int16
+
+  TraceWriter packs records into a small buffer and hands full buffers to
+  a sink function; TraceReader pulls records back from a source function.
+  Where the bytes go (LittleFS, Serial, a host file) is up to the caller.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_TRACE_H
+#define HECTOR_TRACE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "spectrum.h"
+
+#define TRACE_VERSION 1
+#define TRACE_FLAG_PCM 1
+#define TRACE_HEADER_BYTES 16
+#define TRACE_RECORD_BYTES 8
+#define TRACE_MAX_PAYLOAD 1024
+#define TRACE_BUFFER_BYTES 512
+
+enum TraceType : uint8_t {
+  TRACE_IMU = 1,
+  TRACE_LEVELS = 2,
+  TRACE_BANDS = 3,
+  TRACE_PCM = 4
+};
+
+struct TraceImu {
+  float accX, accY, accZ;     // g
+  float gyroX, gyroY, gyroZ;  // dps
+};
+
+struct TraceRecord {
+  uint8_t type = 0;
+  uint16_t bytes = 0;
+  uint32_t timeUs = 0;
+  uint8_t payload[TRACE_MAX_PAYLOAD];
+
+  TraceImu imu() const {
+    int16_t q[6];
+    memcpy(q, payload, sizeof(q));
+    TraceImu v = {q[0] / 4096.0f, q[1] / 4096.0f, q[2] / 4096.0f,
+                  q[3] / 16.0f, q[4] / 16.0f, q[5] / 16.0f};
+    return v;
+  }
+
+  void levels(float& level, float& power) const {
+    memcpy(&level, payload, 4);
+    memcpy(&power, payload + 4, 4);
+  }
+
+  SpectrumBands bands() const {
+    SpectrumBands b;
+    for (int i = 0; i < SPECTRUM_BANDS; i++) {
+      uint16_t q;
+      memcpy(&q, payload + 2 * i, 2);
+      b.level[i] = q / 65535.0f;
+    }
+    return b;
+  }
+
+  const int16_t* pcm() const { return (const int16_t*)payload; }
+  size_t pcmSamples() const { return bytes / sizeof(int16_t); }
+};
+
+typedef size_t (*TraceWriteFn)(void* ctx, const uint8_t* data, size_t bytes);
+typedef size_t (*TraceReadFn)(void* ctx, uint8_t* data, size_t bytes);
+
+class TraceWriter {
+public:
+  bool begin(TraceWriteFn fn, void* context, uint32_t sampleRate, uint16_t flags) {
+    sink = fn;
+    ctx = context;
+    used = 0;
+    total = 0;
+    failed = false;
+    uint8_t header[TRACE_HEADER_BYTES] = {'H', 'T', 'R', 'C'};
+    uint16_t version = TRACE_VERSION;
+    memcpy(header + 4, &version, 2);
+    memcpy(header + 6, &flags, 2);
+    memcpy(header + 8, &sampleRate, 4);
+    append(header, sizeof(header));
+    return flush();
+  }
+
+  void imu(uint32_t timeUs, const TraceImu& v) {
+    int16_t q[6] = {quantize(v.accX, 4096), quantize(v.accY, 4096), quantize(v.accZ, 4096),
+                    quantize(v.gyroX, 16), quantize(v.gyroY, 16), quantize(v.gyroZ, 16)};
+    record(TRACE_IMU, timeUs, q, sizeof(q));
+  }
+
+  void levels(uint32_t timeUs, float level, float power) {
+    float v[2] = {level, power};
+    record(TRACE_LEVELS, timeUs, v, sizeof(v));
+  }
+
+  void bands(uint32_t timeUs, const SpectrumBands& b) {
+    uint16_t q[SPECTRUM_BANDS];
+    for (int i = 0; i < SPECTRUM_BANDS; i++) {
+      float v = b.level[i] < 0 ? 0 : (b.level[i] > 1 ? 1 : b.level[i]);
+      q[i] = (uint16_t)(v * 65535.0f + 0.5f);
+    }
+    record(TRACE_BANDS, timeUs, q, sizeof(q));
+  }
+
+  // Long runs of samples are split into records of TRACE_MAX_PAYLOAD bytes
+  void pcm(uint32_t timeUs, const int16_t* samples, size_t n) {
+    const size_t perRecord = TRACE_MAX_PAYLOAD / sizeof(int16_t);
+    while (n) {
+      size_t k = n < perRecord ? n : perRecord;
+      record(TRACE_PCM, timeUs, samples, k * sizeof(int16_t));
+      samples += k;
+      n -= k;
+    }
+  }
+
+  // Hand the buffered records to the sink; false once the sink has failed
+  bool flush() {
+    if (!failed && used) {
+      failed = sink(ctx, buffer, used) != used;
+      total += used;
+    }
+    used = 0;
+    return !failed;
+  }
+
+  bool ok() const { return !failed; }
+  uint32_t bytes() const { return total + used; }
+
+private:
+  static int16_t quantize(float v, float scale) {
+    float q = v * scale;
+    q = q < -32768 ? -32768 : (q > 32767 ? 32767 : q);
+    return (int16_t)(q + (q >= 0 ? 0.5f : -0.5f));
+  }
+
+  void record(uint8_t type, uint32_t timeUs, const void* payload, size_t bytes) {
+    if (failed) return;
+    uint8_t head[TRACE_RECORD_BYTES] = {type, 0};
+    uint16_t n = (uint16_t)bytes;
+    memcpy(head + 2, &n, 2);
+    memcpy(head + 4, &timeUs, 4);
+    append(head, sizeof(head));
+    append((const uint8_t*)payload, bytes);
+  }
+
+  void append(const uint8_t* data, size_t bytes) {
+    while (bytes) {
+      size_t room = TRACE_BUFFER_BYTES - used;
+      size_t k = bytes < room ? bytes : room;
+      memcpy(buffer + used, data, k);
+      used += k;
+      data += k;
+      bytes -= k;
+      if (used == TRACE_BUFFER_BYTES && !flush()) return;
+    }
+  }
+
+  TraceWriteFn sink = nullptr;
+  void* ctx = nullptr;
+  uint8_t buffer[TRACE_BUFFER_BYTES];
+  size_t used = 0;
+  uint32_t total = 0;
+  bool failed = false;
+};
+
+class TraceReader {
+public:
+  // Reads and checks the header
+  bool begin(TraceReadFn fn, void* context) {
+    source = fn;
+    ctx = context;
+    uint8_t header[TRACE_HEADER_BYTES];
+    if (!readAll(header, sizeof(header)) || memcmp(header, "HTRC", 4) != 0) return false;
+    uint16_t version;
+    memcpy(&version, header + 4, 2);
+    memcpy(&traceFlags, header + 6, 2);
+    memcpy(&rate, header + 8, 4);
+    return version == TRACE_VERSION;
+  }
+
+  // Next record, false at the end of the trace or on a damaged record
+  bool next(TraceRecord& r) {
+    uint8_t head[TRACE_RECORD_BYTES];
+    if (!readAll(head, sizeof(head))) return false;
+    r.type = head[0];
+    memcpy(&r.bytes, head + 2, 2);
+    memcpy(&r.timeUs, head + 4, 4);
+    if (r.bytes > TRACE_MAX_PAYLOAD) return false;
+    return readAll(r.payload, r.bytes);
+  }
+
+  uint16_t flags() const { return traceFlags; }
+  uint32_t sampleRate() const { return rate; }
+
+private:
+  bool readAll(uint8_t* data, size_t bytes) {
+    while (bytes) {
+      size_t n = source(ctx, data, bytes);
+      if (!n) return false;
+      data += n;
+      bytes -= n;
+    }
+    return true;
+  }
+
+  TraceReadFn source = nullptr;
+  void* ctx = nullptr;
+  uint16_t traceFlags = 0;
+  uint32_t rate = 0;
+};
+
+// Standard base64, for traces sent as text lines over Serial; returns the
+// characters written to out (4 per 3 bytes, rounded up, plus a 0)
+inline size_t traceBase64(const uint8_t* data, size_t bytes, char* out) {
+  static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for (size_t i = 0; i < bytes; i += 3) {
+    uint32_t v = (uint32_t)data[i] << 16;
+    if (i + 1 < bytes) v |= (uint32_t)data[i + 1] << 8;
+    if (i + 2 < bytes) v |= data[i + 2];
+    out[o++] = digits[(v >> 18) & 63];
+    out[o++] = digits[(v >> 12) & 63];
+    out[o++] = i + 1 < bytes ? digits[(v >> 6) & 63] : '=';
+    out[o++] = i + 2 < bytes ? digits[v & 63] : '=';
+  }
+  out[o] = 0;
+  return o;
+}
+
+#endif // HECTOR_TRACE_H
@@ -0,0 +1,117 @@
+/*
+  Vertex buffer for Hector
+
+  Projected grid vertices stored as a structure of arrays in a fixed
+  VertexArena. The grid density is chosen at runtime: layout(rows, cols)
+  packs the rows back to back, so any shape that fits the arena can be
+  used without reallocating. Each VertexRow is a view of one scan row in
+  the order drawPath() walks it: contiguous x, y, z and color values
+  indexed by column, plus a bitmask of the vertices that could be projected.
+
+  The rasterizer only ever looks at the current and the previous scan row,
+  so a frame can either keep every row (to hand it to the other core) or
+  stream through a two-row RowWindow that is drawn as soon as each row is
+  computed, which keeps the grid's RAM independent of the row count.
+
+  Pure C++ with no Arduino dependencies, like raster.h.
+*/
+
+#ifndef HECTOR_VERTEX_BUFFER_H
+#define HECTOR_VERTEX_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// One scan row inside an arena
+struct VertexRow {
+  int16_t* x = nullptr;
+  int16_t* y = nullptr;
+  int16_t* z = nullptr;       // projected height, for depth-aware renderers
+  uint16_t* color = nullptr;
+  uint32_t* valid = nullptr;  // bit i: vertex i was projected
+  int cols = 0;
+
+  int words() const { return (cols + 31) >> 5; }
+
+  void clearValid() const { memset(valid, 0, words() * sizeof(uint32_t)); }
+
+  void setValid(int i) const { valid[i >> 5] |= (uint32_t)1 << (i & 31); }
+
+  bool isValid(int i) const { return (valid[i >> 5] >> (i & 31)) & 1; }
+
+  bool anyValid() const {
+    for (int w = 0; w < words(); w++) {
+      if (valid[w]) return true;
+    }
+    return false;
+  }
+};
+
+// Fixed storage for up to VERTICES vertices in at most MAX_ROWS rows
+template <size_t VERTICES, int MAX_ROWS>
+class VertexArena {
+public:
+  // Lay out rows x cols vertices; false (and no change) if they don't fit
+  bool layout(int newRows, int newCols) {
+    if (newRows < 0 || newCols < 0 || newRows > MAX_ROWS) return false;
+    if ((size_t)newRows * newCols > VERTICES) return false;
+    rowCount = newRows;
+    colCount = newCols;
+    return true;
+  }
+
+  int rows() const { return rowCount; }
+  int cols() const { return colCount; }
+
+  static bool fits(int rows, int cols) {
+    return rows >= 0 && cols >= 0 && rows <= MAX_ROWS && (size_t)rows * cols <= VERTICES;
+  }
+
+  VertexRow row(int r) {
+    VertexRow v;
+    size_t base = (size_t)r * colCount;
+    v.x = xs + base;
+    v.y = ys + base;
+    v.z = zs + base;
+    v.color = colors + base;
+    v.valid = validBits + (size_t)r * ((colCount + 31) >> 5);
+    v.cols = colCount;
+    return v;
+  }
+
+  // Read-only views share the same layout
+  const VertexRow row(int r) const { return const_cast<VertexArena*>(this)->row(r); }
+
+private:
+  int rowCount = 0;
+  int colCount = 0;
+  int16_t xs[VERTICES];
+  int16_t ys[VERTICES];
+  int16_t zs[VERTICES];
+  uint16_t colors[VERTICES];
+  uint32_t validBits[VERTICES / 32 + MAX_ROWS]; // rows start on a word
+};
+
+// The current and previous scan rows, for the streaming path
+template <int MAX_COLS>
+class RowWindow {
+public:
+  // Start a frame with rows of cols vertices
+  bool begin(int cols) { return arena.layout(2, cols); }
+
+  // Row to compute scan row n into; it replaces row n - 2
+  VertexRow next(int n) {
+    VertexRow r = arena.row(n & 1);
+    r.clearValid();
+    return r;
+  }
+
+  const VertexRow current(int n) const { return arena.row(n & 1); }
+  const VertexRow previous(int n) const { return arena.row((n + 1) & 1); }
+
+private:
+  VertexArena<2 * MAX_COLS, 2> arena;
+};
+
+#endif // HECTOR_VERTEX_BUFFER_H